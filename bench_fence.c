@@ -0,0 +1,259 @@
+/**
+ * bench_fence.c: how quickly and cheaply a CPU wait notices a GPU signal
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <radeon_bo.h>
+#include <radeon_cs.h>
+#include <radeon_drm.h>
+
+#include "r600_reg.h"
+#include "r600_cmdbuf.h"
+#include "r600_fence.h"
+#include "r600_sched.h"
+#include "r600_standin.h"
+#include "r600_stream.h"
+
+/*
+ * Runs on the stand-in backend, so no GPU is needed: each submission is
+ * one draw followed by the stream's fence, and the CPU waits for it.
+ * Latency is from the moment the stand-in stores the value to the moment
+ * the wait returns; CPU time is what the waiting thread burned.  The
+ * stand-in's timing is only as good as the host's scheduler, so compare
+ * policies against each other rather than against real hardware.
+ *
+ * The second part chains pairs of draws, B depending on A, with the
+ * dependency held on the CPU, on the GPU, or as r600_sched picks.  The
+ * stand-in charges DEP_LAUNCH_US between a submission and its start to
+ * stand in for the ioctl and IB fetch a CPU wait puts on the critical
+ * path.
+ */
+
+#define ITERATIONS 200
+
+struct policy {
+    const char *name;
+    struct r600_wait_policy p;      /* unused for bo_wait */
+};
+
+static const struct policy policies[] = {
+    {"spin",      {UINT64_MAX / 2, 0, 0, 0}},
+    {"yield",     {0, UINT64_MAX / 2, 0, 0}},
+    {"sleep",     {0, 0, 50000, 1000000}},
+    {"adaptive",  {0, 0, 0, 0}},            /* r600_wait_default */
+    {"bo_wait",   {0, 0, 0, 0}},
+};
+
+#define NPOLICIES (sizeof(policies) / sizeof(policies[0]))
+
+static const unsigned work_us[] = {20, 2000};
+
+#define NWORK (sizeof(work_us) / sizeof(work_us[0]))
+
+#define DEP_LAUNCH_US   50
+#define DEP_DRAW_US     50
+
+enum { DEP_CPU, DEP_GPU, DEP_SCHED };
+
+static const char *const dep_names[] = {"cpu", "gpu", "sched"};
+
+static uint64_t clock_ns(clockid_t id)
+{
+    struct timespec ts;
+
+    clock_gettime(id, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+static int run(unsigned us, const struct policy *pol)
+{
+    struct r600_standin_config cfg = {0, us};
+    struct r600_standin *sd = NULL;
+    struct r600_fences *f = NULL;
+    struct r600_timeline *tl = NULL;
+    struct r600_stream *s = NULL;
+    uint64_t lat[ITERATIONS], cpu = 0, t, sum = 0;
+    unsigned i;
+    int ret = -1;
+
+    if((sd = r600_standin_create(&cfg)) == NULL ||
+       (f = r600_fences_create(r600_standin_bom(sd), RADEON_GEM_DOMAIN_GTT)) == NULL ||
+       (tl = r600_timeline_create(f, 0)) == NULL ||
+       (s = r600_stream_create(r600_standin_csm(sd), NULL)) == NULL) {
+        fputs("Could not set up the stand-in\n", stderr);
+        goto cleanup;
+    }
+
+    if(strcmp(pol->name, "adaptive") != 0)
+        tl->policy = pol->p;
+    tl->spin_ns = tl->policy.spin_ns;
+    r600_stream_set_timeline(s, tl);
+
+    for(i = 0; i < ITERATIONS; i++) {
+        if((ret = r600_emit_draw_index_auto(s->cb, 1, DI_SRC_SEL_AUTO_INDEX)) != 0 ||
+           (ret = r600_stream_submit(s)) != 0) {
+            fprintf(stderr, "Submission failed: %d\n", ret);
+            goto cleanup;
+        }
+
+        t = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+        if(strcmp(pol->name, "bo_wait") == 0)
+            ret = radeon_bo_wait(f->bo);
+        else
+            ret = r600_timeline_wait(tl, s->fence, 1000000000ull);
+        lat[i] = clock_ns(CLOCK_MONOTONIC) - r600_standin_last_write_ns(sd);
+        cpu += clock_ns(CLOCK_THREAD_CPUTIME_ID) - t;
+
+        if(ret != 0) {
+            fprintf(stderr, "Wait failed: %d\n", ret);
+            goto cleanup;
+        }
+        sum += lat[i];
+    }
+
+    qsort(lat, ITERATIONS, sizeof(lat[0]), cmp_u64);
+    printf("%6u us  %-10s %8.1f us mean %8.1f us p50 %8.1f us p99 %8.1f us CPU/wait\n",
+           us, pol->name, sum / 1e3 / ITERATIONS, lat[ITERATIONS / 2] / 1e3,
+           lat[ITERATIONS * 99 / 100] / 1e3, cpu / 1e3 / ITERATIONS);
+    ret = 0;
+
+cleanup:
+    r600_stream_destroy(s);
+    r600_timeline_destroy(tl);
+    r600_fences_destroy(f);
+    r600_standin_destroy(sd);
+
+    return ret;
+}
+
+static int draw(struct r600_stream *s)
+{
+    int ret;
+
+    if((ret = r600_emit_draw_index_auto(s->cb, 1, DI_SRC_SEL_AUTO_INDEX)) != 0 ||
+       (ret = r600_stream_submit(s)) != 0)
+        fprintf(stderr, "Submission failed: %d\n", ret);
+
+    return ret;
+}
+
+static int run_deps(int mode)
+{
+    struct r600_standin_config cfg = {DEP_LAUNCH_US, DEP_DRAW_US};
+    struct r600_standin *sd = NULL;
+    struct r600_fences *f = NULL;
+    struct r600_timeline *tl = NULL;
+    struct r600_stream *s = NULL;
+    struct r600_sched *sc = NULL;
+    uint64_t t;
+    unsigned i;
+    int ret = -1;
+
+    if((sd = r600_standin_create(&cfg)) == NULL ||
+       (f = r600_fences_create(r600_standin_bom(sd), RADEON_GEM_DOMAIN_GTT)) == NULL ||
+       (tl = r600_timeline_create(f, 0)) == NULL ||
+       (s = r600_stream_create(r600_standin_csm(sd), NULL)) == NULL ||
+       (sc = r600_sched_create()) == NULL) {
+        fputs("Could not set up the stand-in\n", stderr);
+        goto cleanup;
+    }
+    r600_stream_set_timeline(s, tl);
+
+    t = clock_ns(CLOCK_MONOTONIC);
+    for(i = 0; i < ITERATIONS; i++) {
+        if((ret = draw(s)) != 0)
+            goto cleanup;
+
+        switch(mode) {
+        case DEP_CPU:
+            ret = r600_timeline_wait(tl, s->fence, UINT64_MAX);
+            break;
+        case DEP_GPU:
+            ret = r600_timeline_wait_gpu(tl, s->cb, s->fence);
+            break;
+        case DEP_SCHED:
+            ret = r600_sched_depend(sc, s, tl, s->fence);
+            break;
+        }
+        if(ret < 0) {
+            fprintf(stderr, "Dependency failed: %d\n", ret);
+            goto cleanup;
+        }
+
+        if((ret = draw(s)) != 0)
+            goto cleanup;
+    }
+    ret = r600_timeline_wait(tl, s->fence, UINT64_MAX);
+    t = clock_ns(CLOCK_MONOTONIC) - t;
+
+    printf("%-10s %8.1f us/pair", dep_names[mode], t / 1e3 / ITERATIONS);
+    if(mode == DEP_SCHED)
+        printf("  (%llu on the GPU, %llu on the CPU)", (unsigned long long) sc->stats.gpu,
+               (unsigned long long) sc->stats.cpu);
+    putchar('\n');
+
+cleanup:
+    r600_sched_destroy(sc);
+    r600_stream_destroy(s);
+    r600_timeline_destroy(tl);
+    r600_fences_destroy(f);
+    r600_standin_destroy(sd);
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned i, j;
+
+    puts("  work  policy       wake latency after the fence lands");
+
+    for(i = 0; i < NWORK; i++) {
+        for(j = 0; j < NPOLICIES; j++) {
+            if(run(work_us[i], &policies[j]) != 0)
+                return 1;
+        }
+    }
+
+    printf("\ndependent pairs, %u us launch, %u us per draw\n", DEP_LAUNCH_US, DEP_DRAW_US);
+
+    for(i = DEP_CPU; i <= DEP_SCHED; i++) {
+        if(run_deps(i) != 0)
+            return 1;
+    }
+
+    return 0;
+}
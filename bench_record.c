@@ -0,0 +1,234 @@
+/**
+ * bench_record.c: recording throughput across threads, and the merge
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <pthread.h>
+
+#include <radeon_bo.h>
+#include <radeon_drm.h>
+
+#include "r600_reg.h"
+#include "r600_cmdbuf.h"
+#include "r600_regbuf.h"
+#include "r600_shadow.h"
+#include "r600_record.h"
+#include "r600_standin.h"
+#include "r600_stream.h"
+
+/*
+ * Records DISPATCHES dispatches split evenly over 1, 2, 4 and 8 threads,
+ * each with its own recorder, regbuf and shadow, then merges them into a
+ * stream on the stand-in backend and submits it.  The recording time is
+ * wall-clock for all threads together, so it only drops with more
+ * threads if there are cores to run them.
+ */
+
+#define DISPATCHES 16384
+#define NCONSTS    64
+#define NBOS       8
+#define VS_FETCH   160
+
+#define VRAM RADEON_GEM_DOMAIN_VRAM
+
+static struct radeon_bo *bos[NBOS];
+
+struct worker {
+    pthread_t thread;
+    struct r600_recorder *rec;
+    unsigned first, count;
+    int ret;
+};
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int record(struct r600_recorder *rec, unsigned i)
+{
+    struct radeon_bo *src = bos[i % NBOS], *dst = bos[(i + 1) % NBOS], *shader = bos[0];
+    uint32_t consts[NCONSTS], w[R600_RESOURCE_DWORDS];
+    struct r600_cmdbuf *cb = rec->cb;
+    unsigned j;
+    int ret = 0;
+
+    for(j = 0; j < NCONSTS; j++)
+        consts[j] = i + j;
+    memset(w, 0, sizeof(w));
+    w[1] = src->size - 1;
+    w[2] = 16 << 8;
+    w[6] = 0xc0000000;
+
+    ret |= r600_emit_set_reg_bo(cb, SQ_PGM_START_VS, 0, shader, VRAM, 0);
+    ret |= r600_emit_set_reg_bo(cb, CB_COLOR0_BASE, 0, dst, 0, VRAM);
+    ret |= r600_regbuf_set(rec->rb, SQ_PGM_RESOURCES_VS, 4);
+    ret |= r600_regbuf_set(rec->rb, CB_COLOR0_SIZE, 0xffff);
+    ret |= r600_regbuf_set(rec->rb, CB_COLOR0_INFO, 0xc);
+    ret |= r600_regbuf_set(rec->rb, VGT_PRIMITIVE_TYPE, DI_PT_POINTLIST);
+    ret |= r600_regbuf_set_n(rec->rb, SQ_ALU_CONSTANT0_0, NCONSTS, consts);
+    ret |= r600_regbuf_flush(rec->rb, cb);
+    ret |= r600_emit_set_vtx_resource(cb, VS_FETCH, w, src, VRAM);
+    ret |= r600_emit_draw_index_auto(cb, 4096, DI_SRC_SEL_AUTO_INDEX);
+    ret |= r600_emit_surface_sync(cb, CB_ACTION_ENA_bit | CB0_DEST_BASE_ENA_bit,
+                                  dst, 0, dst->size, VRAM);
+    ret |= r600_recorder_end_group(rec);
+
+    return ret != 0 ? -ENOMEM : 0;
+}
+
+static void *work(void *arg)
+{
+    struct worker *wk = arg;
+    unsigned i;
+
+    for(i = wk->first; i < wk->first + wk->count && wk->ret == 0; i++)
+        wk->ret = record(wk->rec, i);
+
+    return NULL;
+}
+
+static int run(struct r600_standin *sd, unsigned nthreads)
+{
+    struct worker wk[8];
+    struct r600_recorder *recs[8];
+    struct r600_regbuf *rb;
+    struct r600_stream *s = NULL;
+    struct r600_merge_stats ms;
+    double t0, t1, t2, t3;
+    unsigned i, n;
+    int ret = -1;
+
+    memset(wk, 0, sizeof(wk));
+    memset(&ms, 0, sizeof(ms));
+
+    for(i = 0; i < nthreads; i++) {
+        if((rb = r600_regbuf_create()) == NULL || (rb->shadow = r600_shadow_create()) == NULL ||
+           (wk[i].rec = r600_recorder_create(rb)) == NULL) {
+            if(rb != NULL)
+                r600_shadow_destroy(rb->shadow);
+            r600_regbuf_destroy(rb);
+            fputs("Out of memory\n", stderr);
+            goto cleanup;
+        }
+        recs[i] = wk[i].rec;
+        wk[i].first = DISPATCHES / nthreads * i;
+        wk[i].count = DISPATCHES / nthreads;
+    }
+
+    if((s = r600_stream_create(r600_standin_csm(sd), NULL)) == NULL) {
+        fputs("Out of memory\n", stderr);
+        goto cleanup;
+    }
+
+    t0 = now();
+    for(n = 0; n < nthreads; n++) {
+        if(pthread_create(&wk[n].thread, NULL, work, &wk[n]) != 0) {
+            fputs("Could not start a thread\n", stderr);
+            break;
+        }
+    }
+    for(i = 0; i < n; i++) {
+        pthread_join(wk[i].thread, NULL);
+        if(wk[i].ret != 0) {
+            fprintf(stderr, "Recording failed: %d\n", wk[i].ret);
+            n = 0;
+        }
+    }
+    if(n < nthreads)
+        goto cleanup;
+
+    t1 = now();
+    if((ret = r600_merge(s, recs, nthreads, &ms)) != 0) {
+        fprintf(stderr, "Merge failed: %d\n", ret);
+        goto cleanup;
+    }
+    t2 = now();
+    if((ret = r600_stream_submit(s)) != 0) {
+        fprintf(stderr, "Submission failed: %d\n", ret);
+        goto cleanup;
+    }
+    t3 = now();
+    r600_standin_idle(sd);
+
+    printf("%u thread%s  %7.1f ns/dispatch recorded  %6.1f merged  %6.1f submitted"
+           "  (%llu dwords, %llu relocs, %llu IBs)\n",
+           nthreads, nthreads > 1 ? "s" : " ",
+           (t1 - t0) * 1e9 / DISPATCHES, (t2 - t1) * 1e9 / DISPATCHES,
+           (t3 - t2) * 1e9 / DISPATCHES, (unsigned long long) ms.dwords,
+           (unsigned long long) ms.relocs, (unsigned long long) s->stats.submits);
+
+cleanup:
+    for(i = 0; i < 8; i++) {
+        if(wk[i].rec == NULL)
+            continue;
+        rb = wk[i].rec->rb;
+        r600_recorder_destroy(wk[i].rec);
+        r600_shadow_destroy(rb->shadow);
+        r600_regbuf_destroy(rb);
+    }
+    r600_stream_destroy(s);
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    struct r600_standin *sd;
+    unsigned i, n;
+    int rval = 0;
+
+    if((sd = r600_standin_create(NULL)) == NULL) {
+        fputs("Could not set up the stand-in\n", stderr);
+        return 1;
+    }
+
+    for(i = 0; i < NBOS; i++) {
+        if((bos[i] = radeon_bo_open(r600_standin_bom(sd), 0, 1 << 20, 4096, VRAM, 0)) == NULL) {
+            fputs("Out of memory\n", stderr);
+            rval = 1;
+            goto cleanup;
+        }
+    }
+
+    for(n = 1; n <= 8 && rval == 0; n *= 2)
+        rval = run(sd, n) != 0;
+
+cleanup:
+    for(i = 0; i < NBOS; i++) {
+        if(bos[i] != NULL)
+            radeon_bo_unref(bos[i]);
+    }
+    r600_standin_destroy(sd);
+
+    return rval;
+}
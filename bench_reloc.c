@@ -0,0 +1,172 @@
+/**
+ * bench_reloc.c: relocation and space-check cost of repeated BO references
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <radeon_bo.h>
+#include <radeon_cs.h>
+#include <radeon_drm.h>
+
+#include "r600_reg.h"
+#include "r600_cmdbuf.h"
+#include "r600_resid.h"
+#include "r600_standin.h"
+
+/*
+ * Each dispatch points REFS base registers at BOs from a small shared
+ * pool, as kernels reading the same constants and tables do, then draws.
+ * A full IB of them is recorded into a cmdbuf and submitted on the
+ * stand-in, REPS times; recording and submission are timed apart, once
+ * with every BO space-checked per submission and once with the pool
+ * declared resident.
+ */
+
+#define DISPATCHES 384
+#define REFS       6
+#define NBOS       8
+#define REPS       200
+
+#define VRAM RADEON_GEM_DOMAIN_VRAM
+
+static struct radeon_bo *bos[NBOS];
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int record(struct r600_cmdbuf *cb)
+{
+    unsigned i, j;
+    int ret = 0;
+
+    for(i = 0; i < DISPATCHES; i++) {
+        for(j = 0; j < REFS; j++)
+            ret |= r600_emit_set_reg_bo(cb, SQ_ALU_CONST_CACHE_PS_0 + 4 * j, 0,
+                                        bos[(i + j) % NBOS], VRAM, 0);
+        ret |= r600_emit_draw_index_auto(cb, 4096, DI_SRC_SEL_AUTO_INDEX);
+    }
+
+    return ret != 0 ? -ENOMEM : 0;
+}
+
+static int run(struct r600_standin *sd, struct r600_residency *res)
+{
+    struct r600_cmdbuf *cb;
+    struct radeon_cs *cs;
+    double t0, trec = 0, tsub = 0;
+    unsigned i;
+    int ret = -ENOMEM;
+
+    cb = r600_cmdbuf_create(DISPATCHES * (REFS * R600_SET_REG_BO_DW + R600_DRAW_INDEX_AUTO_DW));
+    cs = radeon_cs_create(r600_standin_csm(sd), 16 * 1024);
+    if(cb == NULL || cs == NULL) {
+        fputs("Out of memory\n", stderr);
+        goto cleanup;
+    }
+
+    if(res != NULL && (ret = r600_residency_declare(res, cs)) != 0) {
+        fprintf(stderr, "Could not declare the resident set: %d\n", ret);
+        goto cleanup;
+    }
+    cb->resident = res;
+
+    for(i = 0; i < REPS; i++) {
+        t0 = now();
+        if((ret = record(cb)) != 0) {
+            fputs("Out of memory\n", stderr);
+            goto cleanup;
+        }
+        trec += now() - t0;
+
+        t0 = now();
+        if((ret = r600_cmdbuf_submit(cb, cs)) != 0) {
+            fprintf(stderr, "Submission failed: %d\n", ret);
+            goto cleanup;
+        }
+        tsub += now() - t0;
+    }
+    r600_standin_idle(sd);
+
+    printf("%-22s %6.1f ns/reloc recorded  %6.1f submitted  (%u relocs, %u BOs per IB)\n",
+           res != NULL ? "resident pool" : "checked per IB",
+           trec * 1e9 / (REPS * DISPATCHES * REFS), tsub * 1e9 / (REPS * DISPATCHES * REFS),
+           DISPATCHES * REFS, NBOS);
+
+cleanup:
+    if(cs != NULL) {
+        radeon_cs_space_reset_bos(cs);
+        radeon_cs_destroy(cs);
+    }
+    r600_cmdbuf_destroy(cb);
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    struct r600_standin *sd;
+    struct r600_residency *res = NULL;
+    unsigned i;
+    int rval = 0;
+
+    if((sd = r600_standin_create(NULL)) == NULL) {
+        fputs("Could not set up the stand-in\n", stderr);
+        return 1;
+    }
+
+    if((res = r600_residency_create()) == NULL) {
+        fputs("Out of memory\n", stderr);
+        rval = 1;
+        goto cleanup;
+    }
+
+    for(i = 0; i < NBOS; i++) {
+        if((bos[i] = radeon_bo_open(r600_standin_bom(sd), 0, 1 << 20, 4096, VRAM, 0)) == NULL ||
+           r600_residency_add(res, bos[i], VRAM, 0) != 0) {
+            fputs("Out of memory\n", stderr);
+            rval = 1;
+            goto cleanup;
+        }
+    }
+
+    rval = run(sd, NULL) != 0 || run(sd, res) != 0;
+
+cleanup:
+    r600_residency_destroy(res);
+    for(i = 0; i < NBOS; i++) {
+        if(bos[i] != NULL)
+            radeon_bo_unref(bos[i]);
+    }
+    r600_standin_destroy(sd);
+
+    return rval;
+}
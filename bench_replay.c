@@ -0,0 +1,269 @@
+/**
+ * bench_replay.c: CPU cost per dispatch, rebuilt vs. replayed
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <radeon_bo.h>
+#include <radeon_drm.h>
+
+#include "r600_reg.h"
+#include "r600_cmdbuf.h"
+#include "r600_regbuf.h"
+#include "r600_shadow.h"
+#include "r600_ib.h"
+
+/*
+ * Only the CPU side of building a command stream is measured, so nothing
+ * is submitted and no GPU is needed; the BOs are never dereferenced.
+ * Every BATCH dispatches the command buffer is reset as a submission
+ * would, which also invalidates the shadow.
+ */
+
+#define ITERATIONS 1000000
+#define BATCH      64
+#define NCONSTS    64
+#define VS_FETCH   160
+
+#define VRAM RADEON_GEM_DOMAIN_VRAM
+
+struct job {
+    struct radeon_bo *src, *dst, *shader;
+    uint32_t consts[NCONSTS];
+    uint32_t count;
+};
+
+/* Context state that doesn't change from one job to the next */
+static const uint32_t fixed_regs[][2] = {
+    {SQ_PGM_RESOURCES_VS,     0x00000004},
+    {SQ_PGM_RESOURCES_PS,     0x00000002},
+    {SQ_PGM_EXPORTS_PS,       0x00000002},
+    {SPI_VS_OUT_CONFIG,       0x00000000},
+    {SPI_PS_IN_CONTROL_0,     0x00000001},
+    {CB_COLOR0_SIZE,          0x0000ffff},
+    {CB_COLOR0_INFO,          0x0000000c},
+    {CB_TARGET_MASK,          0x0000000f},
+    {CB_SHADER_MASK,          0x0000000f},
+    {PA_SC_SCREEN_SCISSOR_TL, 0x00000000},
+    {PA_SC_SCREEN_SCISSOR_BR, 0x20002000},
+    {PA_SC_WINDOW_SCISSOR_BR, 0x20002000},
+};
+
+#define NFIXED (sizeof(fixed_regs) / sizeof(fixed_regs[0]))
+
+static void vtx_words(const struct job *j, uint32_t w[R600_RESOURCE_DWORDS])
+{
+    memset(w, 0, R600_RESOURCE_DWORDS * sizeof(uint32_t));
+    w[1] = j->src->size - 1;
+    w[2] = 16 << 8;     /* stride */
+    w[6] = 0xc0000000;  /* SQ_TEX_VTX_VALID_BUFFER */
+}
+
+/* The packets that don't go through SET_* registers */
+static void tail(struct r600_cmdbuf *cb, const struct job *j)
+{
+    r600_emit_index_type(cb, DI_INDEX_SIZE_16_BIT);
+    r600_emit_num_instances(cb, 1);
+    r600_emit_draw_index_auto(cb, j->count, DI_SRC_SEL_AUTO_INDEX);
+    r600_emit_surface_sync(cb, CB_ACTION_ENA_bit | CB0_DEST_BASE_ENA_bit,
+                           j->dst, 0, j->dst->size, VRAM);
+}
+
+/* One packet per register, the way a naive emitter would do it */
+static void build_naive(struct r600_cmdbuf *cb, const struct job *j)
+{
+    uint32_t w[R600_RESOURCE_DWORDS];
+    unsigned i;
+
+    r600_emit_set_reg_bo(cb, SQ_PGM_START_VS, 0, j->shader, VRAM, 0);
+    r600_emit_set_reg_bo(cb, SQ_PGM_START_PS, 0, j->shader, VRAM, 0);
+    r600_emit_set_reg_bo(cb, CB_COLOR0_BASE, 0, j->dst, 0, VRAM);
+    for(i = 0; i < NFIXED; i++)
+        r600_emit_set_reg(cb, fixed_regs[i][0], fixed_regs[i][1]);
+    for(i = 0; i < NCONSTS; i++)
+        r600_emit_set_reg(cb, SQ_ALU_CONSTANT0_0 + 4 * i, j->consts[i]);
+    r600_emit_set_reg(cb, VGT_PRIMITIVE_TYPE, DI_PT_POINTLIST);
+
+    vtx_words(j, w);
+    r600_emit_set_vtx_resource(cb, VS_FETCH, w, j->src, VRAM);
+    tail(cb, j);
+}
+
+/* Coalesced, with writes of unchanged values dropped */
+static void build_regbuf(struct r600_cmdbuf *cb, struct r600_regbuf *rb,
+                         const struct job *j)
+{
+    uint32_t w[R600_RESOURCE_DWORDS];
+    unsigned i;
+
+    r600_emit_set_reg_bo(cb, SQ_PGM_START_VS, 0, j->shader, VRAM, 0);
+    r600_emit_set_reg_bo(cb, SQ_PGM_START_PS, 0, j->shader, VRAM, 0);
+    r600_emit_set_reg_bo(cb, CB_COLOR0_BASE, 0, j->dst, 0, VRAM);
+    for(i = 0; i < NFIXED; i++)
+        r600_regbuf_set(rb, fixed_regs[i][0], fixed_regs[i][1]);
+    r600_regbuf_set_n(rb, SQ_ALU_CONSTANT0_0, NCONSTS, j->consts);
+    r600_regbuf_set(rb, VGT_PRIMITIVE_TYPE, DI_PT_POINTLIST);
+    r600_regbuf_flush(rb, cb);
+
+    vtx_words(j, w);
+    r600_emit_set_vtx_resource(cb, VS_FETCH, w, j->src, VRAM);
+    tail(cb, j);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void next_job(struct job *j, struct radeon_bo *bos, unsigned i)
+{
+    j->src = &bos[i & 1];
+    j->dst = &bos[2 + (i & 1)];
+    j->consts[0] = i;
+    j->count = 4096;
+}
+
+static void report(const char *name, double t, uint64_t dwords)
+{
+    printf("%-24s %8.1f ns/dispatch %8.1f dwords/dispatch\n", name,
+           t * 1e9 / ITERATIONS, (double) dwords / ITERATIONS);
+}
+
+int main(int argc, char **argv)
+{
+    struct radeon_bo bos[5];
+    struct r600_cmdbuf *cb = NULL;
+    struct r600_regbuf *rb = NULL;
+    struct r600_ib *ib = NULL;
+    int src_reloc, dst_reloc[2], count_slot, const_slot, rval = 0;
+    uint64_t dwords;
+    struct job j;
+    unsigned i;
+    double t;
+
+    memset(bos, 0, sizeof(bos));
+    for(i = 0; i < 5; i++)
+        bos[i].size = 1 << 20;
+
+    memset(&j, 0, sizeof(j));
+    for(i = 0; i < NCONSTS; i++)
+        j.consts[i] = i * 0x3f800000u;
+    j.shader = &bos[4];
+    next_job(&j, bos, 0);
+
+    if((cb = r600_cmdbuf_create(4096)) == NULL || (rb = r600_regbuf_create()) == NULL ||
+       (rb->shadow = r600_shadow_create()) == NULL) {
+        fputs("Out of memory\n", stderr);
+        rval = 1;
+        goto cleanup;
+    }
+
+    t = now();
+    for(i = 0, dwords = 0; i < ITERATIONS; i++) {
+        next_job(&j, bos, i);
+        build_naive(cb, &j);
+        if(i % BATCH == BATCH - 1) {
+            dwords += cb->cdw;
+            r600_cmdbuf_reset(cb);
+        }
+    }
+    report("rebuilt, naive", now() - t, dwords + cb->cdw);
+    r600_cmdbuf_reset(cb);
+
+    t = now();
+    for(i = 0, dwords = 0; i < ITERATIONS; i++) {
+        next_job(&j, bos, i);
+        build_regbuf(cb, rb, &j);
+        if(i % BATCH == BATCH - 1) {
+            dwords += cb->cdw;
+            r600_cmdbuf_reset(cb);
+            r600_shadow_invalidate(rb->shadow);
+        }
+    }
+    report("rebuilt, regbuf+shadow", now() - t, dwords + cb->cdw);
+    r600_cmdbuf_reset(cb);
+
+    /* Record once, then patch what differs between jobs */
+    next_job(&j, bos, 0);
+    build_regbuf(cb, rb, &j);
+    ib = r600_ib_create(cb);
+    r600_cmdbuf_reset(cb);
+    r600_shadow_invalidate(rb->shadow);
+
+    if(ib == NULL) {
+        fputs("Could not record the dispatch\n", stderr);
+        rval = 1;
+        goto cleanup;
+    }
+
+    const_slot = r600_ib_find_reg(ib, SQ_ALU_CONSTANT0_0);
+    count_slot = -1;
+    for(i = 0; i + 1 < ib->ndw; i++) {
+        if(PACKET_TYPE(ib->buf[i]) == 3 && PACKET3_OP(ib->buf[i]) == IT_DRAW_INDEX_AUTO) {
+            count_slot = i + 1;
+            break;
+        }
+    }
+    src_reloc = r600_ib_find_reloc(ib, j.src);
+    dst_reloc[0] = r600_ib_find_reloc(ib, j.dst);
+    dst_reloc[1] = ib->nrelocs - 1;     /* the SURFACE_SYNC at the end */
+
+    if(const_slot < 0 || count_slot < 0 || src_reloc < 0 || dst_reloc[0] < 0) {
+        fputs("Could not find the patch points\n", stderr);
+        rval = 1;
+        goto cleanup;
+    }
+
+    t = now();
+    for(i = 0, dwords = 0; i < ITERATIONS; i++) {
+        next_job(&j, bos, i);
+        r600_ib_patch_bo(ib, src_reloc, j.src);
+        r600_ib_patch_bo(ib, dst_reloc[0], j.dst);
+        r600_ib_patch_bo(ib, dst_reloc[1], j.dst);
+        r600_ib_patch(ib, const_slot, j.consts[0]);
+        r600_ib_patch(ib, count_slot, j.count);
+        r600_ib_replay(ib, cb);
+        if(i % BATCH == BATCH - 1) {
+            dwords += cb->cdw;
+            r600_cmdbuf_reset(cb);
+        }
+    }
+    report("replayed", now() - t, dwords + cb->cdw);
+
+cleanup:
+
+    r600_ib_destroy(ib);
+    if(rb != NULL)
+        r600_shadow_destroy(rb->shadow);
+    r600_regbuf_destroy(rb);
+    r600_cmdbuf_destroy(cb);
+
+    return rval;
+}
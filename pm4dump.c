@@ -0,0 +1,106 @@
+/**
+ * pm4dump.c: prints a captured command stream, packet by packet
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "r600_decode.h"
+
+/*
+ * Usage: pm4dump [-s] [file]
+ *
+ * Reads a raw command stream (host-order dwords, as in r600_cmdbuf.buf)
+ * from file or standard input and prints it in r600_decode()'s format,
+ * followed by the per-class totals; with -s only the totals are printed.
+ * Two versions of a stream can be compared with diff, or with
+ *
+ *   diff <(pm4dump a | cut -f1,3-) <(pm4dump b | cut -f1,3-)
+ *
+ * to ignore the dword positions of the packets.
+ */
+
+static uint32_t *read_all(FILE *f, unsigned *ndw)
+{
+    uint32_t *buf = NULL, *p;
+    size_t n = 0, max = 0, got;
+
+    for(;;) {
+        if(n == max) {
+            max = max != 0 ? 2 * max : 4096;
+            if((p = realloc(buf, max * sizeof(uint32_t))) == NULL) {
+                free(buf);
+                return NULL;
+            }
+            buf = p;
+        }
+        if((got = fread(buf + n, sizeof(uint32_t), max - n, f)) == 0)
+            break;
+        n += got;
+    }
+
+    *ndw = n;
+    return buf;
+}
+
+int main(int argc, char **argv)
+{
+    struct r600_decode_stats stats;
+    int summary_only = 0, ret;
+    unsigned ndw;
+    uint32_t *buf;
+    FILE *f = stdin;
+
+    if(argc > 1 && strcmp(argv[1], "-s") == 0) {
+        summary_only = 1;
+        argc--;
+        argv++;
+    }
+    if(argc > 2) {
+        fputs("Usage: pm4dump [-s] [file]\n", stderr);
+        return 2;
+    }
+    if(argc == 2 && (f = fopen(argv[1], "rb")) == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    buf = read_all(f, &ndw);
+    if(f != stdin)
+        fclose(f);
+    if(buf == NULL) {
+        fputs("Out of memory\n", stderr);
+        return 1;
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    ret = r600_decode(summary_only ? NULL : stdout, buf, ndw, &stats);
+    r600_decode_summary(stdout, &stats);
+    free(buf);
+
+    return ret != 0;
+}
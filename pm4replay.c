@@ -0,0 +1,176 @@
+/**
+ * pm4replay.c: re-issues a captured trace and times it
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <xf86drm.h>
+#include <radeon_drm.h>
+#include <radeon_bo.h>
+#include <radeon_bo_gem.h>
+#include <radeon_cs.h>
+#include <radeon_cs_gem.h>
+
+#include "r600_trace.h"
+#include "r600_standin.h"
+
+/*
+ * Usage: pm4replay [-s] [-n loops] [-f first] [-c count] trace
+ *
+ * Replays submissions first to first + count - 1 (by default all of
+ * them) of a trace written through r600_capture, loops times (1 by
+ * default), on the first radeon device or with -s on the stand-in, and
+ * prints how long each loop took next to how long the same submissions
+ * took when captured.
+ */
+
+static void usage(void)
+{
+    fputs("Usage: pm4replay [-s] [-n loops] [-f first] [-c count] trace\n", stderr);
+    exit(2);
+}
+
+static unsigned number(const char *s)
+{
+    char *end;
+    unsigned long n = strtoul(s, &end, 0);
+
+    if(*s == '\0' || *end != '\0' || n > UINT32_MAX)
+        usage();
+
+    return n;
+}
+
+/* Sets the space-check limits from what the kernel says there is */
+static void set_limits(int fd, struct radeon_cs_manager *csm)
+{
+    struct drm_radeon_gem_info info;
+    struct radeon_cs *cs;
+
+    if(drmCommandWriteRead(fd, DRM_RADEON_GEM_INFO, &info, sizeof(info)) != 0 ||
+       (cs = radeon_cs_create(csm, 64)) == NULL)
+        return;
+
+    /* The limits belong to the manager; any CS will do to set them */
+    radeon_cs_set_limit(cs, RADEON_GEM_DOMAIN_VRAM, info.vram_visible);
+    radeon_cs_set_limit(cs, RADEON_GEM_DOMAIN_GTT, info.gart_size);
+    radeon_cs_destroy(cs);
+}
+
+int main(int argc, char **argv)
+{
+    struct r600_trace *t;
+    struct r600_replay_stats st;
+    struct r600_standin *sd = NULL;
+    struct radeon_bo_manager *bom = NULL;
+    struct radeon_cs_manager *csm = NULL;
+    unsigned loops = 1, first = 0, count = UINT32_MAX;
+    int opt, standin = 0, fd = -1, ret, rval = 1;
+    FILE *f;
+
+    while((opt = getopt(argc, argv, "sn:f:c:")) != -1) {
+        switch(opt) {
+        case 's': standin = 1; break;
+        case 'n': loops = number(optarg); break;
+        case 'f': first = number(optarg); break;
+        case 'c': count = number(optarg); break;
+        default:  usage();
+        }
+    }
+    if(optind != argc - 1)
+        usage();
+
+    if((f = fopen(argv[optind], "rb")) == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+    t = r600_trace_load(f);
+    fclose(f);
+    if(t == NULL) {
+        fprintf(stderr, "%s: %s\n", argv[optind],
+                errno == EINVAL ? "not a trace, or a damaged one" : strerror(errno));
+        return 1;
+    }
+
+    if(first > t->nsubmits) {
+        fprintf(stderr, "The trace has only %u submissions\n", t->nsubmits);
+        goto cleanup;
+    }
+    if(count > t->nsubmits - first)
+        count = t->nsubmits - first;
+
+    if(standin) {
+        if((sd = r600_standin_create(NULL)) == NULL) {
+            fputs("Could not set up the stand-in\n", stderr);
+            goto cleanup;
+        }
+        bom = r600_standin_bom(sd);
+        csm = r600_standin_csm(sd);
+    } else {
+        if((fd = drmOpen("radeon", NULL)) < 0) {
+            fprintf(stderr, "Could not open DRM device (return value %d)\n", fd);
+            goto cleanup;
+        }
+        if((bom = radeon_bo_manager_gem_ctor(fd)) == NULL ||
+           (csm = radeon_cs_manager_gem_ctor(fd)) == NULL) {
+            fputs("Could not create the buffer or command stream manager\n", stderr);
+            goto cleanup;
+        }
+        set_limits(fd, csm);
+    }
+
+    if((ret = r600_trace_replay(t, bom, csm, first, count, loops, &st)) != 0) {
+        fprintf(stderr, "Replay failed: %s\n", strerror(-ret));
+        goto cleanup;
+    }
+
+    printf("%llu submissions, %llu dwords, %llu bytes uploaded in %u loop%s\n",
+           (unsigned long long) st.submits, (unsigned long long) st.dwords,
+           (unsigned long long) st.bytes, loops, loops != 1 ? "s" : "");
+    if(loops > 0)
+        printf("per loop  %10.1f us min  %10.1f avg  %10.1f max  (%.1f us captured)\n",
+               st.min_ns * 1e-3, st.total_ns * 1e-3 / loops, st.max_ns * 1e-3,
+               st.captured_ns * 1e-3);
+    rval = 0;
+
+cleanup:
+    if(sd != NULL) {
+        r600_standin_destroy(sd);
+    } else {
+        if(csm != NULL)
+            radeon_cs_manager_gem_dtor(csm);
+        if(bom != NULL)
+            radeon_bo_manager_gem_dtor(bom);
+        if(fd >= 0)
+            drmClose(fd);
+    }
+    r600_trace_destroy(t);
+
+    return rval;
+}
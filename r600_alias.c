@@ -0,0 +1,133 @@
+/**
+ * r600_alias.c: in-place output binding for hazard-free kernels
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+
+#include <radeon_bo.h>
+
+#include "r600_alias.h"
+
+static int64_t floor_div(int64_t a, int64_t b)
+{
+    int64_t q = a / b;
+
+    return (a % b != 0 && a < 0) ? q - 1 : q;
+}
+
+static int64_t ceil_div(int64_t a, int64_t b)
+{
+    int64_t q = a / b;
+
+    return (a % b != 0 && a > 0) ? q + 1 : q;
+}
+
+/* Is there a k != 0, |k| < count, with lo < k * s < hi?  (s > 0) */
+static int other_element_hits(int64_t lo, int64_t hi, int64_t s, uint32_t count)
+{
+    int64_t kmin = floor_div(lo, s) + 1, kmax = ceil_div(hi, s) - 1;
+    int64_t n = (int64_t) count - 1;
+
+    if(kmin < -n)
+        kmin = -n;
+    if(kmax > n)
+        kmax = n;
+
+    return kmin <= kmax && !(kmin == 0 && kmax == 0);
+}
+
+static uint64_t footprint_end(const struct r600_access *a, uint32_t count)
+{
+    return a->offset + (uint64_t) (count - 1) * a->stride + a->size;
+}
+
+int r600_alias_safe(const struct r600_access *rd, const struct r600_access *wr,
+                    uint32_t count)
+{
+    int64_t lo, hi;
+
+    if(count <= 1 || wr->size == 0)
+        return 1;
+
+    /* Elements writing over each other is wrong whether or not we alias */
+    if(wr->stride == 0 || other_element_hits(-(int64_t) wr->size, wr->size,
+                                             wr->stride, count))
+        return 0;
+
+    if(rd->size == 0)
+        return 1;
+
+    if(rd->stride != wr->stride) {
+        /* Only trust the case where the two footprints don't meet at all */
+        return footprint_end(rd, count) <= wr->offset ||
+               footprint_end(wr, count) <= rd->offset;
+    }
+
+    /*
+     * Element i's write overlaps element (i + k)'s read exactly when
+     * k * stride falls strictly between lo and hi.
+     */
+    lo = (int64_t) wr->offset - rd->offset - rd->size;
+    hi = (int64_t) wr->offset + wr->size - rd->offset;
+
+    return !other_element_hits(lo, hi, rd->stride, count);
+}
+
+int r600_bind_output(struct radeon_bo_manager *bom, struct radeon_bo *in,
+                     const struct r600_access *rd, const struct r600_access *wr,
+                     uint32_t count, uint32_t domain,
+                     struct r600_binding *b, struct r600_alias_stats *stats)
+{
+    uint64_t need = count > 0 ? footprint_end(wr, count) : 0;
+
+    if(need > UINT32_MAX)
+        return -EINVAL;
+
+    if(need <= in->size && r600_alias_safe(rd, wr, count)) {
+        radeon_bo_ref(in);
+        b->out = in;
+        b->in_place = 1;
+        b->saved = (uint32_t) need;
+    } else {
+        if((b->out = radeon_bo_open(bom, 0, (uint32_t) need, 4096, domain, 0)) == NULL)
+            return -ENOMEM;
+        b->in_place = 0;
+        b->saved = 0;
+    }
+
+    if(stats != NULL) {
+        stats->jobs++;
+        stats->in_place += b->in_place;
+        stats->bytes_saved += b->saved;
+    }
+
+    return 0;
+}
+
+void r600_binding_release(struct r600_binding *b)
+{
+    if(b->out != NULL)
+        b->out = radeon_bo_unref(b->out);
+}
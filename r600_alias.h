@@ -0,0 +1,77 @@
+/**
+ * r600_alias.h: in-place output binding for hazard-free kernels
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_ALIAS_H_
+#define _R600_ALIAS_H_
+
+#include <stdint.h>
+
+#include <radeon_bo.h>
+
+/*
+ * Elementwise kernels can often write their result over their input instead
+ * of into a second buffer of the same size (bo2 in step04.c).  That is only
+ * safe if no element writes bytes that another element reads or writes,
+ * since the GPU runs elements in no particular order.  Each element is
+ * assumed to read all of its inputs before writing its output.
+ */
+
+/* The bytes element i touches: [offset + i * stride, + size) */
+struct r600_access {
+    uint32_t offset;
+    uint32_t size;
+    uint32_t stride;
+};
+
+/* Nonzero if count elements reading rd and writing wr in one buffer can't race */
+int r600_alias_safe(const struct r600_access *rd, const struct r600_access *wr,
+                    uint32_t count);
+
+struct r600_alias_stats {
+    unsigned jobs;
+    unsigned in_place;
+    uint64_t bytes_saved;
+};
+
+struct r600_binding {
+    struct radeon_bo *out;  /* the input BO, or a temporary */
+    int in_place;
+    uint32_t saved;         /* bytes of device memory not allocated */
+};
+
+/*
+ * Picks the output buffer for a kernel reading rd from in: in itself when
+ * that is hazard-free, otherwise a new BO in domain big enough for the
+ * writes.  Either way b->out holds a reference, dropped by
+ * r600_binding_release().  stats may be NULL.  Returns 0 on success.
+ */
+int r600_bind_output(struct radeon_bo_manager *bom, struct radeon_bo *in,
+                     const struct r600_access *rd, const struct r600_access *wr,
+                     uint32_t count, uint32_t domain,
+                     struct r600_binding *b, struct r600_alias_stats *stats);
+
+void r600_binding_release(struct r600_binding *b);
+
+#endif
@@ -0,0 +1,332 @@
+/**
+ * r600_cmdbuf.c: PM4 command buffer builder
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <radeon_bo.h>
+#include <radeon_cs.h>
+
+#include "r600_cmdbuf.h"
+#include "r600_resid.h"
+#include "r600_trace.h"
+#include "r600_validate.h"
+
+/* Room for n BOs, and a hash index twice that size */
+static int grow_bos(struct r600_cmdbuf *cb, unsigned n)
+{
+    unsigned *hash, i, h;
+    void *p;
+
+    if((hash = calloc(2 * n, sizeof(*hash))) == NULL)
+        return -ENOMEM;
+    if((p = realloc(cb->bos, n * sizeof(struct r600_bo_slot))) == NULL) {
+        free(hash);
+        return -ENOMEM;
+    }
+
+    free(cb->bo_hash);
+    cb->bos = p;
+    cb->bo_hash = hash;
+    cb->hash_mask = 2 * n - 1;
+
+    for(i = 0; i < cb->nbos; i++) {
+        for(h = r600_bo_hash(cb->bos[i].bo) & cb->hash_mask; hash[h] != 0;
+            h = (h + 1) & cb->hash_mask)
+            ;
+        hash[h] = i + 1;
+        cb->bos[i].hash = h;
+    }
+
+    return 0;
+}
+
+static void clear_bos(struct r600_cmdbuf *cb)
+{
+    unsigned i;
+
+    for(i = 0; i < cb->nbos; i++)
+        cb->bo_hash[cb->bos[i].hash] = 0;
+    cb->nbos = 0;
+}
+
+struct r600_cmdbuf *r600_cmdbuf_create(unsigned ndw)
+{
+    struct r600_cmdbuf *cb;
+
+    if((cb = calloc(1, sizeof(*cb))) == NULL)
+        return NULL;
+
+    cb->ndw = ndw > 64 ? ndw : 64;
+    cb->max_relocs = 16;
+
+    if((cb->buf = malloc(cb->ndw * sizeof(uint32_t))) == NULL ||
+       (cb->relocs = malloc(cb->max_relocs * sizeof(struct r600_reloc))) == NULL ||
+       grow_bos(cb, cb->max_relocs) != 0) {
+        free(cb->relocs);
+        free(cb->buf);
+        free(cb);
+        return NULL;
+    }
+
+    return cb;
+}
+
+void r600_cmdbuf_destroy(struct r600_cmdbuf *cb)
+{
+    if(cb == NULL)
+        return;
+
+    free(cb->signals);
+    free(cb->bo_hash);
+    free(cb->bos);
+    free(cb->relocs);
+    free(cb->buf);
+    free(cb);
+}
+
+void r600_cmdbuf_reset(struct r600_cmdbuf *cb)
+{
+    cb->cdw = 0;
+    cb->nrelocs = 0;
+    cb->nsignals = 0;
+    clear_bos(cb);
+    cb->segment++;
+    cb->seg_start = 0;
+    cb->seg_relocs = 0;
+}
+
+int r600_cmdbuf_grow(struct r600_cmdbuf *cb, unsigned ndw, unsigned nrelocs)
+{
+    unsigned n;
+    void *p;
+    int ret;
+
+    /* Only worth it if something besides the segment's preamble is in there */
+    if(cb->flush != NULL && !cb->flushing && cb->cdw > cb->seg_start &&
+       cb->cdw + ndw + cb->tail > cb->ndw) {
+        cb->flushing = 1;
+        ret = cb->flush(cb, cb->flush_data);
+        cb->flushing = 0;
+        if(ret != 0)
+            return ret;
+    }
+
+    if(cb->cdw + ndw + cb->tail > cb->ndw) {
+        for(n = cb->ndw * 2; n < cb->cdw + ndw + cb->tail; n *= 2)
+            ;
+        if((p = realloc(cb->buf, n * sizeof(uint32_t))) == NULL)
+            return -ENOMEM;
+        cb->buf = p;
+        cb->ndw = n;
+    }
+
+    if(cb->nrelocs + nrelocs > cb->max_relocs) {
+        for(n = cb->max_relocs * 2; n < cb->nrelocs + nrelocs; n *= 2)
+            ;
+        if((p = realloc(cb->relocs, n * sizeof(struct r600_reloc))) == NULL)
+            return -ENOMEM;
+        cb->relocs = p;
+        if((ret = grow_bos(cb, n)) != 0)
+            return ret;
+        cb->max_relocs = n;
+    }
+
+    return 0;
+}
+
+int r600_cmdbuf_resize(struct r600_cmdbuf *cb, unsigned ndw)
+{
+    void *p;
+
+    if(ndw < cb->cdw)
+        ndw = cb->cdw;
+    if(ndw < 64)
+        ndw = 64;
+
+    if((p = realloc(cb->buf, ndw * sizeof(uint32_t))) == NULL)
+        return -ENOMEM;
+    cb->buf = p;
+    cb->ndw = ndw;
+
+    return 0;
+}
+
+int r600_cmdbuf_add_signal(struct r600_cmdbuf *cb, uint64_t *submitted, uint64_t value,
+                           unsigned cdw)
+{
+    struct r600_signal *sig;
+    unsigned max;
+
+    if(cb->nsignals == cb->max_signals) {
+        max = cb->max_signals > 0 ? 2 * cb->max_signals : 4;
+        if((sig = realloc(cb->signals, max * sizeof(*sig))) == NULL)
+            return -ENOMEM;
+        cb->signals = sig;
+        cb->max_signals = max;
+    }
+
+    sig = &cb->signals[cb->nsignals++];
+    sig->submitted = submitted;
+    sig->value = value;
+    sig->cdw = cdw;
+
+    return 0;
+}
+
+void r600_cmdbuf_reindex(struct r600_cmdbuf *cb)
+{
+    struct r600_reloc *r;
+
+    clear_bos(cb);
+    for(r = cb->relocs; r < cb->relocs + cb->nrelocs; r++)
+        r->slot = r600_cmdbuf_add_bo(cb, r->bo, r->read_domains, r->write_domain);
+}
+
+int r600_cmdbuf_append(struct r600_cmdbuf *cb, const uint32_t *buf, unsigned ndw,
+                       const struct r600_reloc *relocs, unsigned nrelocs,
+                       unsigned start)
+{
+    unsigned i, base;
+    struct r600_reloc *r;
+    uint32_t *p;
+
+    if((p = r600_cmdbuf_begin(cb, ndw, nrelocs)) == NULL)
+        return -ENOMEM;
+
+    /* Only now: making room may have flushed cb */
+    base = cb->nrelocs;
+    memcpy(p, buf, ndw * sizeof(uint32_t));
+
+    for(i = 0; i < nrelocs; i++) {
+        r = &cb->relocs[base + i];
+        *r = relocs[i];
+        r->cdw += cb->cdw - start;
+        r->slot = r600_cmdbuf_add_bo(cb, r->bo, r->read_domains, r->write_domain);
+        p[relocs[i].cdw - start + 1] = base + i;
+    }
+    cb->nrelocs += nrelocs;
+
+    return r600_cmdbuf_end(cb, ndw);
+}
+
+static int space_check(struct r600_cmdbuf *cb, struct radeon_cs *cs)
+{
+    struct r600_residency *res = cb->resident;
+    struct r600_bo_slot *s;
+    int ret;
+
+    if(res != NULL && res->cs != cs)
+        res = NULL;
+
+    for(s = cb->bos; s < cb->bos + cb->nbos; s++) {
+        /* libdrm counts the resident ones in with every check anyway */
+        if(res != NULL && r600_residency_covers(res, s->bo, s->read_domains, s->write_domain))
+            continue;
+        ret = radeon_cs_space_check_with_bo(cs, s->bo, s->read_domains, s->write_domain);
+        if(ret != RADEON_CS_SPACE_OK)
+            return ret == RADEON_CS_SPACE_OP_TO_BIG ? -E2BIG : -EAGAIN;
+    }
+
+    if(res != NULL && res->nbos > 0 && (ret = radeon_cs_space_check(cs)) != RADEON_CS_SPACE_OK)
+        return ret == RADEON_CS_SPACE_OP_TO_BIG ? -E2BIG : -EAGAIN;
+
+    return 0;
+}
+
+static int write_reloc(struct r600_cmdbuf *cb, struct radeon_cs *cs, const struct r600_reloc *r)
+{
+    struct r600_bo_slot *s = &cb->bos[r->slot];
+    int ret;
+
+    /* libdrm would only find the BO and write the same NOP again */
+    if((s->sent_read | s->sent_write) != 0 &&
+       (r->read_domains & ~s->sent_read) == 0 && (r->write_domain & ~s->sent_write) == 0) {
+        radeon_cs_write_table(cs, s->nop, R600_RELOC_DW);
+        return 0;
+    }
+
+    if((ret = radeon_cs_write_reloc(cs, r->bo, r->read_domains, r->write_domain, 0)) != 0)
+        return ret;
+
+    memcpy(s->nop, cs->packets + cs->cdw - R600_RELOC_DW, sizeof(s->nop));
+    s->sent_read |= r->read_domains;
+    s->sent_write |= r->write_domain;
+
+    return 0;
+}
+
+int r600_cmdbuf_submit(struct r600_cmdbuf *cb, struct radeon_cs *cs)
+{
+    struct r600_signal *sig;
+    struct r600_reloc *r;
+    unsigned pos = 0;
+    int ret;
+
+    if(cb->cdw == 0)
+        return 0;
+
+    if(cb->validator != NULL && (ret = r600_validator_check(cb->validator, cb)) != 0)
+        return ret;
+
+    if((ret = space_check(cb, cs)) != 0)
+        return ret;
+
+    if(cb->capture != NULL)
+        r600_capture_contents(cb->capture, cb);
+
+    radeon_cs_begin(cs, cb->cdw, __FILE__, __func__, __LINE__);
+
+    for(r = cb->relocs; r < cb->relocs + cb->nrelocs; r++) {
+        if(r->cdw > pos)
+            radeon_cs_write_table(cs, cb->buf + pos, r->cdw - pos);
+        if((ret = write_reloc(cb, cs, r)) != 0) {
+            radeon_cs_erase(cs);
+            r600_cmdbuf_reset(cb);
+            return ret;
+        }
+        pos = r->cdw + R600_RELOC_DW;
+    }
+    if(cb->cdw > pos)
+        radeon_cs_write_table(cs, cb->buf + pos, cb->cdw - pos);
+
+    radeon_cs_end(cs, __FILE__, __func__, __LINE__);
+
+    ret = radeon_cs_emit(cs);
+    if(ret == 0) {
+        for(sig = cb->signals; sig < cb->signals + cb->nsignals; sig++) {
+            if(*sig->submitted < sig->value)
+                *sig->submitted = sig->value;
+        }
+        if(cb->capture != NULL)
+            r600_capture_submit(cb->capture, cb);
+    }
+    radeon_cs_erase(cs);
+    r600_cmdbuf_reset(cb);
+
+    return ret;
+}
@@ -0,0 +1,850 @@
+/**
+ * r600_cmdbuf.h: PM4 command buffer builder
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_CMDBUF_H_
+#define _R600_CMDBUF_H_
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+
+#include <radeon_bo.h>
+#include <radeon_cs.h>
+
+#include "r600_reg.h"
+
+/*
+ * Packets are built in host memory, one inline function per Packet3 type.
+ * Each function reserves its (compile-time constant) size once, stores the
+ * header and payload straight into the buffer and bumps the write pointer.
+ * Debug builds walk every packet written and check that the header counts
+ * add up to the reserved size; with NDEBUG that all compiles away.
+ *
+ * A buffer object reference is recorded as a two-dword IT_NOP right after
+ * the packet that uses it, carrying the index of the relocation in our own
+ * table.  On submission each one is replaced by radeon_cs_write_reloc(),
+ * which writes the same NOP with the kernel's index, so the layout of the
+ * stream is what the kernel's checker expects.
+ *
+ * Dispatches name the same few buffers (constants, tables) over and over.
+ * Each BO gets one entry in cb->bos the first time a relocation names it,
+ * found again through a hash index, and every later relocation only
+ * points at that entry; submission space-checks and writes the kernel
+ * relocation once per entry, not once per reference.
+ */
+
+/* n is the number of payload dwords */
+#define PACKET3(op, n)      (0xc0000000 | ((((n) - 1) & 0x3fff) << 16) | (((op) & 0xff) << 8))
+#define PACKET2             0x80000000
+#define PACKET_TYPE(hdr)    ((hdr) >> 30)
+#define PACKET3_OP(hdr)     (((hdr) >> 8) & 0xff)
+/* Whole packet, header included, for type 0 and type 3 packets */
+#define PACKET_NDW(hdr)     ((((hdr) >> 16) & 0x3fff) + 2)
+
+#define R600_RELOC_DW       2
+
+/* Whole-packet sizes in dwords, relocations included */
+enum {
+    R600_SURFACE_SYNC_DW        = 5,
+    R600_SURFACE_SYNC_BO_DW     = 5 + R600_RELOC_DW,
+    R600_EVENT_WRITE_DW         = 2,
+    R600_EVENT_WRITE_EOP_DW     = 6 + R600_RELOC_DW,
+    R600_MEM_WRITE_DW           = 5 + R600_RELOC_DW,
+    R600_WAIT_REG_DW            = 7,
+    R600_WAIT_MEM_DW            = 7 + R600_RELOC_DW,
+    R600_COND_EXEC_DW           = 4 + R600_RELOC_DW,
+    R600_PRED_EXEC_DW           = 2,
+    R600_SET_PREDICATION_DW     = 3 + R600_RELOC_DW,
+    R600_INDIRECT_BUFFER_DW     = 4 + R600_RELOC_DW,
+    R600_CP_DMA_DW              = 6 + 2 * R600_RELOC_DW,
+    R600_CONTEXT_CONTROL_DW     = 3,
+    R600_INDEX_TYPE_DW          = 2,
+    R600_NUM_INSTANCES_DW       = 2,
+    R600_DRAW_INDEX_AUTO_DW     = 3,
+    R600_SURFACE_BASE_UPDATE_DW = 2,
+    R600_SET_VTX_RESOURCE_DW    = 9 + R600_RELOC_DW,
+    R600_SET_TEX_RESOURCE_DW    = 9 + 2 * R600_RELOC_DW,
+    R600_SET_SAMPLER_DW         = 5,
+    R600_SET_REG_BO_DW          = 3 + R600_RELOC_DW,
+};
+
+/* SET_*_REG with n consecutive registers */
+#define R600_SET_REGS_DW(n)     (2 + (n))
+
+/* Resource and sampler slots, in dwords */
+#define R600_RESOURCE_DWORDS    7
+#define R600_SAMPLER_DWORDS     3
+
+/* IT_EVENT_WRITE and IT_EVENT_WRITE_EOP */
+#define IT_EVENT_INDEX(x)       ((x) << 8)
+#define IT_EOP_INT_SEL(x)       ((x) << 24)     /* 0 none, 2 after write confirm */
+#define IT_EOP_DATA_SEL(x)      ((x) << 29)     /* 0 none, 1 low 32, 2 64 bits */
+
+struct r600_reloc {
+    struct radeon_bo *bo;
+    uint32_t read_domains, write_domain;
+    unsigned cdw;           /* where its NOP packet sits */
+    unsigned slot;          /* its BO's entry in the cmdbuf's bos */
+};
+
+/* One per distinct BO in a cmdbuf */
+struct r600_bo_slot {
+    struct radeon_bo *bo;
+    uint32_t read_domains, write_domain;    /* of all its relocations */
+    uint32_t sent_read, sent_write;         /* passed to radeon_cs_write_reloc() */
+    uint32_t nop[R600_RELOC_DW];            /* ... and what it wrote */
+    unsigned hash;                          /* where bo_hash points at it */
+};
+
+/*
+ * A signal in a cmdbuf: once the cmdbuf has been submitted, *submitted is
+ * raised to value.  Signals only come with the cmdbuf they were emitted
+ * into, not with packets appended from elsewhere.
+ */
+struct r600_signal {
+    uint64_t *submitted;
+    uint64_t value;
+    unsigned cdw;           /* where its packet starts */
+};
+
+struct r600_capture;
+struct r600_residency;
+struct r600_validator;
+
+struct r600_cmdbuf {
+    uint32_t *buf;
+    unsigned cdw, ndw;
+
+    struct r600_reloc *relocs;
+    unsigned nrelocs, max_relocs;
+
+    /*
+     * If set, called instead of growing the buffer when a packet doesn't
+     * fit; it is expected to submit and reset cb, and may put packets at
+     * the start of the new segment (seg_start/seg_relocs mark where they
+     * end).  A packet bigger than a whole segment still grows the buffer.
+     */
+    int (*flush)(struct r600_cmdbuf *cb, void *data);
+    void *flush_data;
+    int flushing;
+
+    unsigned segment;       /* bumped by every reset */
+    unsigned seg_start, seg_relocs;
+
+    /* Dwords kept free at the end of a segment for packets that close it */
+    unsigned tail;
+
+    /*
+     * Set if cb only ever goes to r600_standin.h, which runs packets the
+     * kernel's checker rejects (IT_COND_EXEC); see r600_cond.h.
+     */
+    int standin;
+
+    /* If set, checks (some of) the submissions; see r600_validate.h */
+    struct r600_validator *validator;
+
+    /* If set, records every submission; see r600_trace.h */
+    struct r600_capture *capture;
+
+    /*
+     * The BOs the relocations name, in order of first use; bo_hash holds
+     * 1 + their indices (0 for a free slot) and is never more than half
+     * full, as there is room for twice max_relocs.
+     */
+    struct r600_bo_slot *bos;
+    unsigned nbos;
+    unsigned *bo_hash;
+    unsigned hash_mask;
+
+    /* If set, BOs that need no space check of their own; see r600_resid.h */
+    struct r600_residency *resident;
+
+    struct r600_signal *signals;
+    unsigned nsignals, max_signals;
+};
+
+/* A position to roll back to if building a group of packets fails */
+struct r600_cmdbuf_mark {
+    unsigned cdw, nrelocs, segment;
+};
+
+struct r600_cmdbuf *r600_cmdbuf_create(unsigned ndw);
+void r600_cmdbuf_destroy(struct r600_cmdbuf *cb);
+
+/* Drops all packets and relocations */
+void r600_cmdbuf_reset(struct r600_cmdbuf *cb);
+
+/* Makes room for ndw more dwords and nrelocs more relocations */
+int r600_cmdbuf_grow(struct r600_cmdbuf *cb, unsigned ndw, unsigned nrelocs);
+
+/* Sets the capacity, which can't go below what is already in cb */
+int r600_cmdbuf_resize(struct r600_cmdbuf *cb, unsigned ndw);
+
+/*
+ * Notes a signal whose packet starts at cdw, for r600_cmdbuf_submit() to
+ * credit.  Returns 0 or -ENOMEM, in which case it is never credited.
+ */
+int r600_cmdbuf_add_signal(struct r600_cmdbuf *cb, uint64_t *submitted, uint64_t value,
+                           unsigned cdw);
+
+/* Rebuilds cb->bos from the relocations, after some were dropped */
+void r600_cmdbuf_reindex(struct r600_cmdbuf *cb);
+
+/*
+ * Appends ndw dwords of packets recorded elsewhere along with their
+ * nrelocs relocations, renumbered for cb.  The relocations' cdw fields
+ * count from start dwords before buf.  Returns 0 or -ENOMEM.
+ */
+int r600_cmdbuf_append(struct r600_cmdbuf *cb, const uint32_t *buf, unsigned ndw,
+                       const struct r600_reloc *relocs, unsigned nrelocs,
+                       unsigned start);
+
+/*
+ * Copies the packets into cs, turning our relocations into the kernel's,
+ * submits it and resets both.  Returns 0 or a negative errno value.
+ *
+ * However many relocations name a BO, it is space-checked once and goes
+ * through radeon_cs_write_reloc() only as often as its domains change;
+ * libdrm's search of the relocations so far is skipped for the rest,
+ * whose NOPs are copies of the first.  BOs in cb->resident, if that is
+ * declared on cs, are left to the one check of the whole set.
+ *
+ * With a validator set, a submission it rejects fails with -EINVAL before
+ * anything reaches cs, and cb is left as it was.  The signals in cb are
+ * credited only once radeon_cs_emit() has succeeded.
+ */
+int r600_cmdbuf_submit(struct r600_cmdbuf *cb, struct radeon_cs *cs);
+
+#ifndef NDEBUG
+/* Every header in [p, p + ndw) must chain to exactly p + ndw */
+static inline void r600_cmdbuf_check(const uint32_t *p, unsigned ndw)
+{
+    unsigned i = 0;
+
+    while(i < ndw)
+        i += PACKET_TYPE(p[i]) == 2 ? 1 : PACKET_NDW(p[i]);
+
+    assert(i == ndw);
+}
+#else
+#define r600_cmdbuf_check(p, ndw) ((void) 0)
+#endif
+
+/* Returns where the packet goes, or NULL if the buffer could not grow */
+static inline uint32_t *r600_cmdbuf_begin(struct r600_cmdbuf *cb,
+                                          unsigned ndw, unsigned nrelocs)
+{
+    if((cb->cdw + ndw + cb->tail > cb->ndw || cb->nrelocs + nrelocs > cb->max_relocs) &&
+       r600_cmdbuf_grow(cb, ndw, nrelocs) != 0)
+        return NULL;
+
+    return cb->buf + cb->cdw;
+}
+
+static inline int r600_cmdbuf_end(struct r600_cmdbuf *cb, unsigned ndw)
+{
+    r600_cmdbuf_check(cb->buf + cb->cdw, ndw);
+    cb->cdw += ndw;
+    return 0;
+}
+
+/* Makes sure the next ndw dwords go into one segment, e.g. for COND_EXEC */
+static inline int r600_cmdbuf_reserve(struct r600_cmdbuf *cb, unsigned ndw, unsigned nrelocs)
+{
+    return r600_cmdbuf_begin(cb, ndw, nrelocs) != NULL ? 0 : -ENOMEM;
+}
+
+static inline void r600_cmdbuf_mark(const struct r600_cmdbuf *cb, struct r600_cmdbuf_mark *m)
+{
+    m->cdw = cb->cdw;
+    m->nrelocs = cb->nrelocs;
+    m->segment = cb->segment;
+}
+
+/* What was submitted since the mark stays submitted; the rest is dropped */
+static inline void r600_cmdbuf_rollback(struct r600_cmdbuf *cb, const struct r600_cmdbuf_mark *m)
+{
+    unsigned nrelocs = cb->nrelocs;
+
+    if(m->segment == cb->segment) {
+        cb->cdw = m->cdw;
+        cb->nrelocs = m->nrelocs;
+    } else {
+        cb->cdw = cb->seg_start;
+        cb->nrelocs = cb->seg_relocs;
+    }
+
+    /* The dropped relocations may have been all that named some BOs */
+    if(cb->nrelocs < nrelocs)
+        r600_cmdbuf_reindex(cb);
+
+    while(cb->nsignals > 0 && cb->signals[cb->nsignals - 1].cdw >= cb->cdw)
+        cb->nsignals--;
+}
+
+static inline unsigned r600_bo_hash(const struct radeon_bo *bo)
+{
+    return (unsigned) (((uintptr_t) bo >> 4) * 0x9e3779b97f4a7c15ull >> 40);
+}
+
+/*
+ * Returns bo's entry in cb->bos, adding it if need be, and widens its
+ * domains.  There is always room, as no more BOs than relocations fit.
+ */
+static inline unsigned r600_cmdbuf_add_bo(struct r600_cmdbuf *cb, struct radeon_bo *bo,
+                                          uint32_t read_domains, uint32_t write_domain)
+{
+    unsigned h = r600_bo_hash(bo) & cb->hash_mask, i;
+    struct r600_bo_slot *s;
+
+    while((i = cb->bo_hash[h]) != 0) {
+        s = &cb->bos[i - 1];
+        if(s->bo == bo) {
+            s->read_domains |= read_domains;
+            s->write_domain |= write_domain;
+            return i - 1;
+        }
+        h = (h + 1) & cb->hash_mask;
+    }
+
+    s = &cb->bos[cb->nbos];
+    s->bo = bo;
+    s->read_domains = read_domains;
+    s->write_domain = write_domain;
+    s->sent_read = s->sent_write = 0;
+    s->hash = h;
+    cb->bo_hash[h] = ++cb->nbos;
+
+    return cb->nbos - 1;
+}
+
+/* Writes the relocation NOP at p, which must be inside a begun packet */
+static inline void r600_cmdbuf_reloc(struct r600_cmdbuf *cb, uint32_t *p,
+                                     struct radeon_bo *bo,
+                                     uint32_t read_domains, uint32_t write_domain)
+{
+    struct r600_reloc *r = &cb->relocs[cb->nrelocs];
+
+    r->bo = bo;
+    r->read_domains = read_domains;
+    r->write_domain = write_domain;
+    r->cdw = p - cb->buf;
+    r->slot = r600_cmdbuf_add_bo(cb, bo, read_domains, write_domain);
+
+    p[0] = PACKET3(IT_NOP, 1);
+    p[1] = cb->nrelocs++;
+}
+
+/* Which IT_SET_* covers reg, and the start of its window; 0 if none */
+static inline unsigned r600_set_reg_op(uint32_t reg, uint32_t *base)
+{
+#define RANGE(name)                                                          \
+    if(reg >= SET_##name##_offset && reg < SET_##name##_end) {               \
+        *base = SET_##name##_offset;                                         \
+        return IT_SET_##name;                                                \
+    }
+    RANGE(CONFIG_REG)
+    RANGE(CONTEXT_REG)
+    RANGE(ALU_CONST)
+    RANGE(RESOURCE)
+    RANGE(SAMPLER)
+    RANGE(CTL_CONST)
+    RANGE(LOOP_CONST)
+    RANGE(BOOL_CONST)
+#undef RANGE
+
+    return 0;
+}
+
+/* The start of the window an IT_SET_* packet addresses; 0 for other opcodes */
+static inline uint32_t r600_set_op_base(unsigned op)
+{
+    switch(op) {
+    case IT_SET_CONFIG_REG:  return SET_CONFIG_REG_offset;
+    case IT_SET_CONTEXT_REG: return SET_CONTEXT_REG_offset;
+    case IT_SET_ALU_CONST:   return SET_ALU_CONST_offset;
+    case IT_SET_RESOURCE:    return SET_RESOURCE_offset;
+    case IT_SET_SAMPLER:     return SET_SAMPLER_offset;
+    case IT_SET_CTL_CONST:   return SET_CTL_CONST_offset;
+    case IT_SET_LOOP_CONST:  return SET_LOOP_CONST_offset;
+    case IT_SET_BOOL_CONST:  return SET_BOOL_CONST_offset;
+    default:                 return 0;
+    }
+}
+
+/* ... and its end */
+static inline uint32_t r600_set_op_end(unsigned op)
+{
+    switch(op) {
+    case IT_SET_CONFIG_REG:  return SET_CONFIG_REG_end;
+    case IT_SET_CONTEXT_REG: return SET_CONTEXT_REG_end;
+    case IT_SET_ALU_CONST:   return SET_ALU_CONST_end;
+    case IT_SET_RESOURCE:    return SET_RESOURCE_end;
+    case IT_SET_SAMPLER:     return SET_SAMPLER_end;
+    case IT_SET_CTL_CONST:   return SET_CTL_CONST_end;
+    case IT_SET_LOOP_CONST:  return SET_LOOP_CONST_end;
+    case IT_SET_BOOL_CONST:  return SET_BOOL_CONST_end;
+    default:                 return 0;
+    }
+}
+
+/* Packet emitters; all return 0 or -ENOMEM */
+
+static inline int r600_emit_nop(struct r600_cmdbuf *cb, unsigned payload)
+{
+    uint32_t *p;
+    unsigned i;
+
+    if(payload == 0 || (p = r600_cmdbuf_begin(cb, payload + 1, 0)) == NULL)
+        return payload == 0 ? 0 : -ENOMEM;
+
+    p[0] = PACKET3(IT_NOP, payload);
+    for(i = 1; i <= payload; i++)
+        p[i] = 0;
+
+    return r600_cmdbuf_end(cb, payload + 1);
+}
+
+/* Any register run inside one SET_* window */
+static inline int r600_emit_set_regs(struct r600_cmdbuf *cb, uint32_t reg,
+                                     unsigned n, const uint32_t *vals)
+{
+    uint32_t *p, base = 0;
+    unsigned op = r600_set_reg_op(reg, &base), i;
+
+    assert(op != 0 && n > 0);
+    assert(r600_set_reg_op(reg + 4 * (n - 1), &base) == op);
+
+    if((p = r600_cmdbuf_begin(cb, R600_SET_REGS_DW(n), 0)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(op, n + 1);
+    p[1] = (reg - base) >> 2;
+    for(i = 0; i < n; i++)
+        p[2 + i] = vals[i];
+
+    return r600_cmdbuf_end(cb, R600_SET_REGS_DW(n));
+}
+
+static inline int r600_emit_set_reg(struct r600_cmdbuf *cb, uint32_t reg, uint32_t val)
+{
+    return r600_emit_set_regs(cb, reg, 1, &val);
+}
+
+/* A register holding an address (in 256-byte units) in bo, e.g. CB_COLOR0_BASE */
+static inline int r600_emit_set_reg_bo(struct r600_cmdbuf *cb, uint32_t reg, uint32_t value,
+                                       struct radeon_bo *bo,
+                                       uint32_t read_domains, uint32_t write_domain)
+{
+    uint32_t *p, base = 0;
+    unsigned op = r600_set_reg_op(reg, &base);
+
+    assert(op != 0);
+
+    if((p = r600_cmdbuf_begin(cb, R600_SET_REG_BO_DW, 1)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(op, 2);
+    p[1] = (reg - base) >> 2;
+    p[2] = value;
+    r600_cmdbuf_reloc(cb, p + 3, bo, read_domains, write_domain);
+
+    return r600_cmdbuf_end(cb, R600_SET_REG_BO_DW);
+}
+
+/* Typed wrappers that also check the register is in the right window */
+#define R600_SET_WRAPPER(fn, name)                                           \
+    static inline int fn(struct r600_cmdbuf *cb, uint32_t reg,               \
+                         unsigned n, const uint32_t *vals)                   \
+    {                                                                        \
+        assert(reg >= SET_##name##_offset &&                                 \
+               reg + 4 * n <= SET_##name##_end);                             \
+        return r600_emit_set_regs(cb, reg, n, vals);                         \
+    }
+R600_SET_WRAPPER(r600_emit_set_config_regs, CONFIG_REG)
+R600_SET_WRAPPER(r600_emit_set_context_regs, CONTEXT_REG)
+R600_SET_WRAPPER(r600_emit_set_alu_consts, ALU_CONST)
+R600_SET_WRAPPER(r600_emit_set_ctl_consts, CTL_CONST)
+R600_SET_WRAPPER(r600_emit_set_loop_consts, LOOP_CONST)
+R600_SET_WRAPPER(r600_emit_set_bool_consts, BOOL_CONST)
+#undef R600_SET_WRAPPER
+
+/* Vertex-buffer resource: words[0] is the offset into bo */
+static inline int r600_emit_set_vtx_resource(struct r600_cmdbuf *cb, unsigned slot,
+                                             const uint32_t words[R600_RESOURCE_DWORDS],
+                                             struct radeon_bo *bo, uint32_t domains)
+{
+    uint32_t *p;
+    unsigned i;
+
+    if((p = r600_cmdbuf_begin(cb, R600_SET_VTX_RESOURCE_DW, 1)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(IT_SET_RESOURCE, 8);
+    p[1] = slot * R600_RESOURCE_DWORDS;
+    for(i = 0; i < R600_RESOURCE_DWORDS; i++)
+        p[2 + i] = words[i];
+    r600_cmdbuf_reloc(cb, p + 9, bo, domains, 0);
+
+    return r600_cmdbuf_end(cb, R600_SET_VTX_RESOURCE_DW);
+}
+
+/* Texture resource: base (word 2) and mip (word 3) addresses are relocated */
+static inline int r600_emit_set_tex_resource(struct r600_cmdbuf *cb, unsigned slot,
+                                             const uint32_t words[R600_RESOURCE_DWORDS],
+                                             struct radeon_bo *bo, struct radeon_bo *mip_bo,
+                                             uint32_t domains)
+{
+    uint32_t *p;
+    unsigned i;
+
+    if((p = r600_cmdbuf_begin(cb, R600_SET_TEX_RESOURCE_DW, 2)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(IT_SET_RESOURCE, 8);
+    p[1] = slot * R600_RESOURCE_DWORDS;
+    for(i = 0; i < R600_RESOURCE_DWORDS; i++)
+        p[2 + i] = words[i];
+    r600_cmdbuf_reloc(cb, p + 9, bo, domains, 0);
+    r600_cmdbuf_reloc(cb, p + 11, mip_bo != NULL ? mip_bo : bo, domains, 0);
+
+    return r600_cmdbuf_end(cb, R600_SET_TEX_RESOURCE_DW);
+}
+
+static inline int r600_emit_set_sampler(struct r600_cmdbuf *cb, unsigned slot,
+                                        const uint32_t words[R600_SAMPLER_DWORDS])
+{
+    uint32_t *p;
+
+    if((p = r600_cmdbuf_begin(cb, R600_SET_SAMPLER_DW, 0)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(IT_SET_SAMPLER, 4);
+    p[1] = slot * R600_SAMPLER_DWORDS;
+    p[2] = words[0];
+    p[3] = words[1];
+    p[4] = words[2];
+
+    return r600_cmdbuf_end(cb, R600_SET_SAMPLER_DW);
+}
+
+/* Flush/invalidate the caches in cntl for everything */
+static inline int r600_emit_surface_sync_all(struct r600_cmdbuf *cb, uint32_t cntl)
+{
+    uint32_t *p;
+
+    if((p = r600_cmdbuf_begin(cb, R600_SURFACE_SYNC_DW, 0)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(IT_SURFACE_SYNC, 4);
+    p[1] = cntl;            /* CP_COHER_CNTL */
+    p[2] = 0xffffffff;      /* CP_COHER_SIZE */
+    p[3] = 0;               /* CP_COHER_BASE */
+    p[4] = 10;              /* poll interval */
+
+    return r600_cmdbuf_end(cb, R600_SURFACE_SYNC_DW);
+}
+
+/* ... or just for [offset, offset + size) of bo */
+static inline int r600_emit_surface_sync(struct r600_cmdbuf *cb, uint32_t cntl,
+                                         struct radeon_bo *bo, uint32_t offset,
+                                         uint32_t size, uint32_t domains)
+{
+    uint32_t *p;
+
+    if((p = r600_cmdbuf_begin(cb, R600_SURFACE_SYNC_BO_DW, 1)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(IT_SURFACE_SYNC, 4);
+    p[1] = cntl;
+    p[2] = (size + (offset & 0xff) + 255) >> 8;     /* 256-byte units */
+    p[3] = offset >> 8;
+    p[4] = 10;
+    r600_cmdbuf_reloc(cb, p + 5, bo, domains, 0);
+
+    return r600_cmdbuf_end(cb, R600_SURFACE_SYNC_BO_DW);
+}
+
+static inline int r600_emit_event_write(struct r600_cmdbuf *cb, uint32_t event)
+{
+    uint32_t *p;
+
+    if((p = r600_cmdbuf_begin(cb, R600_EVENT_WRITE_DW, 0)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(IT_EVENT_WRITE, 1);
+    p[1] = event | IT_EVENT_INDEX(0);
+
+    return r600_cmdbuf_end(cb, R600_EVENT_WRITE_DW);
+}
+
+/* Writes value to bo + offset once everything before it has drained */
+static inline int r600_emit_event_write_eop(struct r600_cmdbuf *cb, uint32_t event,
+                                            struct radeon_bo *bo, uint32_t offset,
+                                            uint32_t domain, uint64_t value,
+                                            unsigned data_sel, unsigned int_sel)
+{
+    uint32_t *p;
+
+    if((p = r600_cmdbuf_begin(cb, R600_EVENT_WRITE_EOP_DW, 1)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(IT_EVENT_WRITE_EOP, 5);
+    p[1] = event | IT_EVENT_INDEX(5);
+    p[2] = offset;
+    p[3] = IT_EOP_DATA_SEL(data_sel) | IT_EOP_INT_SEL(int_sel);
+    p[4] = (uint32_t) value;
+    p[5] = (uint32_t) (value >> 32);
+    r600_cmdbuf_reloc(cb, p + 6, bo, 0, domain);
+
+    return r600_cmdbuf_end(cb, R600_EVENT_WRITE_EOP_DW);
+}
+
+/* 64-bit write, or 32-bit (low dword only) if data32 */
+static inline int r600_emit_mem_write(struct r600_cmdbuf *cb, struct radeon_bo *bo,
+                                      uint32_t offset, uint32_t domain,
+                                      uint64_t value, int data32)
+{
+    uint32_t *p;
+
+    if((p = r600_cmdbuf_begin(cb, R600_MEM_WRITE_DW, 1)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(IT_MEM_WRITE, 4);
+    p[1] = offset;
+    p[2] = data32 ? IT_MEM_WRITE_DATA32 : 0;
+    p[3] = (uint32_t) value;
+    p[4] = (uint32_t) (value >> 32);
+    r600_cmdbuf_reloc(cb, p + 5, bo, 0, domain);
+
+    return r600_cmdbuf_end(cb, R600_MEM_WRITE_DW);
+}
+
+/* Stalls the CP until (*(bo + offset) & mask) <func> ref; func is IT_WAIT_* */
+static inline int r600_emit_wait_mem(struct r600_cmdbuf *cb, unsigned func,
+                                     struct radeon_bo *bo, uint32_t offset,
+                                     uint32_t domains, uint32_t ref, uint32_t mask)
+{
+    uint32_t *p;
+
+    if((p = r600_cmdbuf_begin(cb, R600_WAIT_MEM_DW, 1)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(IT_WAIT_REG_MEM, 6);
+    p[1] = func | IT_WAIT_MEM;
+    p[2] = offset;
+    p[3] = 0;
+    p[4] = ref;
+    p[5] = mask;
+    p[6] = 10;          /* poll interval */
+    r600_cmdbuf_reloc(cb, p + 7, bo, domains, 0);
+
+    return r600_cmdbuf_end(cb, R600_WAIT_MEM_DW);
+}
+
+/* Same, polling a register */
+static inline int r600_emit_wait_reg(struct r600_cmdbuf *cb, unsigned func,
+                                     uint32_t reg, uint32_t ref, uint32_t mask)
+{
+    uint32_t *p;
+
+    if((p = r600_cmdbuf_begin(cb, R600_WAIT_REG_DW, 0)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(IT_WAIT_REG_MEM, 6);
+    p[1] = func | IT_WAIT_REG;
+    p[2] = IT_WAIT_ADDR(reg);
+    p[3] = 0;
+    p[4] = ref;
+    p[5] = mask;
+    p[6] = 10;
+
+    return r600_cmdbuf_end(cb, R600_WAIT_REG_DW);
+}
+
+/* Executes the next ndw dwords only if the dword at bo + offset is nonzero */
+static inline int r600_emit_cond_exec(struct r600_cmdbuf *cb, struct radeon_bo *bo,
+                                      uint32_t offset, uint32_t domains, unsigned ndw)
+{
+    uint32_t *p;
+
+    if((p = r600_cmdbuf_begin(cb, R600_COND_EXEC_DW, 1)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(IT_COND_EXEC, 3);
+    p[1] = offset;
+    p[2] = 0;
+    p[3] = ndw;
+    r600_cmdbuf_reloc(cb, p + 4, bo, domains, 0);
+
+    return r600_cmdbuf_end(cb, R600_COND_EXEC_DW);
+}
+
+/* Executes the next ndw dwords only if the predicate is set */
+static inline int r600_emit_pred_exec(struct r600_cmdbuf *cb, unsigned ndw)
+{
+    uint32_t *p;
+
+    if((p = r600_cmdbuf_begin(cb, R600_PRED_EXEC_DW, 0)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(IT_PRED_EXEC, 1);
+    p[1] = ndw;
+
+    return r600_cmdbuf_end(cb, R600_PRED_EXEC_DW);
+}
+
+/* op carries the PRED_OP and hint bits for the ADDR_HI dword */
+static inline int r600_emit_set_predication(struct r600_cmdbuf *cb, uint32_t op,
+                                            struct radeon_bo *bo, uint32_t offset,
+                                            uint32_t domains)
+{
+    uint32_t *p;
+
+    if((p = r600_cmdbuf_begin(cb, R600_SET_PREDICATION_DW, 1)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(IT_SET_PREDICATION, 2);
+    p[1] = offset;
+    p[2] = op;
+    r600_cmdbuf_reloc(cb, p + 3, bo, domains, 0);
+
+    return r600_cmdbuf_end(cb, R600_SET_PREDICATION_DW);
+}
+
+static inline int r600_emit_indirect_buffer(struct r600_cmdbuf *cb, struct radeon_bo *bo,
+                                            uint32_t offset, uint32_t domains,
+                                            unsigned ndw)
+{
+    uint32_t *p;
+
+    if((p = r600_cmdbuf_begin(cb, R600_INDIRECT_BUFFER_DW, 1)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(IT_INDIRECT_BUFFER, 3);
+    p[1] = offset;
+    p[2] = 0;
+    p[3] = ndw;
+    r600_cmdbuf_reloc(cb, p + 4, bo, domains, 0);
+
+    return r600_cmdbuf_end(cb, R600_INDIRECT_BUFFER_DW);
+}
+
+/* At most IT_CP_DMA_MAX_BYTES; sync makes the CP wait for it to land */
+static inline int r600_emit_cp_dma(struct r600_cmdbuf *cb,
+                                   struct radeon_bo *dst, uint32_t dst_offset,
+                                   uint32_t dst_domain,
+                                   struct radeon_bo *src, uint32_t src_offset,
+                                   uint32_t src_domain,
+                                   uint32_t bytes, int sync)
+{
+    uint32_t *p;
+
+    if((p = r600_cmdbuf_begin(cb, R600_CP_DMA_DW, 2)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(IT_CP_DMA, 5);
+    p[1] = src_offset;
+    p[2] = sync ? IT_CP_DMA_CP_SYNC : 0;
+    p[3] = dst_offset;
+    p[4] = 0;
+    p[5] = bytes;
+    /* The kernel patches the source address first, then the destination */
+    r600_cmdbuf_reloc(cb, p + 6, src, src_domain, 0);
+    r600_cmdbuf_reloc(cb, p + 8, dst, 0, dst_domain);
+
+    return r600_cmdbuf_end(cb, R600_CP_DMA_DW);
+}
+
+static inline int r600_emit_context_control(struct r600_cmdbuf *cb,
+                                            uint32_t load, uint32_t shadow)
+{
+    uint32_t *p;
+
+    if((p = r600_cmdbuf_begin(cb, R600_CONTEXT_CONTROL_DW, 0)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(IT_CONTEXT_CONTROL, 2);
+    p[1] = load;
+    p[2] = shadow;
+
+    return r600_cmdbuf_end(cb, R600_CONTEXT_CONTROL_DW);
+}
+
+static inline int r600_emit_index_type(struct r600_cmdbuf *cb, uint32_t type)
+{
+    uint32_t *p;
+
+    if((p = r600_cmdbuf_begin(cb, R600_INDEX_TYPE_DW, 0)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(IT_INDEX_TYPE, 1);
+    p[1] = type;
+
+    return r600_cmdbuf_end(cb, R600_INDEX_TYPE_DW);
+}
+
+static inline int r600_emit_num_instances(struct r600_cmdbuf *cb, uint32_t n)
+{
+    uint32_t *p;
+
+    if((p = r600_cmdbuf_begin(cb, R600_NUM_INSTANCES_DW, 0)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(IT_NUM_INSTANCES, 1);
+    p[1] = n;
+
+    return r600_cmdbuf_end(cb, R600_NUM_INSTANCES_DW);
+}
+
+static inline int r600_emit_draw_index_auto(struct r600_cmdbuf *cb,
+                                            uint32_t count, uint32_t initiator)
+{
+    uint32_t *p;
+
+    if((p = r600_cmdbuf_begin(cb, R600_DRAW_INDEX_AUTO_DW, 0)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(IT_DRAW_INDEX_AUTO, 2);
+    p[1] = count;
+    p[2] = initiator;
+
+    return r600_cmdbuf_end(cb, R600_DRAW_INDEX_AUTO_DW);
+}
+
+static inline int r600_emit_surface_base_update(struct r600_cmdbuf *cb, uint32_t mask)
+{
+    uint32_t *p;
+
+    if((p = r600_cmdbuf_begin(cb, R600_SURFACE_BASE_UPDATE_DW, 0)) == NULL)
+        return -ENOMEM;
+
+    p[0] = PACKET3(IT_SURFACE_BASE_UPDATE, 1);
+    p[1] = mask;
+
+    return r600_cmdbuf_end(cb, R600_SURFACE_BASE_UPDATE_DW);
+}
+
+#endif
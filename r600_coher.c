@@ -0,0 +1,298 @@
+/**
+ * r600_coher.c: surface syncs from tracked cache contents
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <radeon_bo.h>
+
+#include "r600_reg.h"
+#include "r600_cmdbuf.h"
+#include "r600_coher.h"
+
+struct r600_coher *r600_coher_create(void)
+{
+    return calloc(1, sizeof(struct r600_coher));
+}
+
+void r600_coher_destroy(struct r600_coher *c)
+{
+    if(c == NULL)
+        return;
+
+    free(c->ranges);
+    free(c);
+}
+
+void r600_coher_forget(struct r600_coher *c)
+{
+    c->unknown = 1;
+}
+
+static int reserve(struct r600_coher *c, unsigned n)
+{
+    struct r600_coher_range *r;
+    unsigned max;
+
+    if(c->nranges + n <= c->max_ranges)
+        return 0;
+
+    max = c->max_ranges != 0 ? 2 * c->max_ranges : 16;
+    while(max < c->nranges + n)
+        max *= 2;
+    if((r = realloc(c->ranges, max * sizeof(*r))) == NULL)
+        return -ENOMEM;
+
+    c->ranges = r;
+    c->max_ranges = max;
+    return 0;
+}
+
+/* Everything was flushed and invalidated since the ranges were recorded */
+static void check_segment(struct r600_coher *c, const struct r600_cmdbuf *cb)
+{
+    if(c->segment != cb->segment) {
+        c->segment = cb->segment;
+        c->nranges = 0;
+        c->unknown = 0;
+    }
+}
+
+static int same_state(const struct r600_coher_range *a, const struct r600_coher_range *b)
+{
+    return a->dirty == b->dirty && a->cached == b->cached && a->stale == b->stale;
+}
+
+/* The flushes and invalidations an access needs before it can go ahead */
+static uint32_t needs(const struct r600_coher_range *r, uint32_t via, int write)
+{
+    if(write)
+        return (r->dirty & ~via) != 0 ? r->dirty : 0;
+    return r->dirty | (r->stale & via);
+}
+
+static void update(struct r600_coher_range *r, uint32_t via, int write)
+{
+    if(write) {
+        /* Any other writer's data was flushed first */
+        r->dirty = via;
+        r->stale |= r->cached;
+    } else {
+        r->dirty = 0;
+        r->stale &= ~via;
+        r->cached |= via;
+    }
+}
+
+/* Cuts ranges of bo so that none crosses at */
+static int split(struct r600_coher *c, struct radeon_bo *bo, uint32_t at)
+{
+    struct r600_coher_range *r;
+    unsigned i;
+
+    for(i = 0; i < c->nranges; i++) {
+        r = &c->ranges[i];
+        if(r->bo != bo || r->start >= at || r->end <= at)
+            continue;
+        if(reserve(c, 1) != 0)
+            return -ENOMEM;
+        r = &c->ranges[i];
+        c->ranges[c->nranges] = *r;
+        c->ranges[c->nranges++].start = at;
+        r->end = at;
+        break;
+    }
+
+    return 0;
+}
+
+/* Moves the ranges of bo inside [start, end) to the back; returns how many */
+static unsigned partition(struct r600_coher *c, struct radeon_bo *bo,
+                          uint32_t start, uint32_t end)
+{
+    struct r600_coher_range t;
+    unsigned i, k = c->nranges, j;
+
+    for(i = 0; i < k; ) {
+        if(c->ranges[i].bo != bo || c->ranges[i].end <= start || c->ranges[i].start >= end) {
+            i++;
+            continue;
+        }
+        t = c->ranges[i];
+        c->ranges[i] = c->ranges[--k];
+        c->ranges[k] = t;
+    }
+
+    /* By address; there are rarely more than a few */
+    for(i = k + 1; i < c->nranges; i++) {
+        t = c->ranges[i];
+        for(j = i; j > k && c->ranges[j - 1].start > t.start; j--)
+            c->ranges[j] = c->ranges[j - 1];
+        c->ranges[j] = t;
+    }
+
+    return c->nranges - k;
+}
+
+/* Appends r at the end, or grows the last range if it carries on from it */
+static void push(struct r600_coher *c, unsigned first, const struct r600_coher_range *r)
+{
+    struct r600_coher_range *last = c->nranges > first ? &c->ranges[c->nranges - 1] : NULL;
+
+    if(last != NULL && last->end == r->start && same_state(last, r))
+        last->end = r->end;
+    else
+        c->ranges[c->nranges++] = *r;
+}
+
+/* Folds range i into a neighbour of the same BO and state outside [0, n) */
+static int coalesce(struct r600_coher *c, unsigned i, unsigned n)
+{
+    struct r600_coher_range *r = &c->ranges[i], *o;
+    unsigned j;
+
+    for(j = 0; j < n; j++) {
+        o = &c->ranges[j];
+        if(o->bo != r->bo || !same_state(o, r))
+            continue;
+        if(o->end == r->start) {
+            o->end = r->end;
+            return 1;
+        }
+        if(o->start == r->end) {
+            o->start = r->start;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int access(struct r600_coher *c, struct r600_cmdbuf *cb, struct radeon_bo *bo,
+                  uint32_t start, uint32_t size, uint32_t domain, uint32_t via, int write)
+{
+    struct r600_coher_range *r, gap;
+    uint32_t end = start + size, lo = end, hi = start, cntl = 0, cursor;
+    unsigned i, k, m, n;
+    int ret;
+
+    if(start > bo->size || size > bo->size - start)
+        return -EINVAL;
+
+    c->stats.accesses++;
+    if(size == 0) {
+        c->stats.avoided++;
+        return 0;
+    }
+
+    check_segment(c, cb);
+
+    if(c->unknown || c->nranges + 4 > R600_COHER_MAX_RANGES) {
+        if((ret = r600_emit_surface_sync_all(cb, R600_COHER_ALL)) != 0)
+            return ret;
+        c->stats.full++;
+        c->nranges = 0;
+        c->unknown = 0;
+    } else {
+        for(i = 0; i < c->nranges; i++) {
+            r = &c->ranges[i];
+            if(r->bo != bo || r->end <= start || r->start >= end || needs(r, via, write) == 0)
+                continue;
+            cntl |= needs(r, via, write);
+            if(r->start < lo)
+                lo = r->start;
+            if(r->end > hi)
+                hi = r->end;
+        }
+
+        if(cntl == 0) {
+            c->stats.avoided++;
+        } else {
+            lo = lo > start ? lo : start;
+            hi = hi < end ? hi : end;
+            if((ret = r600_emit_surface_sync(cb, cntl, bo, lo, hi - lo, domain)) != 0)
+                return ret;
+            c->stats.syncs++;
+            c->stats.bytes += hi - lo;
+        }
+    }
+
+    /* Making room for the sync may have submitted everything before it */
+    check_segment(c, cb);
+
+    /*
+     * Bring [start, end) up to date: the ranges inside it, cut at its
+     * ends, plus new ones for the gaps between them, with neighbours in
+     * the same state joined back together.
+     */
+    if((ret = split(c, bo, start)) != 0 || (ret = split(c, bo, end)) != 0)
+        return ret;
+    m = partition(c, bo, start, end);
+    k = c->nranges - m;
+    if((ret = reserve(c, 2 * m + 1)) != 0)
+        return ret;
+
+    memset(&gap, 0, sizeof(gap));
+    gap.bo = bo;
+    n = c->nranges;
+    for(i = k, cursor = start; i <= k + m; i++) {
+        gap.start = cursor;
+        gap.end = i < k + m ? c->ranges[i].start : end;
+        if(gap.end > gap.start) {
+            update(&gap, via, write);
+            push(c, n, &gap);
+            gap.dirty = gap.cached = gap.stale = 0;
+        }
+        if(i < k + m) {
+            update(&c->ranges[i], via, write);
+            push(c, n, &c->ranges[i]);
+            cursor = c->ranges[i].end;
+        }
+    }
+    memmove(&c->ranges[k], &c->ranges[n], (c->nranges - n) * sizeof(*c->ranges));
+    c->nranges = k + (c->nranges - n);
+
+    /* Only the first and last can touch a range outside */
+    if(c->nranges > k && coalesce(c, c->nranges - 1, k))
+        c->nranges--;
+    if(c->nranges > k && coalesce(c, k, k))
+        c->ranges[k] = c->ranges[--c->nranges];
+
+    return 0;
+}
+
+int r600_coher_read(struct r600_coher *c, struct r600_cmdbuf *cb, struct radeon_bo *bo,
+                    uint32_t offset, uint32_t size, uint32_t domain, uint32_t via)
+{
+    return access(c, cb, bo, offset, size, domain, via, 0);
+}
+
+int r600_coher_write(struct r600_coher *c, struct r600_cmdbuf *cb, struct radeon_bo *bo,
+                     uint32_t offset, uint32_t size, uint32_t domain, uint32_t via)
+{
+    return access(c, cb, bo, offset, size, domain, via, 1);
+}
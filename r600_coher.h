@@ -0,0 +1,114 @@
+/**
+ * r600_coher.h: surface syncs from tracked cache contents
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_COHER_H_
+#define _R600_COHER_H_
+
+#include <stdint.h>
+
+#include <radeon_bo.h>
+
+#include "r600_reg.h"
+#include "r600_cmdbuf.h"
+
+/*
+ * A dispatch that reads what an earlier one wrote needs an IT_SURFACE_SYNC
+ * between them: one that flushes the cache the write went through (CB,
+ * DB, shader exports) and invalidates the cache the read goes through
+ * (texture, vertex, shader constants) if it may hold an older copy.  A
+ * full flush and invalidate after every dispatch does that, but it also
+ * stalls on caches and ranges that nothing is waiting for.
+ *
+ * The tracker keeps, for each BO range it has seen, which caches hold
+ * unflushed writes to it and which read caches may have a copy, stale or
+ * not.  Accesses are reported as they are recorded, and each one gets
+ * the narrowest sync that covers a real hazard, or none at all.  Caches
+ * are named by their CP_COHER_CNTL bits:
+ *
+ *   writes:  CB_ACTION_ENA_bit | CB<n>_DEST_BASE_ENA_bit, DB_ACTION_ENA_bit
+ *            | DB_DEST_BASE_ENA_bit, SMX_ACTION_ENA_bit for shader
+ *            exports, or 0 for writes that go straight to memory (the
+ *            CP's, the host's);
+ *   reads:   TC_ACTION_ENA_bit, VC_ACTION_ENA_bit, SH_ACTION_ENA_bit, or 0
+ *            for the CP and the host, which only need writes flushed.
+ *
+ * The kernel flushes and invalidates everything between submissions, so
+ * the tracker forgets what it knew whenever cb moves to a new segment.
+ * Syncs it emitted are not taken back by r600_cmdbuf_rollback(); after
+ * one, call r600_coher_forget() so the next access syncs everything.
+ */
+
+/* Every cache the tracker knows about */
+#define R600_COHER_ALL  (TC_ACTION_ENA_bit | VC_ACTION_ENA_bit | SH_ACTION_ENA_bit |    \
+                         CB_ACTION_ENA_bit | DB_ACTION_ENA_bit | SMX_ACTION_ENA_bit |   \
+                         0xff * CB0_DEST_BASE_ENA_bit | DB_DEST_BASE_ENA_bit)
+
+/* Past this many ranges the tracker syncs everything and starts over */
+#define R600_COHER_MAX_RANGES 256
+
+struct r600_coher_range {
+    struct radeon_bo *bo;
+    uint32_t start, end;
+    uint32_t dirty;         /* flushes the writes still cached need */
+    uint32_t cached;        /* read caches that may hold a copy */
+    uint32_t stale;         /* ... of which a write has made out of date */
+};
+
+struct r600_coher_stats {
+    uint64_t accesses;
+    uint64_t syncs;         /* ranged syncs emitted */
+    uint64_t full;          /* whole-memory syncs emitted */
+    uint64_t avoided;       /* accesses that needed no sync */
+    uint64_t bytes;         /* covered by ranged syncs */
+};
+
+struct r600_coher {
+    struct r600_coher_range *ranges;
+    unsigned nranges, max_ranges;
+
+    unsigned segment;       /* cb->segment the ranges belong to */
+    int unknown;            /* the next access syncs everything */
+
+    struct r600_coher_stats stats;
+};
+
+struct r600_coher *r600_coher_create(void);
+void r600_coher_destroy(struct r600_coher *c);
+
+/* Makes the next access flush and invalidate every cache */
+void r600_coher_forget(struct r600_coher *c);
+
+/*
+ * Report that size bytes at offset in bo are about to be read or written
+ * through the caches in via, and emit into cb whatever sync that needs
+ * first.  domain is where bo lives, for the sync's relocation.  Both
+ * return 0 or -ENOMEM.
+ */
+int r600_coher_read(struct r600_coher *c, struct r600_cmdbuf *cb, struct radeon_bo *bo,
+                    uint32_t offset, uint32_t size, uint32_t domain, uint32_t via);
+int r600_coher_write(struct r600_coher *c, struct r600_cmdbuf *cb, struct radeon_bo *bo,
+                     uint32_t offset, uint32_t size, uint32_t domain, uint32_t via);
+
+#endif
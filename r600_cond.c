@@ -0,0 +1,85 @@
+/**
+ * r600_cond.c: stages the CP runs only if an earlier one asks for them
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+
+#include <radeon_bo.h>
+
+#include "r600_cmdbuf.h"
+#include "r600_record.h"
+#include "r600_shadow.h"
+#include "r600_stream.h"
+#include "r600_cond.h"
+
+int r600_cond_append(struct r600_cmdbuf *cb, struct radeon_bo *bo, uint32_t offset,
+                     uint32_t domains, const struct r600_cmdbuf *body)
+{
+    int ret;
+
+    if(!cb->standin)
+        return -ENOTSUP;
+    if((offset & 3) != 0 || (uint64_t) offset + 4 > bo->size)
+        return -EINVAL;
+    if(body->cdw == 0)
+        return 0;
+    if(body->cdw > R600_COND_MAX_DW - R600_RELOC_DW)
+        return -E2BIG;
+
+    /* Once there is room for all of it, neither step below can flush or fail */
+    if((ret = r600_cmdbuf_reserve(cb, R600_COND_EXEC_DW + body->cdw, 1 + body->nrelocs)) != 0)
+        return ret;
+
+    /* The count runs from the end of the packet, so it takes in the relocation NOP */
+    r600_emit_cond_exec(cb, bo, offset, domains, R600_RELOC_DW + body->cdw);
+
+    return r600_cmdbuf_append(cb, body->buf, body->cdw, body->relocs, body->nrelocs, 0);
+}
+
+int r600_merge_cond(struct r600_stream *s, struct radeon_bo *bo, uint32_t offset,
+                    uint32_t domains, struct r600_recorder *rec)
+{
+    int ret;
+
+    if(!s->cb->standin)
+        return -ENOTSUP;
+    if((ret = r600_recorder_end_group(rec)) != 0)
+        return ret;
+
+    if(s->rb != NULL) {
+        ret = r600_regbuf_flush(s->rb, s->cb);
+        if(s->rb->shadow != NULL)
+            r600_shadow_invalidate(s->rb->shadow);
+        if(ret != 0)
+            return ret;
+    }
+
+    if((ret = r600_cond_append(s->cb, bo, offset, domains, rec->cb)) != 0)
+        return ret;
+
+    r600_recorder_reset(rec);
+
+    return 0;
+}
@@ -0,0 +1,81 @@
+/**
+ * r600_cond.h: stages the CP runs only if an earlier one asks for them
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_COND_H_
+#define _R600_COND_H_
+
+#include <stdint.h>
+
+#include <radeon_bo.h>
+
+#include "r600_cmdbuf.h"
+#include "r600_record.h"
+#include "r600_stream.h"
+
+/*
+ * A stage whose input didn't change, or whose producer found nothing to
+ * pass on, need not run; but if the CPU has to look before queueing it,
+ * every such decision costs a round trip.  Instead the stage is put
+ * behind an IT_COND_EXEC naming a dword that an earlier stage writes (a
+ * flag, or a count of records), and the CP itself skips the stage's
+ * packets when that dword is zero.  Guarded stages can nest, so a whole
+ * pipeline goes out in one submission.
+ *
+ * The CP reads the dword when it reaches the packet, which is normally
+ * well before the shaders ahead of it have finished.  Whatever writes it
+ * has to be waited for in between, e.g. with r600_timeline_signal()
+ * followed by r600_timeline_wait_gpu() on the same value.
+ *
+ * A guarded stage is copied in one piece: it never straddles two
+ * submissions, and so has to fit in one.
+ *
+ * The radeon kernel's r600 checker doesn't accept IT_COND_EXEC, and a CS
+ * holding one fails with -EINVAL; nothing else it does accept can skip
+ * arbitrary packets.  So for now only r600_standin.h runs guarded stages,
+ * and both calls below fail with -ENOTSUP unless the cmdbuf is marked
+ * as going there (cb->standin).
+ */
+
+/* Most dwords one IT_COND_EXEC can pass over */
+#define R600_COND_MAX_DW    0x3fff
+
+/*
+ * Appends body's packets to cb so the CP runs them only if the dword at
+ * bo + offset is nonzero.  body is left as it was.  Returns 0, -ENOTSUP
+ * unless cb->standin, -EINVAL for a bad offset, -E2BIG if body is too long
+ * to guard, or -ENOMEM; a failed call adds nothing to cb.
+ */
+int r600_cond_append(struct r600_cmdbuf *cb, struct radeon_bo *bo, uint32_t offset,
+                     uint32_t domains, const struct r600_cmdbuf *body);
+
+/*
+ * The same for everything recorded in rec, merged into s as with
+ * r600_merge() and rec reset afterwards.  Registers the stage sets are
+ * only set if it runs, so the stream's shadow is forgotten.
+ */
+int r600_merge_cond(struct r600_stream *s, struct radeon_bo *bo, uint32_t offset,
+                    uint32_t domains, struct r600_recorder *rec);
+
+#endif
@@ -0,0 +1,463 @@
+/**
+ * r600_const.c: ALU constants, inline or from a constant buffer
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <radeon_bo.h>
+
+#include "r600_reg.h"
+#include "r600_cmdbuf.h"
+#include "r600_regbuf.h"
+#include "r600_const.h"
+
+/* The PS, VS and GS copies of the kcache registers are 0x40 apart */
+#define STAGE_STRIDE    0x40
+
+static uint64_t hash_consts(const uint32_t *data, unsigned ndw)
+{
+    uint64_t h = 0xcbf29ce484222325ull ^ ndw;
+    unsigned i;
+
+    for(i = 0; i < ndw; i++)
+        h = (h ^ data[i]) * 0x100000001b3ull;
+
+    return h ^ h >> 29;
+}
+
+struct r600_constmgr *r600_constmgr_create(struct radeon_bo_manager *bom, uint32_t domain,
+                                           uint32_t sq_config)
+{
+    struct r600_constmgr *cm;
+
+    if((cm = calloc(1, sizeof(*cm))) == NULL)
+        return NULL;
+
+    cm->bom = bom;
+    cm->domain = domain;
+    cm->sq_config = sq_config;
+    cm->mode = -1;
+    cm->next_mode = -1;
+
+    return cm;
+}
+
+void r600_constmgr_destroy(struct r600_constmgr *cm)
+{
+    unsigned i;
+
+    if(cm == NULL)
+        return;
+
+    for(i = 0; i < cm->narenas; i++) {
+        radeon_bo_unmap(cm->arenas[i].bo);
+        radeon_bo_unref(cm->arenas[i].bo);
+    }
+    free(cm->arenas);
+    free(cm->entries);
+    free(cm->hash);
+    free(cm);
+}
+
+void r600_const_block_init(struct r600_const_block *blk, unsigned stage,
+                           unsigned base, unsigned bank)
+{
+    memset(blk, 0, sizeof(*blk));
+    blk->stage = stage;
+    blk->base = base;
+    blk->bank = bank;
+    blk->path = -1;
+
+    /* Until it shows otherwise, every bind is taken to bring new contents */
+    blk->change_rate = 256;
+    blk->miss_rate = 256;
+}
+
+/* The slot for (hash, nvec4): its entry, or the free slot it would go in */
+static unsigned *find(struct r600_constmgr *cm, uint64_t hash, unsigned nvec4)
+{
+    unsigned h = (unsigned) hash & cm->hash_mask;
+    const struct r600_const_entry *e;
+
+    while(cm->hash[h] != 0) {
+        e = &cm->entries[cm->hash[h] - 1];
+        if(e->hash == hash && e->nvec4 == nvec4)
+            break;
+        h = (h + 1) & cm->hash_mask;
+    }
+
+    return &cm->hash[h];
+}
+
+static void rehash(struct r600_constmgr *cm)
+{
+    unsigned i;
+
+    memset(cm->hash, 0, (cm->hash_mask + 1) * sizeof(*cm->hash));
+    for(i = 0; i < cm->nentries; i++)
+        *find(cm, cm->entries[i].hash, cm->entries[i].nvec4) = i + 1;
+}
+
+/* Room for twice as many entries, and an index at most half full */
+static int grow_entries(struct r600_constmgr *cm)
+{
+    unsigned n = cm->max_entries != 0 ? 2 * cm->max_entries : 64, *hash;
+    void *p;
+
+    if((hash = calloc(2 * n, sizeof(*hash))) == NULL)
+        return -ENOMEM;
+    if((p = realloc(cm->entries, n * sizeof(*cm->entries))) == NULL) {
+        free(hash);
+        return -ENOMEM;
+    }
+
+    free(cm->hash);
+    cm->entries = p;
+    cm->max_entries = n;
+    cm->hash = hash;
+    cm->hash_mask = 2 * n - 1;
+    rehash(cm);
+
+    return 0;
+}
+
+/* Forgets everything in arena i so it can be filled again */
+static void recycle(struct r600_constmgr *cm, unsigned i)
+{
+    unsigned j, n = 0;
+
+    for(j = 0; j < cm->nentries; j++) {
+        if(cm->entries[j].arena != i)
+            cm->entries[n++] = cm->entries[j];
+    }
+    cm->nentries = n;
+    rehash(cm);
+
+    cm->arenas[i].used = 0;
+    cm->stats.recycled++;
+}
+
+static int new_arena(struct r600_constmgr *cm, uint32_t bytes)
+{
+    struct r600_const_arena *a;
+    struct radeon_bo *bo;
+    uint32_t size = bytes > R600_CONST_ARENA_SIZE ? bytes : R600_CONST_ARENA_SIZE;
+
+    if((a = realloc(cm->arenas, (cm->narenas + 1) * sizeof(*a))) == NULL)
+        return -ENOMEM;
+    cm->arenas = a;
+
+    if((bo = radeon_bo_open(cm->bom, 0, size, 4096, cm->domain, 0)) == NULL)
+        return -ENOMEM;
+    if(radeon_bo_map(bo, 1) != 0 || bo->ptr == NULL) {
+        radeon_bo_unref(bo);
+        return -ENOMEM;
+    }
+
+    a = &cm->arenas[cm->narenas];
+    a->bo = bo;
+    a->used = 0;
+    a->batch = cm->batch;
+    cm->cur = cm->narenas++;
+
+    return 0;
+}
+
+/* Finds bytes in an arena: the current one, a reusable one, or a new one */
+static int alloc(struct r600_constmgr *cm, uint32_t bytes, unsigned *arena, uint32_t *offset)
+{
+    struct r600_const_arena *a;
+    unsigned i, j;
+    int ret;
+
+    for(i = 0; i <= cm->narenas; i++) {
+        if(i == cm->narenas) {
+            if((ret = new_arena(cm, bytes)) != 0)
+                return ret;
+            break;
+        }
+
+        j = (cm->cur + i) % cm->narenas;
+        a = &cm->arenas[j];
+        if(a->bo->size - a->used >= bytes) {
+            cm->cur = j;
+            break;
+        }
+        if(a->batch != cm->batch && a->bo->size >= bytes &&
+           radeon_bo_is_busy(a->bo, NULL) == 0) {
+            recycle(cm, j);
+            cm->cur = j;
+            break;
+        }
+    }
+
+    a = &cm->arenas[cm->cur];
+    *arena = cm->cur;
+    *offset = a->used;
+    a->used += bytes;
+
+    return 0;
+}
+
+/* What the block would cost per bind on either path, in dwords * 256 */
+static void estimate(const struct r600_const_block *blk, unsigned nvec4, uint64_t cost[2])
+{
+    unsigned up;
+
+    /* An upload takes up whole 256-byte units of the arena */
+    up = (16 * nvec4 + R600_CONST_ALIGN - 1) / R600_CONST_ALIGN * (R600_CONST_ALIGN / 4);
+    cost[R600_CONST_INLINE] = (uint64_t) blk->change_rate * R600_SET_REGS_DW(4 * nvec4);
+    cost[R600_CONST_BUFFER] = (uint64_t) blk->change_rate * (R600_SET_REG_BO_DW + R600_SET_REGS_DW(1)) +
+                              (uint64_t) blk->miss_rate * up / R600_CONST_UPLOAD_COST;
+}
+
+void r600_constmgr_fix(struct r600_constmgr *cm, enum r600_const_path path)
+{
+    cm->fixed = 1;
+    cm->next_mode = path;
+}
+
+void r600_constmgr_next_batch(struct r600_constmgr *cm)
+{
+    int cur = cm->mode, other;
+
+    cm->batch++;
+
+    /* Switching means a stall and other kernel variants, so only for a clear win */
+    if(!cm->fixed && cur >= 0) {
+        other = cur == R600_CONST_INLINE ? R600_CONST_BUFFER : R600_CONST_INLINE;
+        if(cm->cant[other] == 0 &&
+           (cm->cant[cur] > 0 ||
+            4 * (cm->cost[other] + 256 * R600_CONST_SWITCH_COST) < 3 * cm->cost[cur])) {
+            cm->next_mode = other;
+            cm->stats.switches++;
+        } else {
+            cm->next_mode = cur;
+        }
+    }
+
+    cm->mode = -1;
+    memset(cm->cost, 0, sizeof(cm->cost));
+    memset(cm->cant, 0, sizeof(cm->cant));
+}
+
+/* Makes SQ_CONFIG.DX9_CONSTS match the batch's mode, once per segment */
+static int set_config(struct r600_constmgr *cm, struct r600_cmdbuf *cb, struct r600_regbuf *rb)
+{
+    uint32_t v = cm->sq_config & ~DX9_CONSTS_bit, wait = WAIT_3D_IDLE_bit;
+    int ret;
+
+    if(cm->mode == R600_CONST_INLINE)
+        v |= DX9_CONSTS_bit;
+
+    /*
+     * Nothing idles the GPU between batches, so dispatches from the last
+     * one may still be reading constants the old way.  The wait goes
+     * straight into cb, where the shadow can't drop it as a repeat.
+     */
+    if(cm->configured && cm->config != v) {
+        if((ret = r600_emit_set_config_regs(cb, WAIT_UNTIL, 1, &wait)) != 0)
+            return ret;
+        cm->stats.stalls++;
+    }
+
+    if(rb != NULL) {
+        if((ret = r600_regbuf_set(rb, SQ_CONFIG, v)) != 0)
+            return ret;
+        cm->config_cb = NULL;
+    } else if(cm->config_cb != cb || cm->config_segment != cb->segment || cm->config != v) {
+        if((ret = r600_emit_set_config_regs(cb, SQ_CONFIG, 1, &v)) != 0)
+            return ret;
+        cm->config_cb = cb;
+        cm->config_segment = cb->segment;
+    }
+    cm->config = v;
+    cm->configured = 1;
+
+    return 0;
+}
+
+static int bind_inline(struct r600_constmgr *cm, const struct r600_const_block *blk,
+                       const uint32_t *data, unsigned nvec4, int changed,
+                       struct r600_cmdbuf *cb, struct r600_regbuf *rb)
+{
+    unsigned first = blk->base + (blk->stage == R600_CONST_VS ? R600_CONST_INLINE_VEC4 : 0);
+    uint32_t reg = SQ_ALU_CONSTANT0_0 + 16 * first;
+    int ret;
+
+    /* Without a shadow there is no knowing what the constant file still holds */
+    if(rb != NULL)
+        ret = r600_regbuf_set_n(rb, reg, 4 * nvec4, data);
+    else
+        ret = r600_emit_set_alu_consts(cb, reg, 4 * nvec4, data);
+    if(ret != 0)
+        return ret;
+
+    cm->stats.inline_binds++;
+    if(changed || rb == NULL)
+        cm->stats.inline_dwords += R600_SET_REGS_DW(4 * nvec4);
+
+    return 0;
+}
+
+static int bind_buffer(struct r600_constmgr *cm, const struct r600_const_block *blk,
+                       const uint32_t *data, unsigned nvec4, uint64_t hash, int changed,
+                       struct r600_cmdbuf *cb, struct r600_regbuf *rb)
+{
+    struct r600_const_binding *b = &cm->bound[blk->stage][blk->bank];
+    uint32_t bytes = 16 * nvec4, size = (bytes + R600_CONST_ALIGN - 1) / R600_CONST_ALIGN;
+    uint32_t reg = 4 * blk->bank + STAGE_STRIDE * blk->stage;
+    struct r600_const_entry *e = NULL;
+    struct r600_const_arena *a;
+    unsigned *slot, arena;
+    uint32_t offset;
+    int ret;
+
+    if(cm->hash != NULL && *(slot = find(cm, hash, nvec4)) != 0) {
+        e = &cm->entries[*slot - 1];
+        a = &cm->arenas[e->arena];
+        /* Bound last time with the same hash, it was checked then */
+        if(changed && memcmp((char *) a->bo->ptr + e->offset, data, bytes) != 0)
+            e = NULL;
+    }
+
+    if(e != NULL) {
+        cm->stats.reused++;
+    } else {
+        if(cm->nentries == cm->max_entries && (ret = grow_entries(cm)) != 0)
+            return ret;
+        if((ret = alloc(cm, size * R600_CONST_ALIGN, &arena, &offset)) != 0)
+            return ret;
+
+        a = &cm->arenas[arena];
+        memcpy((char *) a->bo->ptr + offset, data, bytes);
+        cm->stats.uploads++;
+        cm->stats.upload_bytes += bytes;
+
+        e = &cm->entries[cm->nentries++];
+        e->hash = hash;
+        e->nvec4 = nvec4;
+        e->arena = arena;
+        e->offset = offset;
+        slot = find(cm, hash, nvec4);
+        if(*slot == 0)
+            *slot = cm->nentries;
+    }
+
+    a = &cm->arenas[e->arena];
+    a->batch = cm->batch;
+
+    /* The address carries a relocation, so it is sent once per segment */
+    if(b->cb != cb || b->segment != cb->segment || b->bo != a->bo || b->offset != e->offset) {
+        if((ret = r600_emit_set_reg_bo(cb, SQ_ALU_CONST_CACHE_PS_0 + reg,
+                                       e->offset / R600_CONST_ALIGN, a->bo, cm->domain, 0)) != 0)
+            return ret;
+        cm->stats.buffer_dwords += R600_SET_REG_BO_DW;
+        b->size = 0;
+    }
+
+    if(rb != NULL) {
+        if((ret = r600_regbuf_set(rb, SQ_ALU_CONST_BUFFER_SIZE_PS_0 + reg, size)) != 0)
+            return ret;
+    } else if(b->size != size) {
+        if((ret = r600_emit_set_context_regs(cb, SQ_ALU_CONST_BUFFER_SIZE_PS_0 + reg, 1, &size)) != 0)
+            return ret;
+        cm->stats.buffer_dwords += R600_SET_REGS_DW(1);
+    }
+
+    b->cb = cb;
+    b->segment = cb->segment;
+    b->bo = a->bo;
+    b->offset = e->offset;
+    b->size = size;
+    cm->stats.buffer_binds++;
+
+    return 0;
+}
+
+int r600_const_bind(struct r600_constmgr *cm, struct r600_const_block *blk,
+                    const uint32_t *data, unsigned nvec4,
+                    struct r600_cmdbuf *cb, struct r600_regbuf *rb)
+{
+    int inline_ok = blk->stage != R600_CONST_GS && blk->base + nvec4 <= R600_CONST_INLINE_VEC4;
+    int buffer_ok = blk->bank < 16 && nvec4 <= R600_CONST_BUFFER_VEC4;
+    int changed, known, path, ret;
+    uint64_t hash, cost[2];
+    unsigned i;
+
+    if(nvec4 == 0 || blk->stage >= R600_CONST_NSTAGES || (!inline_ok && !buffer_ok))
+        return -EINVAL;
+
+    hash = hash_consts(data, 4 * nvec4);
+    changed = blk->path < 0 || hash != blk->hash || nvec4 != blk->nvec4;
+    known = cm->hash != NULL && *find(cm, hash, nvec4) != 0;
+    for(i = 0; i < R600_CONST_SEEN && !known; i++)
+        known = blk->seen[i] == hash;
+    if(changed) {
+        memmove(&blk->seen[1], &blk->seen[0], (R600_CONST_SEEN - 1) * sizeof(blk->seen[0]));
+        blk->seen[0] = hash;
+    }
+
+    blk->change_rate += (changed ? 32 : 0) - blk->change_rate / 8;
+    blk->miss_rate += (changed && !known ? 32 : 0) - blk->miss_rate / 8;
+
+    estimate(blk, nvec4, cost);
+    cm->cost[R600_CONST_INLINE] += cost[R600_CONST_INLINE];
+    cm->cost[R600_CONST_BUFFER] += cost[R600_CONST_BUFFER];
+    cm->cant[R600_CONST_INLINE] += !inline_ok;
+    cm->cant[R600_CONST_BUFFER] += !buffer_ok;
+
+    /* The first bind of a batch settles its mode, if the last batch didn't */
+    if(cm->mode < 0) {
+        if(cm->next_mode >= 0)
+            cm->mode = cm->next_mode;
+        else if(!inline_ok || (buffer_ok && cost[R600_CONST_BUFFER] < cost[R600_CONST_INLINE]))
+            cm->mode = R600_CONST_BUFFER;
+        else
+            cm->mode = R600_CONST_INLINE;
+    }
+
+    path = cm->mode;
+    if((path == R600_CONST_INLINE && !inline_ok) || (path == R600_CONST_BUFFER && !buffer_ok))
+        return -EINVAL;
+    if((ret = set_config(cm, cb, rb)) != 0)
+        return ret;
+
+    if(path == R600_CONST_INLINE)
+        ret = bind_inline(cm, blk, data, nvec4, changed || path != blk->path, cb, rb);
+    else
+        ret = bind_buffer(cm, blk, data, nvec4, hash, changed, cb, rb);
+    if(ret != 0)
+        return ret;
+
+    blk->path = path;
+    blk->hash = hash;
+    blk->nvec4 = nvec4;
+    cm->stats.binds++;
+
+    return path;
+}
@@ -0,0 +1,216 @@
+/**
+ * r600_const.h: ALU constants, inline or from a constant buffer
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_CONST_H_
+#define _R600_CONST_H_
+
+#include <stdint.h>
+
+#include <radeon_bo.h>
+
+#include "r600_cmdbuf.h"
+#include "r600_regbuf.h"
+
+/*
+ * A kernel's ALU constants come in blocks of vec4s, each of which can
+ * reach it one of two ways.  Inline, the values are written into the
+ * constant file with IT_SET_ALU_CONST (SQ_ALU_CONSTANT0_0 on): nothing to
+ * allocate, but every change costs 4 dwords per vec4 in the stream.  From
+ * a constant buffer, the values sit in memory and the shader reads them
+ * through a kcache bank (SQ_ALU_CONST_CACHE_*_n, SQ_ALU_CONST_BUFFER_SIZE
+ * _*_n): a change costs one address and one size register however big the
+ * block, plus copying the block into the buffer if those contents aren't
+ * there already.
+ *
+ * Buffer contents are looked up by hash, so a block that cycles through
+ * a few tables is uploaded once per table, not once per dispatch.  They
+ * are suballocated from arenas and never written again while in use; an
+ * arena is only reused once the GPU is idle on it and it has gone unused
+ * since the caller's last r600_constmgr_next_batch().
+ *
+ * The path isn't the block's to choose, though: on R6xx/R7xx SQ_CONFIG
+ * .DX9_CONSTS makes every shader read the constant file (set) or kcache
+ * (clear), so one mode holds for everything the GPU runs under that
+ * configuration.  The manager settles the mode per batch and writes
+ * SQ_CONFIG to match; a block that can't take the batch's mode (a GS
+ * block, or one too big for the inline window, in inline mode) is
+ * refused rather than mixed in.  From how often each block has been
+ * changing and how often its contents were new, the manager estimates
+ * the dwords either mode would have cost over the batch, and switches
+ * the next batch over when the other mode is needed, or clearly cheaper
+ * even counting the switch: before writing a different SQ_CONFIG the
+ * manager waits for the GPU to go idle (WAIT_UNTIL.WAIT_3D_IDLE), since
+ * dispatches from the last batch may still be running.
+ * Kernels read their constants differently in each mode, so they need
+ * a variant for each; r600_const_bind() says which one to dispatch.
+ */
+
+/* Both inline windows hold 256 vec4s; the GS stage has none */
+#define R600_CONST_INLINE_VEC4  256
+
+/* The most SQ_ALU_CONST_BUFFER_SIZE_*_n can describe, in 256-byte units */
+#define R600_CONST_BUFFER_VEC4  (SQ_ALU_CONST_BUFFER_SIZE_PS_0__DATA_mask * 16)
+
+#define R600_CONST_ALIGN        256
+#define R600_CONST_ARENA_SIZE   (128 * 1024)
+
+/* Contents a block remembers besides what is in the buffers */
+#define R600_CONST_SEEN         4
+
+/* Uploaded dwords that cost as much as one dword in the command stream */
+#define R600_CONST_UPLOAD_COST  2
+
+/* Command-stream dwords taken to cost as much as the stall in a mode switch */
+#define R600_CONST_SWITCH_COST  1024
+
+enum r600_const_stage {
+    R600_CONST_PS,
+    R600_CONST_VS,
+    R600_CONST_GS,
+    R600_CONST_NSTAGES
+};
+
+enum r600_const_path {
+    R600_CONST_INLINE,
+    R600_CONST_BUFFER
+};
+
+/* One per constant block of a kernel, set up by r600_const_block_init() */
+struct r600_const_block {
+    unsigned stage;
+    unsigned base;          /* first vec4 in the stage's inline window */
+    unsigned bank;          /* kcache buffer, 0-15 */
+
+    int path;               /* last bound with, -1 before the first bind */
+    uint64_t hash;          /* of the contents last bound */
+    unsigned nvec4;
+
+    /* Out of 256, decaying by an eighth per bind */
+    unsigned change_rate;   /* binds with different contents than the last */
+    unsigned miss_rate;     /* ... whose contents weren't seen lately */
+
+    /* Hashes of the last few contents, for telling new ones when inline */
+    uint64_t seen[R600_CONST_SEEN];
+};
+
+struct r600_const_arena {
+    struct radeon_bo *bo;
+    uint32_t used;
+    unsigned batch;         /* last r600_constmgr_next_batch() it was bound in */
+};
+
+struct r600_const_entry {
+    uint64_t hash;
+    unsigned nvec4;
+    unsigned arena;
+    uint32_t offset;
+};
+
+/* What a kcache bank was last pointed at, and in which segment of which cmdbuf */
+struct r600_const_binding {
+    const struct r600_cmdbuf *cb;
+    unsigned segment;
+    struct radeon_bo *bo;
+    uint32_t offset, size;
+};
+
+struct r600_constmgr_stats {
+    uint64_t binds;
+    uint64_t inline_binds, inline_dwords;
+    uint64_t buffer_binds, buffer_dwords;
+    uint64_t uploads, upload_bytes;
+    uint64_t reused;        /* buffer binds whose contents were already there */
+    uint64_t switches;      /* batches changing mode */
+    uint64_t stalls;        /* waits for the GPU to idle before SQ_CONFIG */
+    uint64_t recycled;      /* arenas reused */
+};
+
+struct r600_constmgr {
+    struct radeon_bo_manager *bom;
+    uint32_t domain;
+
+    struct r600_const_arena *arenas;
+    unsigned narenas, cur;
+
+    struct r600_const_entry *entries;
+    unsigned nentries, max_entries;
+    unsigned *hash;         /* 1 + index into entries, 0 for free */
+    unsigned hash_mask;
+
+    unsigned batch;
+    struct r600_const_binding bound[R600_CONST_NSTAGES][16];
+
+    uint32_t sq_config;     /* SQ_CONFIG as the caller has it, DX9_CONSTS aside */
+    int fixed;              /* if set, the mode never changes */
+    int mode;               /* this batch's path, -1 before its first bind */
+    int next_mode;          /* the next batch's, -1 if undecided */
+    uint64_t cost[2];       /* estimated for either path over this batch */
+    unsigned cant[2];       /* blocks this batch that can't take the path */
+
+    /* SQ_CONFIG as last written, and where, if that was without a regbuf */
+    int configured;
+    uint32_t config;
+    const struct r600_cmdbuf *config_cb;
+    unsigned config_segment;
+
+    struct r600_constmgr_stats stats;
+};
+
+/*
+ * Buffers go in domain; sq_config is the rest of SQ_CONFIG, which the
+ * manager takes over writing.  NULL on failure.
+ */
+struct r600_constmgr *r600_constmgr_create(struct radeon_bo_manager *bom, uint32_t domain,
+                                           uint32_t sq_config);
+void r600_constmgr_destroy(struct r600_constmgr *cm);
+
+/*
+ * Marks the end of a batch: everything bound so far has been submitted
+ * (or dropped), so arenas not bound since can be reused once idle, and
+ * the next batch may run in the other mode.
+ */
+void r600_constmgr_next_batch(struct r600_constmgr *cm);
+
+/* Always uses path from the next batch on (or this one, if not begun) */
+void r600_constmgr_fix(struct r600_constmgr *cm, enum r600_const_path path);
+
+/* A block at inline vec4 base and kcache bank; the path is left to the manager */
+void r600_const_block_init(struct r600_const_block *blk, unsigned stage,
+                           unsigned base, unsigned bank);
+
+/*
+ * Makes nvec4 vec4s at data the block's contents for the next dispatch,
+ * in the batch's mode, and SQ_CONFIG match it.  Inline values and
+ * SQ_CONFIG go through rb if it isn't NULL (so the shadow can drop
+ * unchanged ones), straight into cb otherwise; buffer bindings go into
+ * cb.  As with any relocated register, the bind and the dispatch it is
+ * for must land in one segment of cb.  Returns the path, -EINVAL if the
+ * block can't take the batch's mode (or either), or -ENOMEM.
+ */
+int r600_const_bind(struct r600_constmgr *cm, struct r600_const_block *blk,
+                    const uint32_t *data, unsigned nvec4,
+                    struct r600_cmdbuf *cb, struct r600_regbuf *rb);
+
+#endif
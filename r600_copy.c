@@ -0,0 +1,106 @@
+/**
+ * r600_copy.c: GPU-side buffer copies and fills
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+
+#include <radeon_bo.h>
+
+#include "r600_reg.h"
+#include "r600_cmdbuf.h"
+#include "r600_copy.h"
+
+/* Largest dword-aligned transfer one IT_CP_DMA can do */
+#define CHUNK (IT_CP_DMA_MAX_BYTES & ~3)
+
+static int range_ok(struct radeon_bo *bo, uint32_t offset, uint32_t size)
+{
+    return ((offset | size) & 3) == 0 && size > 0 &&
+           (uint64_t) offset + size <= bo->size;
+}
+
+int r600_copy_bo(struct r600_cmdbuf *cb,
+                 struct radeon_bo *dst, uint32_t dst_offset, uint32_t dst_domain,
+                 struct radeon_bo *src, uint32_t src_offset, uint32_t src_domain,
+                 uint32_t size)
+{
+    struct r600_cmdbuf_mark m;
+    uint32_t n;
+    int ret = 0;
+
+    if(!range_ok(dst, dst_offset, size) || !range_ok(src, src_offset, size))
+        return -EINVAL;
+
+    r600_cmdbuf_mark(cb, &m);
+
+    while(size > 0) {
+        n = size < CHUNK ? size : CHUNK;
+        size -= n;
+        if((ret = r600_emit_cp_dma(cb, dst, dst_offset, dst_domain,
+                                   src, src_offset, src_domain, n, size == 0)) != 0)
+            break;
+        dst_offset += n;
+        src_offset += n;
+    }
+
+    if(ret != 0)
+        r600_cmdbuf_rollback(cb, &m);
+
+    return ret;
+}
+
+int r600_fill_bo(struct r600_cmdbuf *cb,
+                 struct radeon_bo *bo, uint32_t offset, uint32_t domain,
+                 uint32_t size, uint32_t value)
+{
+    struct r600_cmdbuf_mark m;
+    uint32_t filled, n;
+    int ret;
+
+    /* The kernel takes only qword-aligned IT_MEM_WRITEs that fit in the BO */
+    if(!range_ok(bo, offset, size) || (offset & 7) != 0 || size < 8)
+        return -EINVAL;
+
+    r600_cmdbuf_mark(cb, &m);
+    ret = r600_emit_mem_write(cb, bo, offset, domain, value | (uint64_t) value << 32, 0);
+
+    /*
+     * Every step reads what the previous ones wrote, so each waits for
+     * its DMA to land before the CP moves on.
+     */
+    for(filled = 8; ret == 0 && filled < size; filled += n) {
+        n = size - filled;
+        if(n > filled)
+            n = filled;
+        if(n > CHUNK)
+            n = CHUNK;
+        ret = r600_emit_cp_dma(cb, bo, offset + filled, domain, bo, offset, domain, n, 1);
+    }
+
+    if(ret != 0)
+        r600_cmdbuf_rollback(cb, &m);
+
+    return ret;
+}
@@ -0,0 +1,64 @@
+/**
+ * r600_copy.h: GPU-side buffer copies and fills
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_COPY_H_
+#define _R600_COPY_H_
+
+#include <stdint.h>
+
+#include <radeon_bo.h>
+
+#include "r600_cmdbuf.h"
+
+/*
+ * Buffer-to-buffer copies recorded into a command stream with the CP's own
+ * DMA engine (IT_CP_DMA), so moving data between two VRAM buffers never
+ * goes through system memory.  They complete in stream order like any
+ * other work in the submission.
+ *
+ * Offsets and sizes must be multiples of 4.  Both functions return 0 on
+ * success, -EINVAL for bad arguments or -ENOMEM if the command buffer could
+ * not grow; a failed call leaves nothing behind in cb, though on a chained
+ * stream chunks already submitted stay submitted.  Whether the buffers
+ * fit in one submission is checked by r600_cmdbuf_submit().
+ */
+
+int r600_copy_bo(struct r600_cmdbuf *cb,
+                 struct radeon_bo *dst, uint32_t dst_offset, uint32_t dst_domain,
+                 struct radeon_bo *src, uint32_t src_offset, uint32_t src_domain,
+                 uint32_t size);
+
+/*
+ * Fills size bytes at offset with a repeated 32-bit value: one 64-bit
+ * IT_MEM_WRITE seeds the first two dwords, then CP DMA copies double the
+ * filled region until it covers the range.  Since the kernel only accepts
+ * IT_MEM_WRITE at a multiple of 8 bytes, offset must be one too, and size
+ * at least 8 (still only a multiple of 4).
+ */
+int r600_fill_bo(struct r600_cmdbuf *cb,
+                 struct radeon_bo *bo, uint32_t offset, uint32_t domain,
+                 uint32_t size, uint32_t value);
+
+#endif
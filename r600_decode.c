@@ -0,0 +1,270 @@
+/**
+ * r600_decode.c: Packet3 stream decoder and annotator
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "r600_reg.h"
+#include "r600_cmdbuf.h"
+#include "r600_regtab.h"
+#include "r600_decode.h"
+
+#define IT(op, class) [IT_##op] = { "IT_" #op, R600_CLASS_##class }
+
+static const struct {
+    const char *name;
+    enum r600_packet_class class;
+} packets[256] = {
+    IT(NOP,                     PAD),
+    IT(INDIRECT_BUFFER_END,     OTHER),
+    IT(SET_PREDICATION,         SYNC),
+    IT(REG_RMW,                 STATE),
+    IT(COND_EXEC,               SYNC),
+    IT(PRED_EXEC,               SYNC),
+    IT(START_3D_CMDBUF,         OTHER),
+    IT(DRAW_INDEX_2,            DRAW),
+    IT(CONTEXT_CONTROL,         STATE),
+    IT(DRAW_INDEX_IMMD_BE,      DRAW),
+    IT(INDEX_TYPE,              STATE),
+    IT(DRAW_INDEX,              DRAW),
+    IT(DRAW_INDEX_AUTO,         DRAW),
+    IT(DRAW_INDEX_IMMD,         DRAW),
+    IT(NUM_INSTANCES,           STATE),
+    IT(STRMOUT_BUFFER_UPDATE,   OTHER),
+    IT(INDIRECT_BUFFER_MP,      OTHER),
+    IT(MEM_SEMAPHORE,           SYNC),
+    IT(MPEG_INDEX,              OTHER),
+    IT(WAIT_REG_MEM,            SYNC),
+    IT(MEM_WRITE,               COPY),
+    IT(INDIRECT_BUFFER,         OTHER),
+    IT(CP_INTERRUPT,            OTHER),
+    IT(CP_DMA,                  COPY),
+    IT(SURFACE_SYNC,            SYNC),
+    IT(ME_INITIALIZE,           OTHER),
+    IT(COND_WRITE,              SYNC),
+    IT(EVENT_WRITE,             SYNC),
+    IT(EVENT_WRITE_EOP,         SYNC),
+    IT(ONE_REG_WRITE,           STATE),
+    IT(SET_CONFIG_REG,          STATE),
+    IT(SET_CONTEXT_REG,         STATE),
+    IT(SET_ALU_CONST,           CONST),
+    IT(SET_BOOL_CONST,          CONST),
+    IT(SET_LOOP_CONST,          CONST),
+    IT(SET_RESOURCE,            RESOURCE),
+    IT(SET_SAMPLER,             RESOURCE),
+    IT(SET_CTL_CONST,           STATE),
+    IT(SURFACE_BASE_UPDATE,     STATE),
+};
+
+#undef IT
+
+static const char *const class_names[R600_NCLASSES] = {
+    "state", "const", "resource", "draw", "sync", "copy", "reloc", "pad", "other"
+};
+
+const char *r600_packet_name(unsigned op)
+{
+    return op < 256 ? packets[op].name : NULL;
+}
+
+enum r600_packet_class r600_packet_class(unsigned op)
+{
+    return op < 256 && packets[op].name != NULL ? packets[op].class : R600_CLASS_OTHER;
+}
+
+const char *r600_class_name(enum r600_packet_class c)
+{
+    return (unsigned) c < R600_NCLASSES ? class_names[c] : NULL;
+}
+
+const char *r600_reg_name(uint32_t reg, uint32_t *delta)
+{
+    unsigned lo = 0, hi = r600_nregs, mid;
+
+    /* The last entry at or below reg */
+    while(lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if(r600_regs[mid].offset <= reg)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if(lo == 0)
+        return NULL;
+
+    *delta = reg - r600_regs[lo - 1].offset;
+    return r600_regs[lo - 1].name;
+}
+
+/*
+ * The constant, resource and sampler windows are arrays of identical
+ * slots, of which the headers only name slot 0; registers in them are
+ * labelled the way the headers would, <prefix><word>_<slot>.
+ */
+static const struct {
+    uint32_t start, end;
+    unsigned words;
+    const char *prefix;
+} arrays[] = {
+    { SET_ALU_CONST_offset,  SET_ALU_CONST_end,  4,                    "SQ_ALU_CONSTANT" },
+    { SET_RESOURCE_offset,   SET_RESOURCE_end,   R600_RESOURCE_DWORDS, "SQ_TEX_RESOURCE_WORD" },
+    { SET_SAMPLER_offset,    SET_SAMPLER_end,    R600_SAMPLER_DWORDS,  "SQ_TEX_SAMPLER_WORD" },
+    { SET_LOOP_CONST_offset, SET_LOOP_CONST_end, 1,                    "SQ_LOOP_CONST_" },
+    { SET_BOOL_CONST_offset, SET_BOOL_CONST_end, 1,                    "SQ_BOOL_CONST_" },
+};
+
+static void print_reg(FILE *out, uint32_t reg, uint32_t value)
+{
+    const struct r600_reg_info *info;
+    const char *name;
+    uint32_t delta;
+    unsigned i, n;
+
+    for(i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+        if(reg < arrays[i].start || reg >= arrays[i].end)
+            continue;
+        n = (reg - arrays[i].start) / 4;
+        if(arrays[i].words == 1)
+            fprintf(out, "reg\t0x%05x\t%s%u\t0x%08x\n", reg, arrays[i].prefix, n, value);
+        else
+            fprintf(out, "reg\t0x%05x\t%s%u_%u\t0x%08x\n", reg, arrays[i].prefix,
+                    n % arrays[i].words, n / arrays[i].words, value);
+        return;
+    }
+
+    if((info = r600_reg_lookup(reg, &n)) != NULL) {
+        if(n == 0)
+            fprintf(out, "reg\t0x%05x\t%s\t0x%08x\n", reg, info->name, value);
+        else
+            fprintf(out, "reg\t0x%05x\t%s[%u]\t0x%08x\n", reg, info->name, n, value);
+    } else if((name = r600_reg_name(reg, &delta)) == NULL)
+        fprintf(out, "reg\t0x%05x\t?\t0x%08x\n", reg, value);
+    else if(delta == 0)
+        fprintf(out, "reg\t0x%05x\t%s\t0x%08x\n", reg, name, value);
+    else
+        fprintf(out, "reg\t0x%05x\t%s+0x%x\t0x%08x\n", reg, name, delta, value);
+}
+
+static void print_regs(FILE *out, uint32_t reg, const uint32_t *p, unsigned n)
+{
+    unsigned i;
+
+    for(i = 0; i < n; i++)
+        print_reg(out, reg + 4 * i, p[i]);
+}
+
+int r600_decode(FILE *out, const uint32_t *buf, unsigned ndw,
+                struct r600_decode_stats *stats)
+{
+    enum r600_packet_class class, prev = R600_CLASS_PAD;
+    const char *name;
+    char unknown[16];
+    unsigned i, j, n, op = 0;
+    uint32_t hdr, base;
+
+    for(i = 0; i < ndw; i += n) {
+        hdr = buf[i];
+
+        switch(PACKET_TYPE(hdr)) {
+        case 0:
+            n = PACKET_NDW(hdr);
+            name = "PACKET0";
+            class = R600_CLASS_STATE;
+            break;
+        case 2:
+            n = 1;
+            name = "PACKET2";
+            class = R600_CLASS_PAD;
+            break;
+        case 3:
+            n = PACKET_NDW(hdr);
+            op = PACKET3_OP(hdr);
+            if((name = r600_packet_name(op)) == NULL) {
+                snprintf(unknown, sizeof(unknown), "IT_0x%02x", op);
+                name = unknown;
+            }
+            class = r600_packet_class(op);
+            /* A two-dword NOP straight after a packet is a relocation */
+            if(op == IT_NOP && n == R600_RELOC_DW && prev != R600_CLASS_PAD)
+                class = R600_CLASS_RELOC;
+            break;
+        default:
+            if(out != NULL)
+                fprintf(out, "err\t%u\ttype-1 packet 0x%08x\n", i, hdr);
+            return -EINVAL;
+        }
+
+        if(i + n > ndw) {
+            if(out != NULL)
+                fprintf(out, "err\t%u\t%s is %u dwords short\n", i, name, i + n - ndw);
+            return -EINVAL;
+        }
+        base = PACKET_TYPE(hdr) == 3 ? r600_set_op_base(op) : 0;
+        if(base != 0 && n < 3) {
+            if(out != NULL)
+                fprintf(out, "err\t%u\t%s with no registers\n", i, name);
+            return -EINVAL;
+        }
+
+        if(stats != NULL) {
+            stats->packets[class]++;
+            stats->dwords[class] += n;
+        }
+        prev = class;
+
+        if(out == NULL)
+            continue;
+
+        fprintf(out, "pkt\t%u\t%s\t%s\t%u\n", i, name, class_names[class], n);
+        if(PACKET_TYPE(hdr) == 0)
+            print_regs(out, (hdr & 0xffff) << 2, buf + i + 1, n - 1);
+        else if(class == R600_CLASS_RELOC)
+            fprintf(out, "reloc\t%u\n", buf[i + 1]);
+        else if(base != 0)
+            print_regs(out, base + 4 * buf[i + 1], buf + i + 2, n - 2);
+        else {
+            for(j = 1; j < n; j++)
+                fprintf(out, "dw\t%u\t0x%08x\n", j, buf[i + j]);
+        }
+    }
+
+    return 0;
+}
+
+void r600_decode_summary(FILE *out, const struct r600_decode_stats *stats)
+{
+    uint64_t packets = 0, dwords = 0;
+    unsigned c;
+
+    for(c = 0; c < R600_NCLASSES; c++) {
+        fprintf(out, "sum\t%s\t%llu\t%llu\n", class_names[c],
+                (unsigned long long) stats->packets[c], (unsigned long long) stats->dwords[c]);
+        packets += stats->packets[c];
+        dwords += stats->dwords[c];
+    }
+    fprintf(out, "sum\ttotal\t%llu\t%llu\n", (unsigned long long) packets,
+            (unsigned long long) dwords);
+}
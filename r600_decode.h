@@ -0,0 +1,94 @@
+/**
+ * r600_decode.h: Packet3 stream decoder and annotator
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_DECODE_H_
+#define _R600_DECODE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Walks a command stream as the CP would and prints every packet, with
+ * register writes labelled by name, so a submission can be read or two
+ * versions of one diffed.  The output is one tab-separated record per
+ * line, first field the record type:
+ *
+ *   pkt   <dword>  <packet name>  <class>  <dwords>
+ *   reg   <offset> <register name>[+<delta>]  <value>
+ *   dw    <n>      <value>                     other payload dword n
+ *   reloc <index>                              our relocation NOP
+ *   sum   <class>  <packets>  <dwords>         totals, from r600_decode_summary()
+ *   err   <dword>  <message>
+ *
+ * Numbers are decimal except offsets and values, which are 0x-prefixed
+ * hex.  Slots of the constant, resource and sampler arrays are named
+ * like slot 0 in the headers (SQ_ALU_CONSTANT<word>_<slot>, and so on),
+ * other elements of register arrays as <name of element 0>[<n>], and any
+ * other register with no name of its own as the closest named register
+ * below plus a byte delta.
+ */
+
+enum r600_packet_class {
+    R600_CLASS_STATE,       /* SET_CONFIG/CONTEXT_REG, SET_CTL_CONST, ... */
+    R600_CLASS_CONST,       /* ALU, loop and bool constants */
+    R600_CLASS_RESOURCE,    /* resources and samplers */
+    R600_CLASS_DRAW,
+    R600_CLASS_SYNC,        /* surface syncs, events, waits, predication */
+    R600_CLASS_COPY,        /* CP DMA and memory writes */
+    R600_CLASS_RELOC,
+    R600_CLASS_PAD,         /* type-2 and other NOPs */
+    R600_CLASS_OTHER,
+    R600_NCLASSES
+};
+
+struct r600_decode_stats {
+    uint64_t packets[R600_NCLASSES];
+    uint64_t dwords[R600_NCLASSES];
+};
+
+/* NULL for opcodes r600_reg.h doesn't know */
+const char *r600_packet_name(unsigned op);
+enum r600_packet_class r600_packet_class(unsigned op);
+const char *r600_class_name(enum r600_packet_class c);
+
+/*
+ * The name of reg, or of the closest named register below it with the
+ * distance in bytes in *delta; NULL if there is none.
+ */
+const char *r600_reg_name(uint32_t reg, uint32_t *delta);
+
+/*
+ * Prints ndw dwords of buf to out (which may be NULL to only count) and
+ * adds them to stats (which may be NULL).  Returns 0, or -EINVAL if the
+ * stream is malformed; decoding stops at the first bad packet, after an
+ * err record.
+ */
+int r600_decode(FILE *out, const uint32_t *buf, unsigned ndw,
+                struct r600_decode_stats *stats);
+
+/* One sum record per class, then a total */
+void r600_decode_summary(FILE *out, const struct r600_decode_stats *stats);
+
+#endif
@@ -0,0 +1,283 @@
+/**
+ * r600_fence.c: fences and timelines signalled from the command stream
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <radeon_bo.h>
+
+#include "r600_reg.h"
+#include "r600_cmdbuf.h"
+#include "r600_fence.h"
+
+const struct r600_wait_policy r600_wait_default = {
+    .spin_ns = 10000,
+    .yield_ns = 100000,
+    .sleep_min_ns = 10000,
+    .sleep_max_ns = 1000000,
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline void cpu_relax(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
+struct r600_fences *r600_fences_create(struct radeon_bo_manager *bom, uint32_t domain)
+{
+    struct r600_fences *f;
+
+    if((f = calloc(1, sizeof(*f))) == NULL)
+        return NULL;
+
+    f->domain = domain;
+    pthread_mutex_init(&f->lock, NULL);
+
+    if((f->bo = radeon_bo_open(bom, 0, R600_FENCE_BO_SIZE, 4096, domain, 0)) == NULL)
+        goto fail;
+    if(radeon_bo_map(f->bo, 1) != 0 || f->bo->ptr == NULL)
+        goto fail;
+
+    f->map = f->bo->ptr;
+    memset(f->map, 0, R600_FENCE_BO_SIZE);
+
+    return f;
+
+fail:
+    if(f->bo != NULL)
+        radeon_bo_unref(f->bo);
+    pthread_mutex_destroy(&f->lock);
+    free(f);
+    return NULL;
+}
+
+void r600_fences_destroy(struct r600_fences *f)
+{
+    if(f == NULL)
+        return;
+
+    radeon_bo_unmap(f->bo);
+    radeon_bo_unref(f->bo);
+    pthread_mutex_destroy(&f->lock);
+    free(f);
+}
+
+struct r600_timeline *r600_timeline_create(struct r600_fences *f, uint64_t initial)
+{
+    struct r600_timeline *tl;
+    unsigned i, bit;
+
+    if((tl = calloc(1, sizeof(*tl))) == NULL)
+        return NULL;
+
+    pthread_mutex_lock(&f->lock);
+    for(i = 0; i < R600_FENCE_SLOTS / 64 && f->used[i] == ~0ull; i++)
+        ;
+    if(i < R600_FENCE_SLOTS / 64) {
+        bit = __builtin_ctzll(~f->used[i]);
+        f->used[i] |= 1ull << bit;
+    }
+    pthread_mutex_unlock(&f->lock);
+
+    if(i == R600_FENCE_SLOTS / 64) {
+        free(tl);
+        return NULL;
+    }
+
+    tl->f = f;
+    tl->slot = i * 64 + bit;
+    tl->last = initial;
+    tl->submitted = initial;
+    tl->policy = r600_wait_default;
+    tl->spin_ns = tl->policy.spin_ns;
+    __atomic_store_n(&f->map[tl->slot], initial, __ATOMIC_RELEASE);
+
+    return tl;
+}
+
+void r600_timeline_destroy(struct r600_timeline *tl)
+{
+    struct r600_fences *f;
+
+    if(tl == NULL)
+        return;
+
+    f = tl->f;
+    pthread_mutex_lock(&f->lock);
+    f->used[tl->slot / 64] &= ~(1ull << (tl->slot % 64));
+    pthread_mutex_unlock(&f->lock);
+    free(tl);
+}
+
+int r600_timeline_signal(struct r600_timeline *tl, struct r600_cmdbuf *cb, uint64_t value)
+{
+    int ret;
+
+    if(value <= tl->last)
+        return -EINVAL;
+
+    ret = r600_emit_event_write_eop(cb, CACHE_FLUSH_AND_INV_TS_EVENT,
+                                    tl->f->bo, tl->slot * 8, tl->f->domain,
+                                    value, 2, 0);
+    if(ret != 0)
+        return ret;
+    tl->last = value;
+
+    /* Without memory to note it, the signal just never counts as submitted */
+    return r600_cmdbuf_add_signal(cb, &tl->submitted, value, cb->cdw - R600_EVENT_WRITE_EOP_DW);
+}
+
+int r600_timeline_signal_host(struct r600_timeline *tl, uint64_t value)
+{
+    if(value <= tl->last)
+        return -EINVAL;
+
+    tl->last = value;
+    tl->submitted = value;
+    __atomic_store_n(&tl->f->map[tl->slot], value, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/* Learns the rate from each look at the value that finds it gone up */
+static void observe(struct r600_timeline *tl, uint64_t cur, uint64_t t)
+{
+    uint64_t step;
+
+    if(cur <= tl->seen && tl->seen_ns != 0)
+        return;
+
+    if(tl->seen_ns != 0) {
+        step = (t - tl->seen_ns) / (cur - tl->seen);
+        tl->step_ns = tl->step_ns != 0 ? (tl->step_ns * 3 + step) / 4 : step;
+    }
+    tl->seen = cur;
+    tl->seen_ns = t;
+}
+
+int r600_timeline_wait(struct r600_timeline *tl, uint64_t value, uint64_t timeout_ns)
+{
+    const struct r600_wait_policy *p = &tl->policy;
+    uint64_t start, elapsed = 0, nap = p->sleep_min_ns;
+    uint64_t *stage = &tl->stats.spun;
+    struct timespec ts;
+    int ret = 0;
+
+    tl->stats.waits++;
+
+    if(r600_timeline_reached(tl, value)) {
+        tl->stats.ready++;
+        return 0;
+    }
+
+    start = now_ns();
+
+    while(!r600_timeline_reached(tl, value)) {
+        elapsed = now_ns() - start;
+
+        if(elapsed >= timeout_ns) {
+            ret = -ETIMEDOUT;
+            break;
+        }
+
+        if(elapsed < tl->spin_ns) {
+            cpu_relax();
+        } else if(elapsed < tl->spin_ns + p->yield_ns) {
+            stage = &tl->stats.yielded;
+            sched_yield();
+        } else {
+            stage = &tl->stats.slept;
+            if(nap > timeout_ns - elapsed)
+                nap = timeout_ns - elapsed;
+            ts.tv_sec = nap / 1000000000ull;
+            ts.tv_nsec = nap % 1000000000ull;
+            nanosleep(&ts, NULL);
+            /* Oversleeping by more than a fraction of the wait so far shows */
+            nap = nap * 2 < p->sleep_max_ns ? nap * 2 : p->sleep_max_ns;
+            if(nap > elapsed / 4)
+                nap = elapsed / 4 > p->sleep_min_ns ? elapsed / 4 : p->sleep_min_ns;
+        }
+    }
+
+    if(ret == 0) {
+        elapsed = now_ns() - start;
+        (*stage)++;
+        observe(tl, r600_timeline_value(tl), start + elapsed);
+    } else {
+        tl->stats.timeouts++;
+    }
+
+    tl->stats.wait_ns += elapsed;
+    if(elapsed > tl->stats.max_wait_ns)
+        tl->stats.max_wait_ns = elapsed;
+
+    tl->spin_ns = elapsed <= p->spin_ns ? p->spin_ns : tl->spin_ns / 2;
+
+    return ret;
+}
+
+int r600_timeline_wait_gpu(struct r600_timeline *tl, struct r600_cmdbuf *cb, uint64_t value)
+{
+    if(value > UINT32_MAX)
+        return -ERANGE;
+
+    if(r600_timeline_reached(tl, value))
+        return 0;
+
+    /* The EOP stores the value little-endian, so its low half comes first */
+    return r600_emit_wait_mem(cb, IT_WAIT_GE, tl->f->bo, tl->slot * 8, tl->f->domain,
+                              (uint32_t) value, 0xffffffff);
+}
+
+uint64_t r600_timeline_eta(struct r600_timeline *tl, uint64_t value)
+{
+    uint64_t cur = r600_timeline_value(tl), t = now_ns(), eta, since;
+
+    if(cur >= value)
+        return 0;
+
+    observe(tl, cur, t);
+
+    /* Time since the last step counts towards the next one */
+    eta = (value - cur) * tl->step_ns;
+    since = t - tl->seen_ns;
+
+    return eta > since ? eta - since : 0;
+}
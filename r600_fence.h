@@ -0,0 +1,168 @@
+/**
+ * r600_fence.h: fences and timelines signalled from the command stream
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_FENCE_H_
+#define _R600_FENCE_H_
+
+#include <stdint.h>
+
+#include <pthread.h>
+
+#include <radeon_bo.h>
+
+#include "r600_cmdbuf.h"
+
+/*
+ * Until now the only way to learn that the GPU was done was to block in
+ * radeon_bo_map() or radeon_bo_wait(), which costs an ioctl and waits for
+ * everything touching the BO.  A timeline is a 64-bit counter in a small
+ * GTT buffer that stays mapped: the command stream raises it with an
+ * end-of-pipe IT_EVENT_WRITE_EOP once everything before has drained, and
+ * the CPU checks for a value by reading memory, with no kernel involved.
+ *
+ * Values only ever go up, so "value >= n" means "everything up to point n
+ * is done", the same way a timeline semaphore works.  Many timelines share
+ * one buffer, a slot each.
+ */
+
+#define R600_FENCE_BO_SIZE  4096
+#define R600_FENCE_SLOTS    (R600_FENCE_BO_SIZE / 8)
+
+struct r600_fences {
+    struct radeon_bo *bo;
+    uint32_t domain;
+    uint64_t *map;
+
+    pthread_mutex_t lock;
+    uint64_t used[R600_FENCE_SLOTS / 64];
+};
+
+/*
+ * How a CPU wait passes the time: it busy-polls for spin_ns, then calls
+ * sched_yield() between polls until yield_ns have gone by, then sleeps,
+ * starting at sleep_min_ns and doubling up to sleep_max_ns or a quarter
+ * of the time waited so far, whichever is less.  Spinning
+ * answers fastest and sleeping costs least CPU; a wait only pays for the
+ * next stage when the GPU takes longer than the last.
+ */
+struct r600_wait_policy {
+    uint64_t spin_ns;
+    uint64_t yield_ns;
+    uint64_t sleep_min_ns, sleep_max_ns;
+};
+
+extern const struct r600_wait_policy r600_wait_default;
+
+struct r600_timeline_stats {
+    uint64_t waits;
+    uint64_t ready;         /* ... that found the value already there */
+    uint64_t spun;          /* ... that ended while spinning */
+    uint64_t yielded;
+    uint64_t slept;
+    uint64_t timeouts;
+    uint64_t wait_ns, max_wait_ns;
+};
+
+/*
+ * Signalling from several threads needs outside locking.  The stats and
+ * spin budget aren't locked either; concurrent waiters only blur them.
+ */
+struct r600_timeline {
+    struct r600_fences *f;
+    unsigned slot;
+    uint64_t last;          /* highest value a signal has been queued for */
+    uint64_t submitted;     /* ... in a submitted cmdbuf, or by the host */
+
+    struct r600_wait_policy policy;
+    uint64_t spin_ns;       /* current spin budget, see r600_timeline_wait() */
+
+    /* How fast the value has been going up, for r600_timeline_eta() */
+    uint64_t seen, seen_ns, step_ns;
+
+    struct r600_timeline_stats stats;
+};
+
+/* Allocates and maps the shared buffer in domain (normally GTT) */
+struct r600_fences *r600_fences_create(struct radeon_bo_manager *bom, uint32_t domain);
+
+/* Every timeline must be destroyed first */
+void r600_fences_destroy(struct r600_fences *f);
+
+/* NULL once all slots are taken */
+struct r600_timeline *r600_timeline_create(struct r600_fences *f, uint64_t initial);
+void r600_timeline_destroy(struct r600_timeline *tl);
+
+/* The value the GPU (or r600_timeline_signal_host()) last stored */
+static inline uint64_t r600_timeline_value(const struct r600_timeline *tl)
+{
+    return __atomic_load_n(&tl->f->map[tl->slot], __ATOMIC_ACQUIRE);
+}
+
+static inline int r600_timeline_reached(const struct r600_timeline *tl, uint64_t value)
+{
+    return r600_timeline_value(tl) >= value;
+}
+
+/*
+ * Records a write of value once all earlier work in the stream has
+ * finished, caches flushed.  tl->submitted catches up once cb has been
+ * submitted.  value must be above any earlier signal; returns -EINVAL if
+ * not, or -ENOMEM.
+ */
+int r600_timeline_signal(struct r600_timeline *tl, struct r600_cmdbuf *cb, uint64_t value);
+
+/* Raises the value from the CPU, e.g. to release work held back on it */
+int r600_timeline_signal_host(struct r600_timeline *tl, uint64_t value);
+
+/*
+ * Waits for the timeline to reach value, following tl->policy.  The spin
+ * budget adapts: a wait that outlasts it halves the next one, since the
+ * GPU evidently isn't finishing on that scale, and a wait short enough to
+ * have been caught spinning restores it.  timeout_ns of 0 only polls,
+ * UINT64_MAX waits for good.  Returns 0 or -ETIMEDOUT.
+ */
+int r600_timeline_wait(struct r600_timeline *tl, uint64_t value, uint64_t timeout_ns);
+
+/*
+ * Makes the CP itself wait, with IT_WAIT_REG_MEM, until the timeline
+ * reaches value, so work that depends on another submission can be
+ * queued right behind it instead of after a CPU round trip.  Nothing is
+ * emitted if the value is already there.
+ *
+ * The packet compares 32 bits, so value must fit in them (-ERANGE if
+ * not).  Whatever signals value has to be ahead of cb on the ring or come
+ * from the host; otherwise the CP waits for something queued behind
+ * itself, and the kernel will eventually reset the GPU as hung.
+ */
+int r600_timeline_wait_gpu(struct r600_timeline *tl, struct r600_cmdbuf *cb, uint64_t value);
+
+/*
+ * A guess at how many ns until the timeline reaches value, from how fast
+ * it has been going up when looked at; 0 if it already has or there is
+ * nothing to go on yet.
+ */
+uint64_t r600_timeline_eta(struct r600_timeline *tl, uint64_t value);
+
+#endif
@@ -0,0 +1,223 @@
+/**
+ * r600_flow.c: loop and bool constants for flow control
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "r600_reg.h"
+#include "r600_cmdbuf.h"
+#include "r600_regbuf.h"
+#include "r600_flow.h"
+
+/* An unchanged slot between two changed ones is cheaper to resend than to split on */
+#define MAX_GAP     1
+
+static uint32_t run_mask(unsigned base, unsigned n)
+{
+    return n == R600_FLOW_SLOTS ? ~0u : ((1u << n) - 1) << base;
+}
+
+void r600_flowmgr_init(struct r600_flowmgr *fm)
+{
+    memset(fm, 0, sizeof(*fm));
+}
+
+/* The first base at which n free slots start, or -1 */
+static int find_run(uint32_t used, unsigned n)
+{
+    unsigned base;
+
+    if(n == 0)
+        return 0;
+    for(base = 0; base + n <= R600_FLOW_SLOTS; base++) {
+        if((used & run_mask(base, n)) == 0)
+            return base;
+    }
+
+    return -1;
+}
+
+int r600_flow_alloc(struct r600_flowmgr *fm, struct r600_flow_kernel *k,
+                    unsigned stage, unsigned nloops, unsigned nbools)
+{
+    int lb, bb;
+
+    if(stage >= R600_CONST_NSTAGES || nloops > R600_FLOW_SLOTS || nbools > R600_FLOW_SLOTS)
+        return -EINVAL;
+    if((lb = find_run(fm->loop_used[stage], nloops)) < 0 ||
+       (bb = find_run(fm->bool_used[stage], nbools)) < 0)
+        return -ENOSPC;
+
+    k->stage = stage;
+    k->loop_base = lb;
+    k->nloops = nloops;
+    k->bool_base = bb;
+    k->nbools = nbools;
+    if(nloops > 0)
+        fm->loop_used[stage] |= run_mask(lb, nloops);
+    if(nbools > 0)
+        fm->bool_used[stage] |= run_mask(bb, nbools);
+
+    return 0;
+}
+
+void r600_flow_release(struct r600_flowmgr *fm, struct r600_flow_kernel *k)
+{
+    if(k->nloops > 0)
+        fm->loop_used[k->stage] &= ~run_mask(k->loop_base, k->nloops);
+    if(k->nbools > 0)
+        fm->bool_used[k->stage] &= ~run_mask(k->bool_base, k->nbools);
+    k->nloops = 0;
+    k->nbools = 0;
+}
+
+int r600_flow_set_loop(struct r600_flowmgr *fm, const struct r600_flow_kernel *k,
+                       unsigned i, unsigned count, unsigned init, unsigned inc)
+{
+    if(i >= k->nloops || count > 0xfff || init > 0xfff || inc > 0xff)
+        return -EINVAL;
+
+    fm->loop[k->stage][k->loop_base + i] = r600_flow_loop_word(count, init, inc);
+
+    return 0;
+}
+
+int r600_flow_set_bool(struct r600_flowmgr *fm, const struct r600_flow_kernel *k,
+                       unsigned i, int value)
+{
+    uint32_t bit;
+
+    if(i >= k->nbools)
+        return -EINVAL;
+
+    bit = 1u << (k->bool_base + i);
+    if(value)
+        fm->bools[k->stage] |= bit;
+    else
+        fm->bools[k->stage] &= ~bit;
+
+    return 0;
+}
+
+static int emit_queued(struct r600_flowmgr *fm, const struct r600_flow_kernel *k,
+                       struct r600_regbuf *rb)
+{
+    unsigned stage = k->stage;
+    int ret;
+
+    if(k->nloops > 0 &&
+       (ret = r600_regbuf_set_n(rb, SQ_LOOP_CONST_0 + 4 * (R600_FLOW_SLOTS * stage + k->loop_base),
+                                k->nloops, &fm->loop[stage][k->loop_base])) != 0)
+        return ret;
+    if(k->nbools > 0 &&
+       (ret = r600_regbuf_set(rb, SQ_BOOL_CONST_0 + 4 * stage, fm->bools[stage])) != 0)
+        return ret;
+
+    return 0;
+}
+
+static int emit_loops(struct r600_flowmgr *fm, const struct r600_flow_kernel *k,
+                      struct r600_cmdbuf *cb)
+{
+    unsigned stage = k->stage, end = k->loop_base + k->nloops, i, j, last;
+    uint32_t *sent = fm->sent_loop[stage];
+    const uint32_t *want = fm->loop[stage];
+    int ret;
+
+#define STALE(n) (!(fm->loop_valid[stage] & 1u << (n)) || sent[n] != want[n])
+
+    for(i = k->loop_base; i < end; i = j) {
+        if(!STALE(i)) {
+            fm->stats.loop_skipped++;
+            j = i + 1;
+            continue;
+        }
+
+        /* Extend the run over gaps too small to be worth a new packet */
+        for(last = i, j = i + 1; j < end && j - last <= MAX_GAP + 1; j++) {
+            if(STALE(j))
+                last = j;
+        }
+        j = last + 1;
+
+        if((ret = r600_emit_set_loop_consts(cb, SQ_LOOP_CONST_0 + 4 * (R600_FLOW_SLOTS * stage + i),
+                                            j - i, &want[i])) != 0)
+            return ret;
+
+        memcpy(&sent[i], &want[i], (j - i) * sizeof(*sent));
+        fm->loop_valid[stage] |= run_mask(i, j - i);
+        fm->stats.loop_sent += j - i;
+        fm->stats.dwords += R600_SET_REGS_DW(j - i);
+    }
+
+#undef STALE
+
+    return 0;
+}
+
+int r600_flow_emit(struct r600_flowmgr *fm, const struct r600_flow_kernel *k,
+                   struct r600_cmdbuf *cb, struct r600_regbuf *rb)
+{
+    unsigned stage = k->stage;
+    uint32_t mask;
+    int ret;
+
+    fm->stats.dispatches++;
+    if(rb != NULL)
+        return emit_queued(fm, k, rb);
+
+    /* One segment for all of it, at worst a packet per slot */
+    if((ret = r600_cmdbuf_reserve(cb, R600_SET_REGS_DW(1) * (k->nloops + 1), 0)) != 0)
+        return ret;
+
+    if(fm->cb != cb || fm->segment != cb->segment) {
+        memset(fm->loop_valid, 0, sizeof(fm->loop_valid));
+        fm->bools_valid = 0;
+        fm->cb = cb;
+        fm->segment = cb->segment;
+    }
+
+    if((ret = emit_loops(fm, k, cb)) != 0)
+        return ret;
+
+    if(k->nbools > 0) {
+        mask = run_mask(k->bool_base, k->nbools);
+        if(!(fm->bools_valid & 1u << stage) ||
+           ((fm->sent_bools[stage] ^ fm->bools[stage]) & mask) != 0) {
+            if((ret = r600_emit_set_bool_consts(cb, SQ_BOOL_CONST_0 + 4 * stage, 1,
+                                                &fm->bools[stage])) != 0)
+                return ret;
+            fm->sent_bools[stage] = fm->bools[stage];
+            fm->bools_valid |= 1u << stage;
+            fm->stats.bool_sent++;
+            fm->stats.dwords += R600_SET_REGS_DW(1);
+        } else {
+            fm->stats.bool_skipped++;
+        }
+    }
+
+    return 0;
+}
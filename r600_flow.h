@@ -0,0 +1,122 @@
+/**
+ * r600_flow.h: loop and bool constants for flow control
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_FLOW_H_
+#define _R600_FLOW_H_
+
+#include <stdint.h>
+
+#include "r600_reg.h"
+#include "r600_cmdbuf.h"
+#include "r600_regbuf.h"
+#include "r600_const.h"
+
+/*
+ * Each stage has 32 loop constants (SQ_LOOP_CONST_*, a trip count, start
+ * and step for LOOP_START_DX10 and friends) and 32 bool constants, packed
+ * as the bits of one SQ_BOOL_CONST_* register, for predicated branches.
+ *
+ * Kernels get disjoint slots for as long as they fit, so switching
+ * between kernels reloads nothing; a kernel's code uses loop_base + i and
+ * bool_base + i for its i-th constant.  Values are kept in the manager,
+ * and a dispatch sends only the slots that differ from what the command
+ * buffer already holds: a trip count change is one 3-dword packet, and
+ * flipping a bool rewrites just the stage's one bool register, with the
+ * other kernels' bits intact.
+ */
+
+#define R600_FLOW_SLOTS     32
+
+struct r600_flow_kernel {
+    unsigned stage;
+    unsigned loop_base, nloops;
+    unsigned bool_base, nbools;
+};
+
+struct r600_flowmgr_stats {
+    uint64_t dispatches;
+    uint64_t loop_sent, loop_skipped;   /* slots */
+    uint64_t bool_sent, bool_skipped;   /* SQ_BOOL_CONST_* writes */
+    uint64_t dwords;
+};
+
+struct r600_flowmgr {
+    uint32_t loop_used[R600_CONST_NSTAGES];     /* allocated slots */
+    uint32_t bool_used[R600_CONST_NSTAGES];
+
+    uint32_t loop[R600_CONST_NSTAGES][R600_FLOW_SLOTS];
+    uint32_t bools[R600_CONST_NSTAGES];
+
+    /* What is known to be in cb as of the given segment */
+    const struct r600_cmdbuf *cb;
+    unsigned segment;
+    uint32_t sent_loop[R600_CONST_NSTAGES][R600_FLOW_SLOTS];
+    uint32_t loop_valid[R600_CONST_NSTAGES];    /* one bit per slot */
+    uint32_t sent_bools[R600_CONST_NSTAGES];
+    uint32_t bools_valid;                       /* one bit per stage */
+
+    struct r600_flowmgr_stats stats;
+};
+
+/* The manager is small enough to embed; this just clears it */
+void r600_flowmgr_init(struct r600_flowmgr *fm);
+
+/* Forgets what has been sent, e.g. after the state was lost */
+static inline void r600_flowmgr_invalidate(struct r600_flowmgr *fm)
+{
+    fm->cb = NULL;
+}
+
+/*
+ * Assigns a kernel nloops loop and nbools bool constants in stage, each
+ * a contiguous run.  Returns 0, -EINVAL, or -ENOSPC if the free slots
+ * don't have room; r600_flow_release() gives them back.
+ */
+int r600_flow_alloc(struct r600_flowmgr *fm, struct r600_flow_kernel *k,
+                    unsigned stage, unsigned nloops, unsigned nbools);
+void r600_flow_release(struct r600_flowmgr *fm, struct r600_flow_kernel *k);
+
+static inline uint32_t r600_flow_loop_word(unsigned count, unsigned init, unsigned inc)
+{
+    return (count << SQ_LOOP_CONST_0__COUNT_shift & SQ_LOOP_CONST_0__COUNT_mask) |
+           (init << INIT_shift & INIT_mask) | (inc << INC_shift & INC_mask);
+}
+
+/* Set the kernel's i-th constant for its next dispatch; -EINVAL if out of range */
+int r600_flow_set_loop(struct r600_flowmgr *fm, const struct r600_flow_kernel *k,
+                       unsigned i, unsigned count, unsigned init, unsigned inc);
+int r600_flow_set_bool(struct r600_flowmgr *fm, const struct r600_flow_kernel *k,
+                       unsigned i, int value);
+
+/*
+ * Sends the kernel's constants that changed.  With rb the writes are
+ * queued there, and its shadow does the eliding; otherwise they go
+ * straight into cb, compared against what the manager sent into the
+ * same segment of cb.  Returns 0 or the error from emitting.
+ */
+int r600_flow_emit(struct r600_flowmgr *fm, const struct r600_flow_kernel *k,
+                   struct r600_cmdbuf *cb, struct r600_regbuf *rb);
+
+#endif
@@ -0,0 +1,727 @@
+/**
+ * r600_format.c: host-side packing of data into vertex-fetch formats
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "r600_reg.h"
+#include "r600_format.h"
+
+/*
+ * Every converter is written as a fixed-size block function plus a driver
+ * that runs it over the array and pushes the ragged tail through a padded
+ * copy, so the tail gets bit-identical results to the rest.
+ */
+#define CONVERT(block, per_block, dst_t, src_t, dst, src, n)                 \
+    do {                                                                     \
+        size_t i_;                                                           \
+        for(i_ = 0; i_ + (per_block) <= (n); i_ += (per_block))              \
+            block((dst) + i_, (src) + i_);                                   \
+        if(i_ < (n)) {                                                       \
+            src_t s_[per_block];                                             \
+            dst_t d_[per_block];                                             \
+            memset(s_, 0, sizeof(s_));                                       \
+            memcpy(s_, (src) + i_, ((n) - i_) * sizeof(src_t));              \
+            block(d_, s_);                                                   \
+            memcpy((dst) + i_, d_, ((n) - i_) * sizeof(dst_t));              \
+        }                                                                    \
+    } while(0)
+
+#ifdef __SSE2__
+
+/*
+ * float32 -> float16, round to nearest even; overflow goes to infinity and
+ * NaNs stay NaNs.  Result is one half per 32-bit lane, sign-extended so that
+ * _mm_packs_epi32 narrows it without saturating.
+ */
+static inline __m128i ps_to_f16(__m128 f)
+{
+    const __m128i sign_mask = _mm_set1_epi32(0x80000000);
+    const __m128i f16_max = _mm_set1_epi32((127 + 16) << 23);
+    const __m128i f32_inf = _mm_set1_epi32(0x7f800000);
+    const __m128i nan_bit = _mm_set1_epi32(0x200);
+    const __m128i f16_inf = _mm_set1_epi32(0x7c00);
+    const __m128i min_normal = _mm_set1_epi32((127 - 14) << 23);
+    const __m128i subnorm_magic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+    const __m128i normal_bias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+
+    __m128i bits = _mm_castps_si128(f);
+    __m128i sign = _mm_and_si128(bits, sign_mask);
+    __m128i absf = _mm_xor_si128(bits, sign);
+
+    __m128i is_nan = _mm_cmpgt_epi32(absf, f32_inf);
+    __m128i is_regular = _mm_cmpgt_epi32(f16_max, absf);
+    __m128i is_sub = _mm_cmpgt_epi32(min_normal, absf);
+    __m128i special = _mm_or_si128(_mm_and_si128(is_nan, nan_bit), f16_inf);
+
+    /* Results that are subnormal halves: let the FPU do the rounding */
+    __m128i sub = _mm_sub_epi32(_mm_castps_si128(
+                                    _mm_add_ps(_mm_castsi128_ps(absf),
+                                               _mm_castsi128_ps(subnorm_magic))),
+                                subnorm_magic);
+
+    /* Normal results: rebias exponent, round mantissa to even */
+    __m128i odd = _mm_srai_epi32(_mm_slli_epi32(absf, 31 - 13), 31);
+    __m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(absf, normal_bias), odd), 13);
+
+    __m128i r = _mm_or_si128(_mm_and_si128(is_sub, sub), _mm_andnot_si128(is_sub, normal));
+    r = _mm_or_si128(_mm_and_si128(is_regular, r), _mm_andnot_si128(is_regular, special));
+
+    return _mm_or_si128(r, _mm_srai_epi32(sign, 16));
+}
+
+/* float16 (zero-extended into 32-bit lanes) -> float32, exact */
+static inline __m128 f16_to_ps(__m128i h)
+{
+    const __m128i no_sign = _mm_set1_epi32(0x7fff);
+    const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23));
+    const __m128i was_infnan = _mm_set1_epi32(0x7bff);
+    const __m128 exp_infnan = _mm_castsi128_ps(_mm_set1_epi32(255 << 23));
+
+    __m128i expmant = _mm_and_si128(h, no_sign);
+    __m128i sign = _mm_slli_epi32(_mm_xor_si128(h, expmant), 16);
+    __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(expmant, 13)), magic);
+    __m128 infnan = _mm_and_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(expmant, was_infnan)),
+                               exp_infnan);
+
+    return _mm_or_ps(scaled, _mm_or_ps(_mm_castsi128_ps(sign), infnan));
+}
+
+/* SSE2 has no unsigned 32->16 pack; bias into signed range and back */
+static inline __m128i packu_epi32(__m128i a, __m128i b)
+{
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16((short) 0x8000);
+
+    return _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(a, bias32),
+                                         _mm_sub_epi32(b, bias32)), bias16);
+}
+
+/* Unsigned min(x, limit) per 32-bit lane */
+static inline __m128i minu_epi32(__m128i x, uint32_t limit)
+{
+    const __m128i flip = _mm_set1_epi32(0x80000000);
+    __m128i lim = _mm_set1_epi32((int) limit);
+    __m128i over = _mm_cmpgt_epi32(_mm_xor_si128(x, flip), _mm_xor_si128(lim, flip));
+
+    return _mm_or_si128(_mm_andnot_si128(over, x), _mm_and_si128(over, lim));
+}
+
+static inline __m128i clamp_scale(__m128 x, float lo, float hi, float scale)
+{
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(lo)), _mm_set1_ps(hi));
+    return _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(scale)));
+}
+
+static void pack_f16_8(uint16_t *dst, const float *src)
+{
+    __m128i a = ps_to_f16(_mm_loadu_ps(src));
+    __m128i b = ps_to_f16(_mm_loadu_ps(src + 4));
+
+    _mm_storeu_si128((__m128i *) dst, _mm_packs_epi32(a, b));
+}
+
+static void unpack_f16_8(float *dst, const uint16_t *src)
+{
+    __m128i h = _mm_loadu_si128((const __m128i *) src);
+    __m128i zero = _mm_setzero_si128();
+
+    _mm_storeu_ps(dst, f16_to_ps(_mm_unpacklo_epi16(h, zero)));
+    _mm_storeu_ps(dst + 4, f16_to_ps(_mm_unpackhi_epi16(h, zero)));
+}
+
+static void pack_unorm16_8(uint16_t *dst, const float *src)
+{
+    __m128i a = clamp_scale(_mm_loadu_ps(src), 0.0f, 1.0f, 65535.0f);
+    __m128i b = clamp_scale(_mm_loadu_ps(src + 4), 0.0f, 1.0f, 65535.0f);
+
+    _mm_storeu_si128((__m128i *) dst, packu_epi32(a, b));
+}
+
+static void pack_snorm16_8(int16_t *dst, const float *src)
+{
+    __m128i a = clamp_scale(_mm_loadu_ps(src), -1.0f, 1.0f, 32767.0f);
+    __m128i b = clamp_scale(_mm_loadu_ps(src + 4), -1.0f, 1.0f, 32767.0f);
+
+    _mm_storeu_si128((__m128i *) dst, _mm_packs_epi32(a, b));
+}
+
+static void pack_unorm8_16(uint8_t *dst, const float *src)
+{
+    __m128i a = clamp_scale(_mm_loadu_ps(src), 0.0f, 1.0f, 255.0f);
+    __m128i b = clamp_scale(_mm_loadu_ps(src + 4), 0.0f, 1.0f, 255.0f);
+    __m128i c = clamp_scale(_mm_loadu_ps(src + 8), 0.0f, 1.0f, 255.0f);
+    __m128i d = clamp_scale(_mm_loadu_ps(src + 12), 0.0f, 1.0f, 255.0f);
+
+    _mm_storeu_si128((__m128i *) dst,
+                     _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+}
+
+static void pack_snorm8_16(int8_t *dst, const float *src)
+{
+    __m128i a = clamp_scale(_mm_loadu_ps(src), -1.0f, 1.0f, 127.0f);
+    __m128i b = clamp_scale(_mm_loadu_ps(src + 4), -1.0f, 1.0f, 127.0f);
+    __m128i c = clamp_scale(_mm_loadu_ps(src + 8), -1.0f, 1.0f, 127.0f);
+    __m128i d = clamp_scale(_mm_loadu_ps(src + 12), -1.0f, 1.0f, 127.0f);
+
+    _mm_storeu_si128((__m128i *) dst,
+                     _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+}
+
+/* Widening helpers: 16 bytes or 8 shorts into 32-bit lanes */
+static inline void widen_u8(__m128i v, __m128i out[4])
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+
+    out[0] = _mm_unpacklo_epi16(lo, zero);
+    out[1] = _mm_unpackhi_epi16(lo, zero);
+    out[2] = _mm_unpacklo_epi16(hi, zero);
+    out[3] = _mm_unpackhi_epi16(hi, zero);
+}
+
+static inline void widen_s8(__m128i v, __m128i out[4])
+{
+    __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+    __m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+
+    out[0] = _mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16);
+    out[1] = _mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16);
+    out[2] = _mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16);
+    out[3] = _mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16);
+}
+
+static inline void widen_u16(__m128i v, __m128i out[2])
+{
+    __m128i zero = _mm_setzero_si128();
+
+    out[0] = _mm_unpacklo_epi16(v, zero);
+    out[1] = _mm_unpackhi_epi16(v, zero);
+}
+
+static inline void widen_s16(__m128i v, __m128i out[2])
+{
+    out[0] = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    out[1] = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+}
+
+static void unpack_unorm16_8(float *dst, const uint16_t *src)
+{
+    __m128i w[2];
+    __m128 scale = _mm_set1_ps(65535.0f);
+
+    widen_u16(_mm_loadu_si128((const __m128i *) src), w);
+    _mm_storeu_ps(dst, _mm_div_ps(_mm_cvtepi32_ps(w[0]), scale));
+    _mm_storeu_ps(dst + 4, _mm_div_ps(_mm_cvtepi32_ps(w[1]), scale));
+}
+
+static void unpack_snorm16_8(float *dst, const int16_t *src)
+{
+    __m128i w[2];
+    __m128 scale = _mm_set1_ps(32767.0f), neg1 = _mm_set1_ps(-1.0f);
+
+    widen_s16(_mm_loadu_si128((const __m128i *) src), w);
+    _mm_storeu_ps(dst, _mm_max_ps(_mm_div_ps(_mm_cvtepi32_ps(w[0]), scale), neg1));
+    _mm_storeu_ps(dst + 4, _mm_max_ps(_mm_div_ps(_mm_cvtepi32_ps(w[1]), scale), neg1));
+}
+
+static void unpack_unorm8_16(float *dst, const uint8_t *src)
+{
+    __m128i w[4];
+    __m128 scale = _mm_set1_ps(255.0f);
+    int i;
+
+    widen_u8(_mm_loadu_si128((const __m128i *) src), w);
+    for(i = 0; i < 4; i++)
+        _mm_storeu_ps(dst + 4 * i, _mm_div_ps(_mm_cvtepi32_ps(w[i]), scale));
+}
+
+static void unpack_snorm8_16(float *dst, const int8_t *src)
+{
+    __m128i w[4];
+    __m128 scale = _mm_set1_ps(127.0f), neg1 = _mm_set1_ps(-1.0f);
+    int i;
+
+    widen_s8(_mm_loadu_si128((const __m128i *) src), w);
+    for(i = 0; i < 4; i++)
+        _mm_storeu_ps(dst + 4 * i,
+                      _mm_max_ps(_mm_div_ps(_mm_cvtepi32_ps(w[i]), scale), neg1));
+}
+
+#define LOAD4(p, k) _mm_loadu_si128((const __m128i *) (p) + (k))
+
+static void pack_s16_8(int16_t *dst, const int32_t *src)
+{
+    _mm_storeu_si128((__m128i *) dst, _mm_packs_epi32(LOAD4(src, 0), LOAD4(src, 1)));
+}
+
+static void pack_s8_16(int8_t *dst, const int32_t *src)
+{
+    _mm_storeu_si128((__m128i *) dst,
+                     _mm_packs_epi16(_mm_packs_epi32(LOAD4(src, 0), LOAD4(src, 1)),
+                                     _mm_packs_epi32(LOAD4(src, 2), LOAD4(src, 3))));
+}
+
+static void pack_u16_8(uint16_t *dst, const uint32_t *src)
+{
+    _mm_storeu_si128((__m128i *) dst, packu_epi32(minu_epi32(LOAD4(src, 0), 0xffff),
+                                                  minu_epi32(LOAD4(src, 1), 0xffff)));
+}
+
+static void pack_u8_16(uint8_t *dst, const uint32_t *src)
+{
+    __m128i a = _mm_packs_epi32(minu_epi32(LOAD4(src, 0), 0xff), minu_epi32(LOAD4(src, 1), 0xff));
+    __m128i b = _mm_packs_epi32(minu_epi32(LOAD4(src, 2), 0xff), minu_epi32(LOAD4(src, 3), 0xff));
+
+    _mm_storeu_si128((__m128i *) dst, _mm_packus_epi16(a, b));
+}
+
+#undef LOAD4
+
+static void unpack_s16_8(int32_t *dst, const int16_t *src)
+{
+    __m128i w[2];
+
+    widen_s16(_mm_loadu_si128((const __m128i *) src), w);
+    _mm_storeu_si128((__m128i *) dst, w[0]);
+    _mm_storeu_si128((__m128i *) dst + 1, w[1]);
+}
+
+static void unpack_u16_8(uint32_t *dst, const uint16_t *src)
+{
+    __m128i w[2];
+
+    widen_u16(_mm_loadu_si128((const __m128i *) src), w);
+    _mm_storeu_si128((__m128i *) dst, w[0]);
+    _mm_storeu_si128((__m128i *) dst + 1, w[1]);
+}
+
+static void unpack_s8_16(int32_t *dst, const int8_t *src)
+{
+    __m128i w[4];
+    int i;
+
+    widen_s8(_mm_loadu_si128((const __m128i *) src), w);
+    for(i = 0; i < 4; i++)
+        _mm_storeu_si128((__m128i *) dst + i, w[i]);
+}
+
+static void unpack_u8_16(uint32_t *dst, const uint8_t *src)
+{
+    __m128i w[4];
+    int i;
+
+    widen_u8(_mm_loadu_si128((const __m128i *) src), w);
+    for(i = 0; i < 4; i++)
+        _mm_storeu_si128((__m128i *) dst + i, w[i]);
+}
+
+#else /* !__SSE2__ */
+
+/* Same rounding rules as the SIMD versions, one scalar at a time */
+
+static uint16_t f32_to_f16(float f)
+{
+    union { float f; uint32_t u; } v, magic;
+    uint32_t sign, absu;
+
+    v.f = f;
+    sign = (v.u >> 16) & 0x8000;
+    absu = v.u & 0x7fffffff;
+
+    if(absu > 0x7f800000)
+        return sign | 0x7e00;
+    if(absu >= ((127 + 16) << 23))
+        return sign | 0x7c00;
+    if(absu < ((127 - 14) << 23)) {
+        magic.u = ((127 - 15) + (23 - 10) + 1) << 23;
+        v.u = absu;
+        v.f += magic.f;
+        return sign | (v.u - magic.u);
+    }
+
+    return sign | ((absu + 0xfff - ((127 - 15) << 23) + ((absu >> 13) & 1)) >> 13);
+}
+
+static float f16_to_f32(uint16_t h)
+{
+    union { float f; uint32_t u; } v, magic;
+    uint32_t expmant = h & 0x7fff;
+
+    magic.u = (254 - 15) << 23;
+    v.u = expmant << 13;
+    v.f *= magic.f;
+    if(expmant > 0x7bff)
+        v.u |= 255 << 23;
+    v.u |= (uint32_t) (h & 0x8000) << 16;
+
+    return v.f;
+}
+
+static int32_t clamp_scale(float x, float lo, float hi, float scale)
+{
+    x = x < lo ? lo : (x > hi ? hi : x);
+    return (int32_t) lrintf(x * scale);
+}
+
+static int32_t sat(int32_t x, int32_t lo, int32_t hi)
+{
+    return x < lo ? lo : (x > hi ? hi : x);
+}
+
+#define SCALAR_BLOCK(name, per_block, dst_t, src_t, expr)                    \
+    static void name(dst_t *dst, const src_t *src)                          \
+    {                                                                        \
+        int i;                                                               \
+        for(i = 0; i < (per_block); i++) {                                   \
+            src_t x = src[i];                                                \
+            dst[i] = (expr);                                                 \
+        }                                                                    \
+    }
+
+SCALAR_BLOCK(pack_f16_8, 8, uint16_t, float, f32_to_f16(x))
+SCALAR_BLOCK(unpack_f16_8, 8, float, uint16_t, f16_to_f32(x))
+SCALAR_BLOCK(pack_unorm16_8, 8, uint16_t, float, clamp_scale(x, 0.0f, 1.0f, 65535.0f))
+SCALAR_BLOCK(pack_snorm16_8, 8, int16_t, float, clamp_scale(x, -1.0f, 1.0f, 32767.0f))
+SCALAR_BLOCK(pack_unorm8_16, 16, uint8_t, float, clamp_scale(x, 0.0f, 1.0f, 255.0f))
+SCALAR_BLOCK(pack_snorm8_16, 16, int8_t, float, clamp_scale(x, -1.0f, 1.0f, 127.0f))
+SCALAR_BLOCK(unpack_unorm16_8, 8, float, uint16_t, x / 65535.0f)
+SCALAR_BLOCK(unpack_snorm16_8, 8, float, int16_t, x < -32767 ? -1.0f : x / 32767.0f)
+SCALAR_BLOCK(unpack_unorm8_16, 16, float, uint8_t, x / 255.0f)
+SCALAR_BLOCK(unpack_snorm8_16, 16, float, int8_t, x < -127 ? -1.0f : x / 127.0f)
+SCALAR_BLOCK(pack_s16_8, 8, int16_t, int32_t, sat(x, -32768, 32767))
+SCALAR_BLOCK(pack_s8_16, 16, int8_t, int32_t, sat(x, -128, 127))
+SCALAR_BLOCK(pack_u16_8, 8, uint16_t, uint32_t, x > 0xffff ? 0xffff : x)
+SCALAR_BLOCK(pack_u8_16, 16, uint8_t, uint32_t, x > 0xff ? 0xff : x)
+SCALAR_BLOCK(unpack_s16_8, 8, int32_t, int16_t, x)
+SCALAR_BLOCK(unpack_u16_8, 8, uint32_t, uint16_t, x)
+SCALAR_BLOCK(unpack_s8_16, 16, int32_t, int8_t, x)
+SCALAR_BLOCK(unpack_u8_16, 16, uint32_t, uint8_t, x)
+
+#undef SCALAR_BLOCK
+
+#endif /* __SSE2__ */
+
+void r600_pack_f32_to_f16(uint16_t *dst, const float *src, size_t n)
+{
+    CONVERT(pack_f16_8, 8, uint16_t, float, dst, src, n);
+}
+
+void r600_unpack_f16_to_f32(float *dst, const uint16_t *src, size_t n)
+{
+    CONVERT(unpack_f16_8, 8, float, uint16_t, dst, src, n);
+}
+
+void r600_pack_f32_to_unorm8(uint8_t *dst, const float *src, size_t n)
+{
+    CONVERT(pack_unorm8_16, 16, uint8_t, float, dst, src, n);
+}
+
+void r600_pack_f32_to_snorm8(int8_t *dst, const float *src, size_t n)
+{
+    CONVERT(pack_snorm8_16, 16, int8_t, float, dst, src, n);
+}
+
+void r600_pack_f32_to_unorm16(uint16_t *dst, const float *src, size_t n)
+{
+    CONVERT(pack_unorm16_8, 8, uint16_t, float, dst, src, n);
+}
+
+void r600_pack_f32_to_snorm16(int16_t *dst, const float *src, size_t n)
+{
+    CONVERT(pack_snorm16_8, 8, int16_t, float, dst, src, n);
+}
+
+void r600_unpack_unorm8_to_f32(float *dst, const uint8_t *src, size_t n)
+{
+    CONVERT(unpack_unorm8_16, 16, float, uint8_t, dst, src, n);
+}
+
+void r600_unpack_snorm8_to_f32(float *dst, const int8_t *src, size_t n)
+{
+    CONVERT(unpack_snorm8_16, 16, float, int8_t, dst, src, n);
+}
+
+void r600_unpack_unorm16_to_f32(float *dst, const uint16_t *src, size_t n)
+{
+    CONVERT(unpack_unorm16_8, 8, float, uint16_t, dst, src, n);
+}
+
+void r600_unpack_snorm16_to_f32(float *dst, const int16_t *src, size_t n)
+{
+    CONVERT(unpack_snorm16_8, 8, float, int16_t, dst, src, n);
+}
+
+void r600_pack_s32_to_s8(int8_t *dst, const int32_t *src, size_t n)
+{
+    CONVERT(pack_s8_16, 16, int8_t, int32_t, dst, src, n);
+}
+
+void r600_pack_s32_to_s16(int16_t *dst, const int32_t *src, size_t n)
+{
+    CONVERT(pack_s16_8, 8, int16_t, int32_t, dst, src, n);
+}
+
+void r600_pack_u32_to_u8(uint8_t *dst, const uint32_t *src, size_t n)
+{
+    CONVERT(pack_u8_16, 16, uint8_t, uint32_t, dst, src, n);
+}
+
+void r600_pack_u32_to_u16(uint16_t *dst, const uint32_t *src, size_t n)
+{
+    CONVERT(pack_u16_8, 8, uint16_t, uint32_t, dst, src, n);
+}
+
+void r600_unpack_s8_to_s32(int32_t *dst, const int8_t *src, size_t n)
+{
+    CONVERT(unpack_s8_16, 16, int32_t, int8_t, dst, src, n);
+}
+
+void r600_unpack_s16_to_s32(int32_t *dst, const int16_t *src, size_t n)
+{
+    CONVERT(unpack_s16_8, 8, int32_t, int16_t, dst, src, n);
+}
+
+void r600_unpack_u8_to_u32(uint32_t *dst, const uint8_t *src, size_t n)
+{
+    CONVERT(unpack_u8_16, 16, uint32_t, uint8_t, dst, src, n);
+}
+
+void r600_unpack_u16_to_u32(uint32_t *dst, const uint16_t *src, size_t n)
+{
+    CONVERT(unpack_u16_8, 8, uint32_t, uint16_t, dst, src, n);
+}
+
+void r600_fetch_pack(const struct r600_fetch_format *fmt,
+                     void *dst, const void *src, size_t n)
+{
+    switch(fmt->pack) {
+    case R600_PACK_F16:     r600_pack_f32_to_f16(dst, src, n); break;
+    case R600_PACK_UNORM8:  r600_pack_f32_to_unorm8(dst, src, n); break;
+    case R600_PACK_SNORM8:  r600_pack_f32_to_snorm8(dst, src, n); break;
+    case R600_PACK_UNORM16: r600_pack_f32_to_unorm16(dst, src, n); break;
+    case R600_PACK_SNORM16: r600_pack_f32_to_snorm16(dst, src, n); break;
+    case R600_PACK_U8:      r600_pack_u32_to_u8(dst, src, n); break;
+    case R600_PACK_S8:      r600_pack_s32_to_s8(dst, src, n); break;
+    case R600_PACK_U16:     r600_pack_u32_to_u16(dst, src, n); break;
+    case R600_PACK_S16:     r600_pack_s32_to_s16(dst, src, n); break;
+    case R600_PACK_F32:
+    case R600_PACK_U32:
+    case R600_PACK_S32:     memcpy(dst, src, n * 4); break;
+    }
+}
+
+void r600_fetch_unpack(const struct r600_fetch_format *fmt,
+                       void *dst, const void *src, size_t n)
+{
+    switch(fmt->pack) {
+    case R600_PACK_F16:     r600_unpack_f16_to_f32(dst, src, n); break;
+    case R600_PACK_UNORM8:  r600_unpack_unorm8_to_f32(dst, src, n); break;
+    case R600_PACK_SNORM8:  r600_unpack_snorm8_to_f32(dst, src, n); break;
+    case R600_PACK_UNORM16: r600_unpack_unorm16_to_f32(dst, src, n); break;
+    case R600_PACK_SNORM16: r600_unpack_snorm16_to_f32(dst, src, n); break;
+    case R600_PACK_U8:      r600_unpack_u8_to_u32(dst, src, n); break;
+    case R600_PACK_S8:      r600_unpack_s8_to_s32(dst, src, n); break;
+    case R600_PACK_U16:     r600_unpack_u16_to_u32(dst, src, n); break;
+    case R600_PACK_S16:     r600_unpack_s16_to_s32(dst, src, n); break;
+    case R600_PACK_F32:
+    case R600_PACK_U32:
+    case R600_PACK_S32:     memcpy(dst, src, n * 4); break;
+    }
+}
+
+/* Format negotiation */
+
+static int fits(double min, double max, double lo, double hi)
+{
+    return min >= lo && max <= hi;
+}
+
+double r600_pack_error(enum r600_pack pack, double min, double max)
+{
+    double m;
+    int e;
+
+    if(!(min <= max))
+        return INFINITY;
+
+    switch(pack) {
+    case R600_PACK_F32:
+        return 0.0;
+    case R600_PACK_F16:
+        m = fabs(min) > fabs(max) ? fabs(min) : fabs(max);
+        if(m > 65504.0)
+            return INFINITY;
+        if(m == 0.0)
+            return 0.0;
+        frexp(m, &e);
+        if(e - 1 < -14)
+            e = -14 + 1;
+        return ldexp(1.0, e - 1 - 10) / 2.0; /* half an ulp at m */
+    case R600_PACK_UNORM8:
+        return fits(min, max, 0.0, 1.0) ? 0.5 / 255.0 : INFINITY;
+    case R600_PACK_SNORM8:
+        return fits(min, max, -1.0, 1.0) ? 0.5 / 127.0 : INFINITY;
+    case R600_PACK_UNORM16:
+        return fits(min, max, 0.0, 1.0) ? 0.5 / 65535.0 : INFINITY;
+    case R600_PACK_SNORM16:
+        return fits(min, max, -1.0, 1.0) ? 0.5 / 32767.0 : INFINITY;
+    case R600_PACK_U8:
+        return fits(min, max, 0.0, 255.0) ? 0.0 : INFINITY;
+    case R600_PACK_S8:
+        return fits(min, max, -128.0, 127.0) ? 0.0 : INFINITY;
+    case R600_PACK_U16:
+        return fits(min, max, 0.0, 65535.0) ? 0.0 : INFINITY;
+    case R600_PACK_S16:
+        return fits(min, max, -32768.0, 32767.0) ? 0.0 : INFINITY;
+    case R600_PACK_U32:
+        return fits(min, max, 0.0, 4294967295.0) ? 0.0 : INFINITY;
+    case R600_PACK_S32:
+        return fits(min, max, -2147483648.0, 2147483647.0) ? 0.0 : INFINITY;
+    }
+
+    return INFINITY;
+}
+
+/* Candidates for each fetch kind, narrowest first */
+static const enum r600_pack float_packs[] = {
+    R600_PACK_UNORM8, R600_PACK_SNORM8,
+    R600_PACK_UNORM16, R600_PACK_SNORM16, R600_PACK_F16,
+    R600_PACK_F32
+};
+static const enum r600_pack sint_packs[] = { R600_PACK_S8, R600_PACK_S16, R600_PACK_S32 };
+static const enum r600_pack uint_packs[] = { R600_PACK_U8, R600_PACK_U16, R600_PACK_U32 };
+
+static unsigned pack_bytes(enum r600_pack pack)
+{
+    switch(pack) {
+    case R600_PACK_UNORM8: case R600_PACK_SNORM8: case R600_PACK_U8: case R600_PACK_S8:
+        return 1;
+    case R600_PACK_F16: case R600_PACK_UNORM16: case R600_PACK_SNORM16:
+    case R600_PACK_U16: case R600_PACK_S16:
+        return 2;
+    default:
+        return 4;
+    }
+}
+
+/* FMT_* indexed by component count - 1; FMT_INVALID where there is none */
+static uint32_t data_format(enum r600_pack pack, unsigned components)
+{
+    static const uint32_t fmt8[4] = { FMT_8, FMT_8_8, FMT_INVALID, FMT_8_8_8_8 };
+    static const uint32_t fmt16[4] = { FMT_16, FMT_16_16, FMT_INVALID, FMT_16_16_16_16 };
+    static const uint32_t fmt16f[4] = { FMT_16_FLOAT, FMT_16_16_FLOAT, FMT_INVALID,
+                                        FMT_16_16_16_16_FLOAT };
+    static const uint32_t fmt32[4] = { FMT_32, FMT_32_32, FMT_32_32_32, FMT_32_32_32_32 };
+    static const uint32_t fmt32f[4] = { FMT_32_FLOAT, FMT_32_32_FLOAT, FMT_32_32_32_FLOAT,
+                                        FMT_32_32_32_32_FLOAT };
+
+    if(components < 1 || components > 4)
+        return FMT_INVALID;
+
+    switch(pack) {
+    case R600_PACK_F16:
+        return fmt16f[components - 1];
+    case R600_PACK_F32:
+        return fmt32f[components - 1];
+    default:
+        switch(pack_bytes(pack)) {
+        case 1:  return fmt8[components - 1];
+        case 2:  return fmt16[components - 1];
+        default: return fmt32[components - 1];
+        }
+    }
+}
+
+int r600_fetch_format_choose(enum r600_fetch_kind kind, unsigned components,
+                             double min, double max, double max_error,
+                             struct r600_fetch_format *fmt)
+{
+    const enum r600_pack *packs;
+    size_t n, i;
+
+    switch(kind) {
+    case R600_FETCH_FLOAT:
+        packs = float_packs;
+        n = sizeof(float_packs) / sizeof(float_packs[0]);
+        break;
+    case R600_FETCH_SINT:
+        packs = sint_packs;
+        n = sizeof(sint_packs) / sizeof(sint_packs[0]);
+        max_error = 0.0;
+        break;
+    case R600_FETCH_UINT:
+        packs = uint_packs;
+        n = sizeof(uint_packs) / sizeof(uint_packs[0]);
+        max_error = 0.0;
+        break;
+    default:
+        return -1;
+    }
+
+    for(i = 0; i < n; i++) {
+        enum r600_pack p = packs[i];
+        uint32_t df = data_format(p, components);
+
+        if(df == FMT_INVALID || r600_pack_error(p, min, max) > max_error)
+            continue;
+
+        fmt->pack = p;
+        fmt->data_format = df;
+        fmt->comp_bytes = pack_bytes(p);
+        fmt->components = components;
+
+        switch(p) {
+        case R600_PACK_F16: case R600_PACK_F32:
+            fmt->num_format = SQ_NUM_FORMAT_SCALED;
+            fmt->format_comp = SQ_FORMAT_COMP_SIGNED;
+            break;
+        case R600_PACK_UNORM8: case R600_PACK_UNORM16:
+            fmt->num_format = SQ_NUM_FORMAT_NORM;
+            fmt->format_comp = SQ_FORMAT_COMP_UNSIGNED;
+            break;
+        case R600_PACK_SNORM8: case R600_PACK_SNORM16:
+            fmt->num_format = SQ_NUM_FORMAT_NORM;
+            fmt->format_comp = SQ_FORMAT_COMP_SIGNED;
+            break;
+        case R600_PACK_U8: case R600_PACK_U16: case R600_PACK_U32:
+            fmt->num_format = SQ_NUM_FORMAT_INT;
+            fmt->format_comp = SQ_FORMAT_COMP_UNSIGNED;
+            break;
+        case R600_PACK_S8: case R600_PACK_S16: case R600_PACK_S32:
+            fmt->num_format = SQ_NUM_FORMAT_INT;
+            fmt->format_comp = SQ_FORMAT_COMP_SIGNED;
+            break;
+        }
+
+        return 0;
+    }
+
+    return -1;
+}
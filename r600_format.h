@@ -0,0 +1,119 @@
+/**
+ * r600_format.h: host-side packing of data into vertex-fetch formats
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_FORMAT_H_
+#define _R600_FORMAT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The vertex fetcher can expand narrow formats (16-bit floats, normalized
+ * and small integers) back to 32 bits per component, so packing on the host
+ * cuts the bytes we push over the bus.  The converters below work on whole
+ * arrays of scalars and use SSE2 when the compiler has it.
+ */
+
+/* What the kernel wants to see after the fetch */
+enum r600_fetch_kind {
+    R600_FETCH_FLOAT,   /* float32 in, float32 out */
+    R600_FETCH_SINT,    /* int32 in, int32 out */
+    R600_FETCH_UINT     /* uint32 in, uint32 out */
+};
+
+/* Host-side representation of each component in the buffer */
+enum r600_pack {
+    R600_PACK_F32,
+    R600_PACK_F16,
+    R600_PACK_UNORM8,
+    R600_PACK_SNORM8,
+    R600_PACK_UNORM16,
+    R600_PACK_SNORM16,
+    R600_PACK_U8,
+    R600_PACK_S8,
+    R600_PACK_U16,
+    R600_PACK_S16,
+    R600_PACK_U32,
+    R600_PACK_S32
+};
+
+/* Everything needed to fill in VTX_DWORD1_GPR/SQ_VTX_CONSTANT_WORD2 */
+struct r600_fetch_format {
+    enum r600_pack pack;
+    uint32_t data_format;   /* FMT_* */
+    uint32_t num_format;    /* SQ_NUM_FORMAT_* */
+    uint32_t format_comp;   /* SQ_FORMAT_COMP_* */
+    unsigned comp_bytes;    /* bytes per component in memory */
+    unsigned components;
+};
+
+/*
+ * Picks the narrowest format that can carry values in [min, max] with an
+ * absolute error of at most max_error after the fetch expands them
+ * (max_error is ignored for integer kinds, which must round-trip exactly).
+ * components is 1, 2 or 4 (3 is allowed for 32-bit formats only).
+ * Returns 0 on success, -1 if nothing fits.
+ */
+int r600_fetch_format_choose(enum r600_fetch_kind kind, unsigned components,
+                             double min, double max, double max_error,
+                             struct r600_fetch_format *fmt);
+
+/* Worst-case absolute error of the packing for values in [min, max] */
+double r600_pack_error(enum r600_pack pack, double min, double max);
+
+/* n is a count of scalars; src/dst need no particular alignment */
+void r600_pack_f32_to_f16(uint16_t *dst, const float *src, size_t n);
+void r600_unpack_f16_to_f32(float *dst, const uint16_t *src, size_t n);
+
+void r600_pack_f32_to_unorm8(uint8_t *dst, const float *src, size_t n);
+void r600_pack_f32_to_snorm8(int8_t *dst, const float *src, size_t n);
+void r600_pack_f32_to_unorm16(uint16_t *dst, const float *src, size_t n);
+void r600_pack_f32_to_snorm16(int16_t *dst, const float *src, size_t n);
+void r600_unpack_unorm8_to_f32(float *dst, const uint8_t *src, size_t n);
+void r600_unpack_snorm8_to_f32(float *dst, const int8_t *src, size_t n);
+void r600_unpack_unorm16_to_f32(float *dst, const uint16_t *src, size_t n);
+void r600_unpack_snorm16_to_f32(float *dst, const int16_t *src, size_t n);
+
+/* Integer narrowing saturates */
+void r600_pack_s32_to_s8(int8_t *dst, const int32_t *src, size_t n);
+void r600_pack_s32_to_s16(int16_t *dst, const int32_t *src, size_t n);
+void r600_pack_u32_to_u8(uint8_t *dst, const uint32_t *src, size_t n);
+void r600_pack_u32_to_u16(uint16_t *dst, const uint32_t *src, size_t n);
+void r600_unpack_s8_to_s32(int32_t *dst, const int8_t *src, size_t n);
+void r600_unpack_s16_to_s32(int32_t *dst, const int16_t *src, size_t n);
+void r600_unpack_u8_to_u32(uint32_t *dst, const uint8_t *src, size_t n);
+void r600_unpack_u16_to_u32(uint32_t *dst, const uint16_t *src, size_t n);
+
+/*
+ * Dispatch on fmt->pack.  src (for packing) and dst (for unpacking) hold
+ * float32, int32 or uint32 scalars according to the fetch kind the format
+ * was chosen for; n counts scalars, not elements.
+ */
+void r600_fetch_pack(const struct r600_fetch_format *fmt,
+                     void *dst, const void *src, size_t n);
+void r600_fetch_unpack(const struct r600_fetch_format *fmt,
+                       void *dst, const void *src, size_t n);
+
+#endif
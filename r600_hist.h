@@ -0,0 +1,90 @@
+/**
+ * r600_hist.h: power-of-two histograms for latencies and sizes
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_HIST_H_
+#define _R600_HIST_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Bucket 0 counts zeros and bucket i (i > 0) counts values in
+ * [2^(i-1), 2^i); the last one also takes everything bigger.
+ */
+
+#define R600_HIST_BUCKETS 40
+
+struct r600_hist {
+    uint64_t count[R600_HIST_BUCKETS];
+    uint64_t n, sum, max;
+};
+
+static inline unsigned r600_hist_bucket(uint64_t v)
+{
+    unsigned b = v != 0 ? 64 - __builtin_clzll(v) : 0;
+
+    return b < R600_HIST_BUCKETS ? b : R600_HIST_BUCKETS - 1;
+}
+
+static inline void r600_hist_add(struct r600_hist *h, uint64_t v)
+{
+    h->count[r600_hist_bucket(v)]++;
+    h->n++;
+    h->sum += v;
+    if(v > h->max)
+        h->max = v;
+}
+
+/* Smallest bucket bound at or above the p-th fraction of values (p <= 1) */
+static inline uint64_t r600_hist_quantile(const struct r600_hist *h, double p)
+{
+    uint64_t want = (uint64_t) (p * h->n), seen = 0;
+    unsigned i;
+
+    for(i = 0; i < R600_HIST_BUCKETS; i++) {
+        seen += h->count[i];
+        if(seen > want || seen == h->n)
+            return i != 0 ? (1ull << i) - 1 : 0;
+    }
+
+    return h->max;
+}
+
+/* One "lo-hi: count" line per nonempty bucket */
+static inline void r600_hist_print(const struct r600_hist *h, FILE *f, const char *unit)
+{
+    unsigned i;
+
+    for(i = 0; i < R600_HIST_BUCKETS; i++) {
+        if(h->count[i] == 0)
+            continue;
+        fprintf(f, "%12llu-%-12llu %s: %llu\n",
+                (unsigned long long) (i != 0 ? 1ull << (i - 1) : 0),
+                (unsigned long long) (i != 0 ? (1ull << i) - 1 : 0), unit,
+                (unsigned long long) h->count[i]);
+    }
+}
+
+#endif
@@ -0,0 +1,164 @@
+/**
+ * r600_ib.c: recorded command buffers for repeated dispatches
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <radeon_bo.h>
+
+#include "r600_reg.h"
+#include "r600_cmdbuf.h"
+#include "r600_ib.h"
+
+/* The CP fetches indirect buffers in 16-dword blocks */
+#define IB_ALIGN 16
+
+struct r600_ib *r600_ib_create(const struct r600_cmdbuf *cb)
+{
+    struct r600_ib *ib;
+
+    if((ib = calloc(1, sizeof(*ib))) == NULL)
+        return NULL;
+
+    ib->ndw = cb->cdw;
+    ib->nrelocs = cb->nrelocs;
+
+    ib->buf = malloc(ib->ndw * sizeof(uint32_t));
+    ib->relocs = malloc(ib->nrelocs * sizeof(struct r600_reloc));
+    if((ib->ndw > 0 && ib->buf == NULL) || (ib->nrelocs > 0 && ib->relocs == NULL)) {
+        r600_ib_destroy(ib);
+        return NULL;
+    }
+
+    memcpy(ib->buf, cb->buf, ib->ndw * sizeof(uint32_t));
+    memcpy(ib->relocs, cb->relocs, ib->nrelocs * sizeof(struct r600_reloc));
+    ib->dirty = 1;
+
+    return ib;
+}
+
+void r600_ib_destroy(struct r600_ib *ib)
+{
+    if(ib == NULL)
+        return;
+
+    if(ib->bo != NULL)
+        radeon_bo_unref(ib->bo);
+    free(ib->relocs);
+    free(ib->buf);
+    free(ib);
+}
+
+int r600_ib_find_reg(const struct r600_ib *ib, uint32_t reg)
+{
+    unsigned i, n;
+    uint32_t hdr, start;
+
+    for(i = 0; i < ib->ndw; i += n) {
+        hdr = ib->buf[i];
+        if(PACKET_TYPE(hdr) == 2) {
+            n = 1;
+            continue;
+        }
+        n = PACKET_NDW(hdr);
+
+        if(PACKET_TYPE(hdr) != 3 || r600_set_op_base(PACKET3_OP(hdr)) == 0 || i + 1 >= ib->ndw)
+            continue;
+
+        start = r600_set_op_base(PACKET3_OP(hdr)) + 4 * ib->buf[i + 1];
+        if(reg >= start && reg < start + 4 * (n - 2))
+            return i + 2 + (reg - start) / 4;
+    }
+
+    return -1;
+}
+
+int r600_ib_find_reloc(const struct r600_ib *ib, const struct radeon_bo *bo)
+{
+    unsigned i;
+
+    for(i = 0; i < ib->nrelocs; i++) {
+        if(ib->relocs[i].bo == bo)
+            return i;
+    }
+
+    return -1;
+}
+
+int r600_ib_replay(const struct r600_ib *ib, struct r600_cmdbuf *cb)
+{
+    return r600_cmdbuf_append(cb, ib->buf, ib->ndw, ib->relocs, ib->nrelocs, 0);
+}
+
+static unsigned padded(const struct r600_ib *ib)
+{
+    return (ib->ndw + IB_ALIGN - 1) & ~(IB_ALIGN - 1);
+}
+
+static int copy_out(struct r600_ib *ib)
+{
+    uint32_t *p;
+    unsigned i;
+    int ret;
+
+    if((ret = radeon_bo_map(ib->bo, 1)) != 0)
+        return ret;
+
+    p = ib->bo->ptr;
+    memcpy(p, ib->buf, ib->ndw * sizeof(uint32_t));
+    for(i = ib->ndw; i < padded(ib); i++)
+        p[i] = PACKET2;
+
+    radeon_bo_unmap(ib->bo);
+    ib->dirty = 0;
+
+    return 0;
+}
+
+int r600_ib_upload(struct r600_ib *ib, struct radeon_bo_manager *bom, uint32_t domain)
+{
+    if(ib->bo == NULL &&
+       (ib->bo = radeon_bo_open(bom, 0, padded(ib) * sizeof(uint32_t), 4096, domain, 0)) == NULL)
+        return -ENOMEM;
+    ib->domain = domain;
+
+    return copy_out(ib);
+}
+
+int r600_ib_call(struct r600_ib *ib, struct r600_cmdbuf *cb)
+{
+    int ret;
+
+    if(ib->nrelocs > 0)
+        return -ENOTSUP;
+    if(ib->bo == NULL)
+        return -EINVAL;
+    if(ib->dirty && (ret = copy_out(ib)) != 0)
+        return ret;
+
+    return r600_emit_indirect_buffer(cb, ib->bo, 0, ib->domain, padded(ib));
+}
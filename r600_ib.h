@@ -0,0 +1,95 @@
+/**
+ * r600_ib.h: recorded command buffers for repeated dispatches
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_IB_H_
+#define _R600_IB_H_
+
+#include <stdint.h>
+
+#include <radeon_bo.h>
+
+#include "r600_cmdbuf.h"
+
+/*
+ * A dispatch that is issued over and over with different buffers or
+ * constants is built once in an r600_cmdbuf and snapshotted here.  Each
+ * later dispatch patches just what changed (register values and the BOs
+ * behind relocations) and replays the snapshot.
+ *
+ * r600_ib_replay() copies the packets into a command buffer in one go,
+ * renumbering the relocations, so the kernel still checks and patches
+ * every address.  r600_ib_call() instead keeps the packets in their own BO
+ * and emits an IT_INDIRECT_BUFFER pointing at it.  Nothing can patch
+ * addresses inside that BO, so this only works for snapshots without
+ * relocations, and only on a submission path that accepts
+ * IT_INDIRECT_BUFFER (the stock radeon CS checker rejects it).
+ */
+
+struct r600_ib {
+    uint32_t *buf;
+    unsigned ndw;
+    struct r600_reloc *relocs;
+    unsigned nrelocs;
+
+    struct radeon_bo *bo;   /* for r600_ib_call(), see r600_ib_upload() */
+    uint32_t domain;
+    int dirty;              /* buf changed since the upload */
+};
+
+/* Snapshots everything in cb; returns NULL on failure */
+struct r600_ib *r600_ib_create(const struct r600_cmdbuf *cb);
+void r600_ib_destroy(struct r600_ib *ib);
+
+/* Index in ib->buf of the value written to reg, or -1 */
+int r600_ib_find_reg(const struct r600_ib *ib, uint32_t reg);
+
+/* Index of the first relocation against bo, or -1 */
+int r600_ib_find_reloc(const struct r600_ib *ib, const struct radeon_bo *bo);
+
+static inline void r600_ib_patch(struct r600_ib *ib, unsigned slot, uint32_t value)
+{
+    ib->buf[slot] = value;
+    ib->dirty = 1;
+}
+
+static inline void r600_ib_patch_bo(struct r600_ib *ib, unsigned reloc, struct radeon_bo *bo)
+{
+    ib->relocs[reloc].bo = bo;
+}
+
+/* Appends the packets to cb; returns 0 or -ENOMEM */
+int r600_ib_replay(const struct r600_ib *ib, struct r600_cmdbuf *cb);
+
+/* Copies the packets into a BO of their own; returns 0 or a negative errno */
+int r600_ib_upload(struct r600_ib *ib, struct radeon_bo_manager *bom, uint32_t domain);
+
+/*
+ * Emits an IT_INDIRECT_BUFFER running the uploaded packets, uploading them
+ * again first if they were patched; the GPU must be done with any earlier
+ * call by then.  Returns -ENOTSUP if ib has relocations.
+ */
+int r600_ib_call(struct r600_ib *ib, struct r600_cmdbuf *cb);
+
+#endif
@@ -0,0 +1,232 @@
+/**
+ * r600_readback.c: asynchronous buffer object readback
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#include <radeon_bo.h>
+
+#include "r600_readback.h"
+
+struct r600_readback {
+    struct r600_readback *next;
+    struct r600_readback_queue *q;
+
+    struct radeon_bo *bo;
+    uint32_t offset, size;
+    void *dst;
+    r600_readback_cb cb;
+    void *data;
+
+    int done, status;
+    int refs;           /* caller's handle + the queue's */
+};
+
+struct r600_readback_queue {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work;    /* signalled when something is queued */
+    pthread_cond_t done;    /* signalled when a readback completes */
+
+    struct r600_readback *head, *tail;
+    int quit;
+};
+
+/* Called with q->lock held */
+static void put_readback(struct r600_readback *rb)
+{
+    if(--rb->refs == 0)
+        free(rb);
+}
+
+static int do_readback(struct r600_readback *rb)
+{
+    int ret;
+
+    if(rb->offset > rb->bo->size || rb->size > rb->bo->size - rb->offset)
+        return -EINVAL;
+
+    /* This is the blocking part we are keeping off the caller's thread */
+    if((ret = radeon_bo_wait(rb->bo)) != 0)
+        return ret;
+
+    if((ret = radeon_bo_map(rb->bo, 0)) != 0)
+        return ret;
+    if(rb->bo->ptr == NULL) {
+        radeon_bo_unmap(rb->bo);
+        return -ENOMEM;
+    }
+
+    memcpy(rb->dst, (const unsigned char *) rb->bo->ptr + rb->offset, rb->size);
+    radeon_bo_unmap(rb->bo);
+
+    return 0;
+}
+
+static void *readback_thread(void *arg)
+{
+    struct r600_readback_queue *q = arg;
+    struct r600_readback *rb;
+    int status;
+
+    pthread_mutex_lock(&q->lock);
+
+    for(;;) {
+        while(q->head == NULL && !q->quit)
+            pthread_cond_wait(&q->work, &q->lock);
+
+        if((rb = q->head) == NULL)
+            break; /* quitting, and nothing left to do */
+
+        if((q->head = rb->next) == NULL)
+            q->tail = NULL;
+
+        pthread_mutex_unlock(&q->lock);
+
+        status = do_readback(rb);
+        if(rb->cb != NULL)
+            rb->cb(rb->data, status);
+
+        pthread_mutex_lock(&q->lock);
+        rb->status = status;
+        rb->done = 1;
+        put_readback(rb);
+        pthread_cond_broadcast(&q->done);
+    }
+
+    pthread_mutex_unlock(&q->lock);
+
+    return NULL;
+}
+
+struct r600_readback_queue *r600_readback_queue_create(void)
+{
+    struct r600_readback_queue *q;
+
+    if((q = calloc(1, sizeof(*q))) == NULL)
+        return NULL;
+
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->work, NULL);
+    pthread_cond_init(&q->done, NULL);
+
+    if(pthread_create(&q->thread, NULL, readback_thread, q) != 0) {
+        pthread_cond_destroy(&q->done);
+        pthread_cond_destroy(&q->work);
+        pthread_mutex_destroy(&q->lock);
+        free(q);
+        return NULL;
+    }
+
+    return q;
+}
+
+void r600_readback_queue_destroy(struct r600_readback_queue *q)
+{
+    if(q == NULL)
+        return;
+
+    pthread_mutex_lock(&q->lock);
+    q->quit = 1;
+    pthread_cond_signal(&q->work);
+    pthread_mutex_unlock(&q->lock);
+
+    pthread_join(q->thread, NULL);
+
+    pthread_cond_destroy(&q->done);
+    pthread_cond_destroy(&q->work);
+    pthread_mutex_destroy(&q->lock);
+    free(q);
+}
+
+struct r600_readback *r600_readback_async(struct r600_readback_queue *q,
+                                          struct radeon_bo *bo,
+                                          uint32_t offset, uint32_t size,
+                                          void *dst,
+                                          r600_readback_cb cb, void *data)
+{
+    struct r600_readback *rb;
+
+    if((rb = calloc(1, sizeof(*rb))) == NULL)
+        return NULL;
+
+    rb->q = q;
+    rb->bo = bo;
+    rb->offset = offset;
+    rb->size = size;
+    rb->dst = dst;
+    rb->cb = cb;
+    rb->data = data;
+    rb->refs = 2;
+
+    pthread_mutex_lock(&q->lock);
+    if(q->tail != NULL)
+        q->tail->next = rb;
+    else
+        q->head = rb;
+    q->tail = rb;
+    pthread_cond_signal(&q->work);
+    pthread_mutex_unlock(&q->lock);
+
+    return rb;
+}
+
+int r600_readback_done(struct r600_readback *rb)
+{
+    int done;
+
+    pthread_mutex_lock(&rb->q->lock);
+    done = rb->done;
+    pthread_mutex_unlock(&rb->q->lock);
+
+    return done;
+}
+
+int r600_readback_wait(struct r600_readback *rb)
+{
+    struct r600_readback_queue *q = rb->q;
+    int status;
+
+    pthread_mutex_lock(&q->lock);
+    while(!rb->done)
+        pthread_cond_wait(&q->done, &q->lock);
+    status = rb->status;
+    put_readback(rb);
+    pthread_mutex_unlock(&q->lock);
+
+    return status;
+}
+
+void r600_readback_release(struct r600_readback *rb)
+{
+    struct r600_readback_queue *q = rb->q;
+
+    pthread_mutex_lock(&q->lock);
+    put_readback(rb);
+    pthread_mutex_unlock(&q->lock);
+}
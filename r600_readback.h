@@ -0,0 +1,76 @@
+/**
+ * r600_readback.h: asynchronous buffer object readback
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_READBACK_H_
+#define _R600_READBACK_H_
+
+#include <stdint.h>
+
+#include <radeon_bo.h>
+
+/*
+ * radeon_bo_map() blocks until the GPU is done with the buffer.  Instead,
+ * readbacks are queued to a background thread which waits for the BO to
+ * go idle, maps it, copies the requested range out and unmaps it again;
+ * the caller learns about it through a callback, a handle it can poll or
+ * wait on, or both.
+ *
+ * The BO must stay referenced, and must not be mapped or unmapped by other
+ * threads, until its readback has completed.
+ */
+
+struct r600_readback_queue;
+struct r600_readback;
+
+/* status is 0 on success or a negative errno value */
+typedef void (*r600_readback_cb)(void *data, int status);
+
+struct r600_readback_queue *r600_readback_queue_create(void);
+
+/* Finishes all queued readbacks, then stops the thread */
+void r600_readback_queue_destroy(struct r600_readback_queue *q);
+
+/*
+ * Queues a copy of size bytes at offset in bo into dst.  cb (if not NULL) is
+ * called on the queue's thread once the copy is done.  Returns NULL if the
+ * request could not be queued; otherwise the handle must eventually be
+ * passed to r600_readback_wait() or r600_readback_release().
+ */
+struct r600_readback *r600_readback_async(struct r600_readback_queue *q,
+                                          struct radeon_bo *bo,
+                                          uint32_t offset, uint32_t size,
+                                          void *dst,
+                                          r600_readback_cb cb, void *data);
+
+/* Nonzero once the copy has landed in dst (never blocks) */
+int r600_readback_done(struct r600_readback *rb);
+
+/* Blocks until the copy has landed, frees the handle, returns its status */
+int r600_readback_wait(struct r600_readback *rb);
+
+/* Frees the handle without waiting; the copy and callback still happen */
+void r600_readback_release(struct r600_readback *rb);
+
+#endif
@@ -0,0 +1,173 @@
+/**
+ * r600_record.c: recording command streams on several threads at once
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include "r600_cmdbuf.h"
+#include "r600_regbuf.h"
+#include "r600_shadow.h"
+#include "r600_stream.h"
+#include "r600_record.h"
+
+struct r600_recorder *r600_recorder_create(struct r600_regbuf *rb)
+{
+    struct r600_recorder *rec;
+
+    if((rec = calloc(1, sizeof(*rec))) == NULL)
+        return NULL;
+
+    rec->rb = rb;
+    rec->max_groups = 64;
+
+    if((rec->cb = r600_cmdbuf_create(4096)) == NULL ||
+       (rec->groups = malloc(rec->max_groups * sizeof(*rec->groups))) == NULL) {
+        r600_recorder_destroy(rec);
+        return NULL;
+    }
+
+    return rec;
+}
+
+void r600_recorder_destroy(struct r600_recorder *rec)
+{
+    if(rec == NULL)
+        return;
+
+    r600_cmdbuf_destroy(rec->cb);
+    free(rec->groups);
+    free(rec);
+}
+
+void r600_recorder_reset(struct r600_recorder *rec)
+{
+    r600_cmdbuf_reset(rec->cb);
+    if(rec->rb != NULL) {
+        r600_regbuf_discard(rec->rb);
+        if(rec->rb->shadow != NULL)
+            r600_shadow_invalidate(rec->rb->shadow);
+    }
+    rec->ngroups = 0;
+}
+
+int r600_recorder_end_group(struct r600_recorder *rec)
+{
+    struct r600_group_end *g;
+    int ret;
+
+    if(rec->rb != NULL) {
+        ret = r600_regbuf_flush(rec->rb, rec->cb);
+        if(rec->rb->shadow != NULL)
+            r600_shadow_invalidate(rec->rb->shadow);
+        if(ret != 0)
+            return ret;
+    }
+
+    if(rec->ngroups > 0 && rec->groups[rec->ngroups - 1].cdw == rec->cb->cdw)
+        return 0;
+
+    if(rec->ngroups == rec->max_groups) {
+        if((g = realloc(rec->groups, rec->max_groups * 2 * sizeof(*g))) == NULL)
+            return -ENOMEM;
+        rec->groups = g;
+        rec->max_groups *= 2;
+    }
+
+    g = &rec->groups[rec->ngroups++];
+    g->cdw = rec->cb->cdw;
+    g->nrelocs = rec->cb->nrelocs;
+
+    return 0;
+}
+
+static int merge_one(struct r600_stream *s, struct r600_recorder *rec,
+                     struct r600_merge_stats *stats)
+{
+    const struct r600_cmdbuf *src = rec->cb;
+    unsigned i, cdw = 0, nrelocs = 0;
+    struct r600_group_end g;
+    int ret;
+
+    for(i = 0; i <= rec->ngroups; i++) {
+        if(i < rec->ngroups) {
+            g = rec->groups[i];
+        } else {
+            g.cdw = src->cdw;
+            g.nrelocs = src->nrelocs;
+            if(g.cdw == cdw)
+                break;
+        }
+
+        if((ret = r600_cmdbuf_append(s->cb, src->buf + cdw, g.cdw - cdw,
+                                     src->relocs + nrelocs, g.nrelocs - nrelocs, cdw)) != 0)
+            return ret;
+
+        if(stats != NULL) {
+            stats->groups++;
+            stats->dwords += g.cdw - cdw;
+            stats->relocs += g.nrelocs - nrelocs;
+        }
+        cdw = g.cdw;
+        nrelocs = g.nrelocs;
+    }
+
+    return 0;
+}
+
+int r600_merge(struct r600_stream *s, struct r600_recorder *const *recs, unsigned n,
+               struct r600_merge_stats *stats)
+{
+    struct r600_cmdbuf_mark m;
+    unsigned i;
+    int ret = 0;
+
+    /*
+     * Pending writes in the stream's regbuf go before the merged packets.
+     * The shadow is forgotten first, so a split in the middle of the merge
+     * doesn't re-send state the groups have since changed.
+     */
+    if(s->rb != NULL) {
+        ret = r600_regbuf_flush(s->rb, s->cb);
+        if(s->rb->shadow != NULL)
+            r600_shadow_invalidate(s->rb->shadow);
+        if(ret != 0)
+            return ret;
+    }
+
+    r600_cmdbuf_mark(s->cb, &m);
+
+    for(i = 0; i < n && ret == 0; i++)
+        ret = merge_one(s, recs[i], stats);
+
+    if(ret != 0) {
+        r600_cmdbuf_rollback(s->cb, &m);
+        return ret;
+    }
+
+    for(i = 0; i < n; i++)
+        r600_recorder_reset(recs[i]);
+
+    return 0;
+}
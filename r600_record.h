@@ -0,0 +1,92 @@
+/**
+ * r600_record.h: recording command streams on several threads at once
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_RECORD_H_
+#define _R600_RECORD_H_
+
+#include "r600_cmdbuf.h"
+#include "r600_regbuf.h"
+#include "r600_stream.h"
+
+/*
+ * Building thousands of dispatches (descriptors, constants, state) is
+ * CPU work that one thread does slowly.  Instead each thread records its
+ * share into a recorder of its own, with no shared state and no locks,
+ * and the finished recorders are merged into a stream in a fixed order.
+ *
+ * A recorder's packets come in groups, each ended by
+ * r600_recorder_end_group(): a dispatch with all the state it needs, say.
+ * The merge copies whole groups, so when a segment fills up the split
+ * lands between two groups and never inside one; a group therefore has
+ * to stand on its own, and must fit in a segment.  If the recorder has a
+ * regbuf, its shadow is invalidated at every group end for the same
+ * reason.
+ *
+ * Relocations are copied along with the packets.  When a segment is
+ * submitted, every BO the merged groups name is checked and written to
+ * the kernel once (see r600_cmdbuf_submit()), however many recorders
+ * referred to it.
+ */
+
+struct r600_group_end {
+    unsigned cdw, nrelocs;
+};
+
+struct r600_recorder {
+    struct r600_cmdbuf *cb;
+    struct r600_regbuf *rb;     /* may be NULL */
+
+    struct r600_group_end *groups;
+    unsigned ngroups, max_groups;
+};
+
+struct r600_merge_stats {
+    uint64_t groups;
+    uint64_t dwords;
+    uint64_t relocs;
+};
+
+/* rb, with its shadow, is optional */
+struct r600_recorder *r600_recorder_create(struct r600_regbuf *rb);
+void r600_recorder_destroy(struct r600_recorder *rec);
+
+/* Drops everything recorded */
+void r600_recorder_reset(struct r600_recorder *rec);
+
+/* Flushes the regbuf and closes the group; returns 0 or -ENOMEM */
+int r600_recorder_end_group(struct r600_recorder *rec);
+
+/*
+ * Appends the groups of recs[0], then recs[1], and so on to s, and resets
+ * the recorders; anything after a recorder's last group end counts as a
+ * group of its own.  The packets bypass s->rb, so its shadow is
+ * invalidated.  stats may be NULL.  Returns 0 or a negative errno value;
+ * on failure what already went out in earlier segments stays submitted,
+ * the rest is dropped from s and the recorders are left as they were.
+ */
+int r600_merge(struct r600_stream *s, struct r600_recorder *const *recs, unsigned n,
+               struct r600_merge_stats *stats);
+
+#endif
@@ -98,6 +98,7 @@ enum {
     IT_MEM_WRITE                         = 0x3D,
     IT_INDIRECT_BUFFER                   = 0x32,
     IT_CP_INTERRUPT                      = 0x40,
+    IT_CP_DMA                            = 0x41,
     IT_SURFACE_SYNC                      = 0x43,
     IT_ME_INITIALIZE                     = 0x44,
     IT_COND_WRITE                        = 0x45,
@@ -129,6 +130,13 @@ enum {
 
 #define IT_WAIT_ADDR(x)         ((x) >> 2)
 
+/* IT_MEM_WRITE */
+#define IT_MEM_WRITE_DATA32     (1 << 18)
+
+/* IT_CP_DMA */
+#define IT_CP_DMA_CP_SYNC       (1u << 31)
+#define IT_CP_DMA_MAX_BYTES     0x1fffff
+
 /* IT_INDEX_TYPE */
 #define IT_INDEX_TYPE_SWAP_MODE(x) ((x) << 2)
 
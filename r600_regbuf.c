@@ -0,0 +1,305 @@
+/**
+ * r600_regbuf.c: coalesced register writes
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <radeon_cs.h>
+
+#include "r600_cmdbuf.h"
+#include "r600_shadow.h"
+#include "r600_regbuf.h"
+
+struct r600_regbuf *r600_regbuf_create(void)
+{
+    return calloc(1, sizeof(struct r600_regbuf));
+}
+
+void r600_regbuf_destroy(struct r600_regbuf *rb)
+{
+    if(rb == NULL)
+        return;
+
+    free(rb->vals);
+    free(rb->w);
+    free(rb);
+}
+
+static int reserve(struct r600_regbuf *rb, unsigned n)
+{
+    unsigned max;
+    void *p;
+
+    if(rb->n + n <= rb->max)
+        return 0;
+
+    for(max = rb->max > 0 ? rb->max * 2 : 64; max < rb->n + n; max *= 2)
+        ;
+
+    if((p = realloc(rb->w, max * sizeof(struct r600_reg_write))) == NULL)
+        return -ENOMEM;
+    rb->w = p;
+    if((p = realloc(rb->vals, max * sizeof(uint32_t))) == NULL)
+        return -ENOMEM;
+    rb->vals = p;
+    rb->max = max;
+
+    return 0;
+}
+
+int r600_regbuf_set_n(struct r600_regbuf *rb, uint32_t reg, unsigned n,
+                      const uint32_t *vals)
+{
+    struct r600_reg_write *w;
+    uint32_t base;
+    unsigned i, op, entry;
+    int idx, ret;
+
+    if(n == 0)
+        return 0;
+
+    if((reg & 3) != 0 || (op = r600_set_reg_op(reg, &base)) == 0)
+        return -EINVAL;
+
+    if(r600_set_reg_op(reg + 4 * (n - 1), &base) != op) {
+        /* Runs into another window (or off the end of this one): all or nothing */
+        for(i = 1; i < n; i++) {
+            if(r600_set_reg_op(reg + 4 * i, &base) == 0)
+                return -EINVAL;
+        }
+        if((ret = reserve(rb, n)) != 0)
+            return ret;
+
+        entry = rb->n;
+        for(i = 0; i < n; i++) {
+            if((ret = r600_regbuf_set_n(rb, reg + 4 * i, 1, vals + i)) != 0) {
+                rb->stats.writes -= rb->n - entry;
+                rb->n = entry;
+                return ret;
+            }
+        }
+        return 0;
+    }
+
+    if((ret = reserve(rb, n)) != 0)
+        return ret;
+
+    idx = r600_shadow_index(reg);
+    for(i = 0; i < n; i++) {
+        w = &rb->w[rb->n];
+        w->reg = reg + 4 * i;
+        w->value = vals[i];
+        w->seq = rb->n++;
+        w->op = op;
+        w->idx = idx + i;
+    }
+    rb->stats.writes += n;
+
+    return 0;
+}
+
+int r600_regbuf_set(struct r600_regbuf *rb, uint32_t reg, uint32_t value)
+{
+    return r600_regbuf_set_n(rb, reg, 1, &value);
+}
+
+void r600_regbuf_discard(struct r600_regbuf *rb)
+{
+    rb->n = 0;
+}
+
+static int cmp_write(const void *a, const void *b)
+{
+    const struct r600_reg_write *x = a, *y = b;
+
+    if(x->reg != y->reg)
+        return x->reg < y->reg ? -1 : 1;
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+/*
+ * Writes mostly arrive in order or in a few sorted runs, which insertion
+ * sort handles in close to linear time; if it turns out to be doing a lot
+ * of shifting, the rest is left to qsort().  Both keep equal registers in
+ * the order they were written.
+ */
+static void sort(struct r600_reg_write *w, unsigned n)
+{
+    struct r600_reg_write t;
+    unsigned i, lo, hi, mid, budget = 8 * n;
+
+    for(i = 1; i < n; i++) {
+        if(w[i - 1].reg <= w[i].reg)
+            continue;
+
+        /* After any earlier writes to the same register */
+        for(lo = 0, hi = i - 1; lo < hi; ) {
+            mid = (lo + hi) / 2;
+            if(w[mid].reg <= w[i].reg)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        if(i - lo > budget) {
+            qsort(w, n, sizeof(struct r600_reg_write), cmp_write);
+            return;
+        }
+        budget -= i - lo;
+
+        t = w[i];
+        memmove(w + lo + 1, w + lo, (i - lo) * sizeof(struct r600_reg_write));
+        w[lo] = t;
+    }
+}
+
+/* Sorts and keeps only the last write to each register; returns the count */
+static unsigned sort_unique(struct r600_regbuf *rb)
+{
+    unsigned i, n = 0;
+
+    sort(rb->w, rb->n);
+
+    for(i = 0; i < rb->n; i++) {
+        if(n > 0 && rb->w[n - 1].reg == rb->w[i].reg)
+            n--;
+        rb->w[n++] = rb->w[i];
+    }
+
+    return n;
+}
+
+/* Whether b can go in the same SET_* packet right after a */
+static inline int adjacent(const struct r600_reg_write *a, const struct r600_reg_write *b)
+{
+    return b->reg == a->reg + 4 && a->op == b->op;
+}
+
+/* Dwords needed to send the writes marked keep */
+static unsigned cost(const struct r600_reg_write *w, unsigned n)
+{
+    unsigned i, ndw = 0;
+
+    for(i = 0; i < n; i++) {
+        if(w[i].keep)
+            ndw += (i > 0 && w[i - 1].keep && adjacent(&w[i - 1], &w[i])) ? 1 : 3;
+    }
+
+    return ndw;
+}
+
+static void mark_changed(struct r600_regbuf *rb)
+{
+    struct r600_reg_write *w = rb->w;
+    unsigned i;
+
+    for(i = 0; i < rb->n; i++)
+        w[i].keep = rb->shadow == NULL ||
+                    !r600_shadow_match_at(rb->shadow, w[i].idx, w[i].value);
+
+    /* Refilling a one-register hole is cheaper than a second header */
+    for(i = 1; i + 1 < rb->n; i++) {
+        if(!w[i].keep && w[i - 1].keep && w[i + 1].keep &&
+           adjacent(&w[i - 1], &w[i]) && adjacent(&w[i], &w[i + 1]))
+            w[i].keep = 1;
+    }
+}
+
+int r600_regbuf_flush(struct r600_regbuf *rb, struct r600_cmdbuf *cb)
+{
+    unsigned i, j, k, n, full, ndw = 0, regs = 0, packets = 0;
+    struct r600_cmdbuf_mark m;
+    int ret;
+
+    if(rb->n == 0)
+        return 0;
+
+    n = sort_unique(rb);
+    rb->stats.overwritten += rb->n - n;
+    rb->n = n;
+
+    for(i = 0; i < n; i++)
+        rb->w[i].keep = 1;
+    full = cost(rb->w, n);
+    mark_changed(rb);
+
+    r600_cmdbuf_mark(cb, &m);
+
+    for(i = 0; i < n; i = j) {
+        if(!rb->w[i].keep) {
+            j = i + 1;
+            continue;
+        }
+
+        rb->vals[0] = rb->w[i].value;
+        for(j = i + 1; j < n && rb->w[j].keep && adjacent(&rb->w[j - 1], &rb->w[j]); j++)
+            rb->vals[j - i] = rb->w[j].value;
+
+        if((ret = r600_emit_set_regs(cb, rb->w[i].reg, j - i, rb->vals)) != 0) {
+            /* The sorted, unique queue is still there to retry from */
+            r600_cmdbuf_rollback(cb, &m);
+            for(k = 0; rb->shadow != NULL && k < i; k++)
+                r600_shadow_invalidate_range(rb->shadow, rb->w[k].reg, 1);
+            return ret;
+        }
+
+        /*
+         * Kept current packet by packet, so that if the stream is split
+         * here the shadow says exactly what has been sent so far.
+         */
+        for(k = i; rb->shadow != NULL && k < j; k++)
+            r600_shadow_update_at(rb->shadow, rb->w[k].idx, rb->w[k].value);
+
+        ndw += R600_SET_REGS_DW(j - i);
+        regs += j - i;
+        packets++;
+    }
+
+    rb->stats.regs += regs;
+    rb->stats.packets += packets;
+    rb->stats.headers_saved += 2 * (regs - packets);
+    rb->stats.flushes++;
+    rb->stats.last_elided = full - ndw;
+    rb->stats.elided += rb->stats.last_elided;
+    rb->n = 0;
+
+    return 0;
+}
+
+int r600_regbuf_submit(struct r600_regbuf *rb, struct r600_cmdbuf *cb,
+                       struct radeon_cs *cs)
+{
+    int ret;
+
+    if((ret = r600_regbuf_flush(rb, cb)) == 0)
+        ret = r600_cmdbuf_submit(cb, cs);
+
+    if(rb->shadow != NULL)
+        r600_shadow_invalidate(rb->shadow);
+
+    return ret;
+}
@@ -0,0 +1,100 @@
+/**
+ * r600_regbuf.h: coalesced register writes
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_REGBUF_H_
+#define _R600_REGBUF_H_
+
+#include <stdint.h>
+
+#include <radeon_cs.h>
+
+#include "r600_cmdbuf.h"
+#include "r600_shadow.h"
+
+/*
+ * Register writes are queued instead of emitted one packet each.  At flush
+ * time they are sorted by address (which also groups them by SET_* window)
+ * and every run of consecutive registers inside one window becomes a
+ * single SET_* packet.  If a register is written twice before a flush, the
+ * later value wins.
+ *
+ * With a shadow attached (rb->shadow), writes of the value a register
+ * already holds are dropped as well.  A lone unchanged register between
+ * two changed ones is still sent, since that costs one dword where
+ * splitting the packet would cost two.  Flushing once per dispatch makes
+ * the elision counts per dispatch.
+ */
+
+struct r600_regbuf_stats {
+    uint64_t writes;            /* registers queued */
+    uint64_t overwritten;       /* replaced by a later write before a flush */
+    uint64_t regs;              /* registers emitted */
+    uint64_t packets;           /* SET_* packets emitted */
+    uint64_t headers_saved;     /* dwords saved against a packet per register */
+
+    uint64_t flushes;
+    uint64_t elided;            /* dwords the shadow saved */
+    unsigned last_elided;       /* ... in the last flush */
+};
+
+struct r600_reg_write {
+    uint32_t reg, value;
+    unsigned seq;
+    unsigned op;            /* IT_SET_* */
+    int idx;                /* in the shadow */
+    int keep;
+};
+
+struct r600_regbuf {
+    struct r600_reg_write *w;
+    uint32_t *vals;
+    unsigned n, max;
+
+    struct r600_shadow *shadow;
+    struct r600_regbuf_stats stats;
+};
+
+struct r600_regbuf *r600_regbuf_create(void);
+void r600_regbuf_destroy(struct r600_regbuf *rb);
+
+/* Returns 0, -EINVAL if any reg is not in a SET_* window (nothing is queued then), or -ENOMEM */
+int r600_regbuf_set(struct r600_regbuf *rb, uint32_t reg, uint32_t value);
+int r600_regbuf_set_n(struct r600_regbuf *rb, uint32_t reg, unsigned n,
+                      const uint32_t *vals);
+
+/* Emits and clears the queued writes; on failure the queue is kept */
+int r600_regbuf_flush(struct r600_regbuf *rb, struct r600_cmdbuf *cb);
+
+/*
+ * Flushes, submits cb to cs, and invalidates the shadow, which cannot be
+ * trusted past the end of a submission (or at all, if it failed).
+ */
+int r600_regbuf_submit(struct r600_regbuf *rb, struct r600_cmdbuf *cb,
+                       struct radeon_cs *cs);
+
+/* Drops the queued writes */
+void r600_regbuf_discard(struct r600_regbuf *rb);
+
+#endif
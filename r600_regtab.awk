@@ -0,0 +1,306 @@
+# r600_regtab.awk: register metadata table generated from the register headers
+#
+# Copyright © 2011 Zachary Catlin <z@zc.is>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice (including the next
+# paragraph) shall be included in all copies or substantial portions of the
+# Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+# THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+# ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+# OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+# Usage: awk -f r600_regtab.awk r600_regtab.h r600_reg.h r600_reg_*.h > r600_regtab.c
+#
+# The hash parameters come from the #defines in r600_regtab.h and the
+# SET_* windows from the enum in r600_reg.h.  Registers, from the
+# r600_reg_*.h files only, are the enum entries indented by four spaces
+# with a hex value; the entries indented further after one are its fields
+# (_mask and _bit), array size (_num) and array stride (_offset).  Spaces
+# and tabs around "=" don't matter.  An entry shaped like a register or
+# a field that none of the rules take is an error, so a header edit can't
+# drop registers from the table unnoticed.  Where several names share an
+# offset the first one seen wins.  mawk has no bitwise operators, so the
+# hashes are done in plain arithmetic, which is exact here: keys are
+# below 2^16 and multipliers below 2^33.
+
+function hex(s,    i, n)
+{
+    n = 0
+    s = tolower(s)
+    sub(/^0x/, "", s)
+    sub(/u$/, "", s)
+    for(i = 1; i <= length(s); i++)
+        n = n * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+    return n
+}
+
+function num(s)
+{
+    sub(/^[ \t]+/, "", s)
+    sub(/[ \t]*,?[ \t]*$/, "", s)
+    return s ~ /^0[xX]/ ? hex(s) : s + 0
+}
+
+# The current line's enum entry name and value, however it is spaced
+function ename(    s)
+{
+    s = $0
+    sub(/^[ \t]+/, "", s)
+    sub(/[ \t]*=.*/, "", s)
+    return s
+}
+
+function evalue(    s)
+{
+    s = $0
+    sub(/^[^=]*=[ \t]*/, "", s)
+    sub(/[ \t]*,.*/, "", s)
+    return s
+}
+
+function tohex(n,    s)
+{
+    s = ""
+    do {
+        s = substr("0123456789abcdef", n % 16 + 1, 1) s
+        n = int(n / 16)
+    } while(n > 0)
+    return "0x" s
+}
+
+# The top bits bits of the 32-bit product k * mul
+function hash(k, mul, bits)
+{
+    return int((k * mul) % 4294967296 / 2 ^ (32 - bits))
+}
+
+# A field's mask, from "<value> << <shift>,"
+function field(name, s,    a, b)
+{
+    a = s
+    sub(/[ \t]*<<.*/, "", a)
+    b = s
+    sub(/.*<<[ \t]*/, "", b)
+    sub(/[ \t]*,.*/, "", b)
+
+    nfields++
+    fname[nfields] = name
+    fmask[nfields] = num(a) * 2 ^ b
+    fshift[nfields] = b + 0
+    rnfields[cur]++
+}
+
+/^#define R600_REGHASH_/ {
+    param[$2] = num($3)
+    next
+}
+
+/^    SET_[A-Z_]+_(offset|end)[ \t]*=[ \t]*0x/ {
+    w = ename()
+    sub(/^SET_/, "", w)
+    if(w ~ /_offset$/) {
+        sub(/_offset$/, "", w)
+        wstart[w] = num(evalue())
+        windows[++nwindows] = w
+    } else {
+        sub(/_end$/, "", w)
+        wend[w] = num(evalue())
+    }
+    next
+}
+
+FILENAME !~ /r600_reg_[^\/]*\.h$/ {
+    next
+}
+
+/^    [A-Za-z0-9_]+[ \t]*=[ \t]*0x[0-9a-fA-F]+[ \t]*,/ {
+    value = hex(evalue())
+
+    # The shader instruction-word layouts all use 0x8dfc as a placeholder,
+    # and later names for an offset are aliases
+    cur = 0
+    if(value == 36348 || (value in byoffset))
+        next
+
+    cur = ++nregs
+    byoffset[value] = cur
+    rname[cur] = ename()
+    roff[cur] = value
+    rnum[cur] = 1
+    rstride[cur] = 4
+    rfield[cur] = nfields
+    rnfields[cur] = 0
+    next
+}
+
+/^    [^ \t]/ {
+    cur = 0
+}
+
+# Fields of a register that was skipped are left out with it
+/^(\t|        )[ \t]*[A-Za-z0-9_]+_(mask|bit)[ \t]*=[^<]*<</ {
+    if(cur != 0) {
+        n = ename()
+        sub(/_(mask|bit)$/, "", n)
+        field(n, substr($0, index($0, "=") + 1))
+    }
+    next
+}
+
+cur != 0 && ename() == rname[cur] "_num" {
+    rnum[cur] = num(evalue())
+}
+
+cur != 0 && ename() == rname[cur] "_offset" {
+    rstride[cur] = num(evalue())
+}
+
+/^[ \t]*[A-Za-z0-9_]+_(mask|bit)[ \t]*=[^<]*<</ ||
+/^    [A-Za-z0-9_]+[ \t]*=[ \t]*0[xX]/ {
+    print "r600_regtab.awk: " FILENAME ":" FNR ": no rule for \"" $0 "\"" > "/dev/stderr"
+    failed = 1
+}
+
+END {
+    if(failed)
+        exit 1
+
+    bbits = param["R600_REGHASH_BUCKET_BITS"]
+    tbits = param["R600_REGHASH_BITS"]
+    mul1 = param["R600_REGHASH_MUL1"]
+    mul2 = param["R600_REGHASH_MUL2"]
+    empty = param["R600_REGHASH_EMPTY"]
+    if(bbits == 0 || tbits == 0 || nwindows == 0) {
+        print "r600_regtab.awk: needs r600_regtab.h and r600_reg.h first" > "/dev/stderr"
+        exit 1
+    }
+
+    # Sort by offset; order[i] is the i-th register, sorted[r] its position
+    for(i = 1; i <= nregs; i++)
+        order[i] = i
+    for(i = 2; i <= nregs; i++) {
+        r = order[i]
+        for(j = i - 1; j >= 1 && roff[order[j]] > roff[r]; j--)
+            order[j + 1] = order[j]
+        order[j + 1] = r
+    }
+    for(i = 1; i <= nregs; i++)
+        sorted[order[i]] = i - 1
+
+    # Keys: every register, then the other elements of each array where
+    # no register of their own is named
+    for(r = 1; r <= nregs; r++) {
+        nkeys++
+        key[nkeys] = roff[r] / 4
+        kreg[nkeys] = sorted[r]
+        kindex[nkeys] = 0
+        taken[roff[r]] = 1
+    }
+    for(r = 1; r <= nregs; r++) {
+        for(i = 1; i < rnum[r]; i++) {
+            o = roff[r] + i * rstride[r]
+            if(o in taken)
+                continue
+            taken[o] = 1
+            nkeys++
+            key[nkeys] = o / 4
+            kreg[nkeys] = sorted[r]
+            kindex[nkeys] = i
+        }
+    }
+
+    # Place the buckets, biggest first, each with the first displacement
+    # that sends all of its keys to distinct free slots
+    nbuckets = 2 ^ bbits
+    nslots = 2 ^ tbits
+    for(i = 1; i <= nkeys; i++) {
+        b = hash(key[i], mul1, bbits)
+        bkeys[b, ++bsize[b]] = i
+        if(bsize[b] > maxsize)
+            maxsize = bsize[b]
+    }
+    for(size = maxsize; size > 0; size--) {
+        for(b = 0; b < nbuckets; b++) {
+            if(bsize[b] != size)
+                continue
+            for(d = 0; d < empty; d++) {
+                mul = (mul2 + 2 * d) % 4294967296
+                ok = 1
+                for(i = 1; i <= size && ok; i++) {
+                    s = hash(key[bkeys[b, i]], mul, tbits)
+                    if((s in slot) || (s in trial))
+                        ok = 0
+                    trial[s] = 1
+                }
+                split("", trial)
+                if(ok)
+                    break
+            }
+            if(!ok) {
+                print "r600_regtab.awk: can't place bucket " b ", raise R600_REGHASH_BITS" > "/dev/stderr"
+                exit 1
+            }
+            disp[b] = d
+            for(i = 1; i <= size; i++)
+                slot[hash(key[bkeys[b, i]], mul, tbits)] = bkeys[b, i]
+        }
+    }
+
+    print "/* Generated by r600_regtab.awk from the register headers; do not edit */"
+    print ""
+    print "#include <stdint.h>"
+    print ""
+    print "#include \"r600_reg.h\""
+    print "#include \"r600_regtab.h\""
+    print ""
+    print "const struct r600_reg_info r600_regs[] = {"
+    for(i = 1; i <= nregs; i++) {
+        r = order[i]
+        op = "0"
+        for(w = 1; w <= nwindows; w++) {
+            if(roff[r] >= wstart[windows[w]] && roff[r] < wend[windows[w]])
+                op = "IT_SET_" windows[w]
+        }
+        printf("    { %s, \"%s\", %s, %d, %d, %d, %d },\n", tohex(roff[r]), rname[r], op,
+               rnum[r], rstride[r], rfield[r], rnfields[r])
+    }
+    print "};"
+    print ""
+    print "const unsigned r600_nregs = " nregs ";"
+    print ""
+    print "const struct r600_reg_field r600_reg_fields[] = {"
+    for(i = 1; i <= nfields; i++)
+        printf("    { \"%s\", %s, %d },\n", fname[i], tohex(fmask[i]), fshift[i])
+    print "};"
+    print ""
+    print "const uint16_t r600_reghash_disp[1 << R600_REGHASH_BUCKET_BITS] = {"
+    for(b = 0; b < nbuckets; b += 8) {
+        line = "   "
+        for(i = b; i < b + 8; i++)
+            line = line " " (i in disp ? disp[i] : 0) ","
+        print line
+    }
+    print "};"
+    print ""
+    print "const struct r600_reg_slot r600_reghash[1 << R600_REGHASH_BITS] = {"
+    for(s = 0; s < nslots; s++) {
+        if(s in slot)
+            printf("    { %s, %d, %d },\n", tohex(key[slot[s]]), kreg[slot[s]], kindex[slot[s]])
+        else
+            print "    { R600_REGHASH_EMPTY, 0, 0 },"
+    }
+    print "};"
+}
@@ -0,0 +1,104 @@
+/**
+ * r600_regtab.h: register metadata, generated from the register headers
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_REGTAB_H_
+#define _R600_REGTAB_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Every register in r600_reg_*.h with its name, the IT_SET_* packet whose
+ * window holds it, its fields and, for register arrays (the ones with a
+ * _num in the headers), the element count and stride.  r600_regtab.c is
+ * generated from the headers by r600_regtab.awk, so it follows them when
+ * they change, and nothing is parsed at run time.
+ *
+ * r600_reg_lookup() finds a register, or an element of an array, by
+ * offset in constant time through a perfect hash built by the generator:
+ * one multiplicative hash picks a bucket, and the bucket's displacement
+ * picks the multiplier of a second hash that sends each of its keys to a
+ * slot of its own.  The parameters below are read by the generator too;
+ * if it fails to place every key, raise R600_REGHASH_BITS.
+ */
+
+#define R600_REGHASH_BUCKET_BITS    8
+#define R600_REGHASH_BITS           11
+#define R600_REGHASH_MUL1           2654435761u
+#define R600_REGHASH_MUL2           2246822519u
+#define R600_REGHASH_EMPTY          0xffff
+
+struct r600_reg_field {
+    const char *name;
+    uint32_t mask;
+    unsigned shift;
+};
+
+struct r600_reg_info {
+    uint32_t offset;
+    const char *name;
+    uint8_t set_op;         /* IT_SET_* for the window it is in; 0 if none */
+    uint16_t num, stride;   /* num elements stride bytes apart; 1 and 4 if not an array */
+    uint16_t field, nfields;    /* r600_reg_fields[field], ... */
+};
+
+struct r600_reg_slot {
+    uint16_t key;           /* offset / 4, or R600_REGHASH_EMPTY */
+    uint16_t reg;           /* index into r600_regs */
+    uint16_t index;         /* array element */
+};
+
+/* Sorted by offset */
+extern const struct r600_reg_info r600_regs[];
+extern const unsigned r600_nregs;
+extern const struct r600_reg_field r600_reg_fields[];
+
+extern const uint16_t r600_reghash_disp[1 << R600_REGHASH_BUCKET_BITS];
+extern const struct r600_reg_slot r600_reghash[1 << R600_REGHASH_BITS];
+
+/*
+ * The register at reg, or the array it is element *index of (index may
+ * be NULL); NULL if the headers don't name it.
+ */
+static inline const struct r600_reg_info *r600_reg_lookup(uint32_t reg, unsigned *index)
+{
+    const struct r600_reg_slot *s;
+    uint32_t k = reg >> 2, b;
+
+    if((reg & 3) != 0 || k >= R600_REGHASH_EMPTY)
+        return NULL;
+
+    b = (k * R600_REGHASH_MUL1) >> (32 - R600_REGHASH_BUCKET_BITS);
+    s = &r600_reghash[(k * (R600_REGHASH_MUL2 + 2u * r600_reghash_disp[b])) >>
+                      (32 - R600_REGHASH_BITS)];
+    if(s->key != k)
+        return NULL;
+
+    if(index != NULL)
+        *index = s->index;
+    return &r600_regs[s->reg];
+}
+
+#endif
@@ -0,0 +1,284 @@
+/**
+ * r600_relayout.c: record relayout for mega-fetch
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "r600_relayout.h"
+
+#define ALIGN(x, a) (((x) + (a) - 1) & ~((a) - 1))
+
+/* Below this many bytes of output, thread startup costs more than it saves */
+#define MIN_BYTES_PER_THREAD (256 * 1024)
+
+static unsigned field_align(unsigned size)
+{
+    return size >= 4 ? 4 : (size >= 2 ? 2 : 1);
+}
+
+/* Places a stream's fields in source order and computes its stride */
+static void layout_stream(struct r600_stream_layout *s, const struct r600_field *fields)
+{
+    unsigned i, j, pos = 0;
+
+    /* Insertion sort by source offset; there are never many fields */
+    for(i = 1; i < s->nfields; i++) {
+        unsigned f = s->field[i];
+
+        for(j = i; j > 0 && fields[s->field[j - 1]].offset > fields[f].offset; j--)
+            s->field[j] = s->field[j - 1];
+        s->field[j] = f;
+    }
+
+    for(i = 0; i < s->nfields; i++) {
+        const struct r600_field *fd = &fields[s->field[i]];
+
+        pos = ALIGN(pos, field_align(fd->size));
+        s->dst_offset[i] = pos;
+        pos += fd->size;
+    }
+
+    s->stride = ALIGN(pos, 4);
+}
+
+static void make_runs(struct r600_stream_layout *s, const struct r600_field *fields)
+{
+    unsigned i;
+
+    s->nruns = 0;
+
+    for(i = 0; i < s->nfields; i++) {
+        const struct r600_field *fd = &fields[s->field[i]];
+        unsigned r = s->nruns;
+
+        if(r > 0 && s->run_src[r - 1] + s->run_size[r - 1] == fd->offset &&
+           s->run_dst[r - 1] + s->run_size[r - 1] == s->dst_offset[i]) {
+            s->run_size[r - 1] += fd->size;
+        } else {
+            s->run_src[r] = fd->offset;
+            s->run_dst[r] = s->dst_offset[i];
+            s->run_size[r] = fd->size;
+            s->nruns++;
+        }
+    }
+}
+
+/* Bytes a mega-fetch walk over the original records would read */
+static unsigned aos_fetch_bytes(const struct r600_field *fields, unsigned nfields)
+{
+    unsigned order[R600_RELAYOUT_MAX_FIELDS];
+    unsigned i, j, total = 0, start = 0, end = 0;
+
+    for(i = 0; i < nfields; i++) {
+        for(j = i; j > 0 && fields[order[j - 1]].offset > fields[i].offset; j--)
+            order[j] = order[j - 1];
+        order[j] = i;
+    }
+
+    for(i = 0; i < nfields; i++) {
+        const struct r600_field *fd = &fields[order[i]];
+
+        if(i == 0 || fd->offset + fd->size - start > R600_MEGA_FETCH_MAX) {
+            if(i > 0)
+                total += ALIGN(end - start, 4);
+            start = fd->offset;
+            end = fd->offset + fd->size;
+        } else if(fd->offset + fd->size > end) {
+            end = fd->offset + fd->size;
+        }
+    }
+
+    if(nfields > 0)
+        total += ALIGN(end - start, 4);
+
+    return total;
+}
+
+int r600_relayout_plan(const struct r600_field *fields, unsigned nfields,
+                       unsigned src_stride, struct r600_relayout *plan)
+{
+    unsigned order[R600_RELAYOUT_MAX_FIELDS];
+    unsigned i, j;
+
+    if(nfields == 0 || nfields > R600_RELAYOUT_MAX_FIELDS)
+        return -1;
+
+    for(i = 0; i < nfields; i++)
+        if(fields[i].size == 0 || fields[i].size > R600_MEGA_FETCH_MAX ||
+           fields[i].offset + fields[i].size > src_stride)
+            return -1;
+
+    memset(plan, 0, sizeof(*plan));
+    plan->src_stride = src_stride;
+    plan->nfields = nfields;
+
+    /* First-fit decreasing: big fields first, each into the first stream it fits */
+    for(i = 0; i < nfields; i++) {
+        for(j = i; j > 0 && fields[order[j - 1]].size < fields[i].size; j--)
+            order[j] = order[j - 1];
+        order[j] = i;
+    }
+
+    for(i = 0; i < nfields; i++) {
+        struct r600_stream_layout trial;
+
+        for(j = 0; j < plan->nstreams; j++) {
+            trial = plan->stream[j];
+            trial.field[trial.nfields++] = order[i];
+            layout_stream(&trial, fields);
+            if(trial.stride <= R600_MEGA_FETCH_MAX)
+                break;
+        }
+
+        if(j == plan->nstreams) {
+            if(plan->nstreams == R600_RELAYOUT_MAX_STREAMS)
+                return -1;
+            memset(&trial, 0, sizeof(trial));
+            trial.field[trial.nfields++] = order[i];
+            layout_stream(&trial, fields);
+            plan->nstreams++;
+        }
+
+        plan->stream[j] = trial;
+    }
+
+    for(i = 0; i < plan->nstreams; i++) {
+        make_runs(&plan->stream[i], fields);
+        plan->fetch_bytes += plan->stream[i].stride;
+    }
+
+    plan->src_fetch_bytes = aos_fetch_bytes(fields, nfields);
+
+    return 0;
+}
+
+struct relayout_job {
+    const struct r600_relayout *plan;
+    void *const *dst;
+    const unsigned char *src;
+    size_t first, count;
+};
+
+static void relayout_range(const struct relayout_job *job)
+{
+    const struct r600_relayout *plan = job->plan;
+    unsigned s, r;
+    size_t i;
+
+    for(s = 0; s < plan->nstreams; s++) {
+        const struct r600_stream_layout *st = &plan->stream[s];
+        unsigned char *out = (unsigned char *) job->dst[s] + job->first * st->stride;
+        const unsigned char *in = job->src + job->first * plan->src_stride;
+
+        /* Padding bytes are zeroed so output is deterministic */
+        for(i = 0; i < job->count; i++) {
+            if(st->nruns != 1 || st->run_size[0] != st->stride)
+                memset(out, 0, st->stride);
+            for(r = 0; r < st->nruns; r++)
+                memcpy(out + st->run_dst[r], in + st->run_src[r], st->run_size[r]);
+            out += st->stride;
+            in += plan->src_stride;
+        }
+    }
+}
+
+static void *relayout_thread(void *arg)
+{
+    relayout_range(arg);
+    return NULL;
+}
+
+int r600_relayout_run(const struct r600_relayout *plan,
+                      void *const *dst, const void *src, size_t count,
+                      unsigned nthreads)
+{
+    struct relayout_job job[64];
+    pthread_t tid[64];
+    size_t per, bytes = count * (size_t) plan->fetch_bytes;
+    unsigned i, started;
+    int rval = 0;
+
+    if(nthreads == 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = n > 0 ? (unsigned) n : 1;
+    }
+    if(nthreads > 64)
+        nthreads = 64;
+    if(nthreads > bytes / MIN_BYTES_PER_THREAD)
+        nthreads = bytes / MIN_BYTES_PER_THREAD;
+    if(nthreads < 1)
+        nthreads = 1;
+
+    per = (count + nthreads - 1) / nthreads;
+
+    for(i = 0; i < nthreads; i++) {
+        job[i].plan = plan;
+        job[i].dst = dst;
+        job[i].src = src;
+        job[i].first = i * per < count ? i * per : count;
+        job[i].count = job[i].first + per <= count ? per : count - job[i].first;
+    }
+
+    /* The calling thread takes the first slice itself */
+    for(started = 1; started < nthreads; started++)
+        if(pthread_create(&tid[started], NULL, relayout_thread, &job[started]) != 0)
+            break;
+
+    relayout_range(&job[0]);
+
+    /* If we ran out of threads, finish the leftover slices here */
+    for(i = started; i < nthreads; i++)
+        relayout_range(&job[i]);
+
+    for(i = 1; i < started; i++)
+        if(pthread_join(tid[i], NULL) != 0)
+            rval = -1;
+
+    return rval;
+}
+
+void r600_relayout_print(const struct r600_relayout *plan, FILE *f)
+{
+    unsigned s, i;
+
+    fprintf(f, "relayout: %u fields from %u-byte records into %u stream(s)\n",
+            plan->nfields, plan->src_stride, plan->nstreams);
+
+    for(s = 0; s < plan->nstreams; s++) {
+        const struct r600_stream_layout *st = &plan->stream[s];
+
+        fprintf(f, "  stream %u: stride %u, fields", s, st->stride);
+        for(i = 0; i < st->nfields; i++)
+            fprintf(f, " %u@%u", st->field[i], st->dst_offset[i]);
+        fputc('\n', f);
+    }
+
+    fprintf(f, "  bytes fetched per element: %u (was %u, record %u)\n",
+            plan->fetch_bytes, plan->src_fetch_bytes, plan->src_stride);
+}
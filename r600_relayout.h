@@ -0,0 +1,95 @@
+/**
+ * r600_relayout.h: record relayout for mega-fetch
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_RELAYOUT_H_
+#define _R600_RELAYOUT_H_
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * A mega-fetch (VTX_DWORD2 MEGA_FETCH set) pulls up to MEGA_FETCH_COUNT
+ * bytes of one element into the fetch cache, and the mini-fetches after it
+ * pick fields out of that chunk for free.  Records with padding or unused
+ * fields make every element cost more than it needs to, so we repack the
+ * fields the kernel actually reads into as few dense interleaved streams
+ * as possible, none wider than one mega-fetch.
+ */
+
+#define R600_MEGA_FETCH_MAX         64   /* MEGA_FETCH_COUNT is 6 bits, minus one */
+#define R600_RELAYOUT_MAX_FIELDS    32
+#define R600_RELAYOUT_MAX_STREAMS   16
+
+/* A field of the source record that the kernel reads */
+struct r600_field {
+    unsigned offset;    /* bytes from the start of the record */
+    unsigned size;      /* bytes; at most R600_MEGA_FETCH_MAX */
+};
+
+/* One output vertex buffer */
+struct r600_stream_layout {
+    unsigned stride;    /* bytes per element, a multiple of 4 */
+    unsigned nfields;
+    unsigned field[R600_RELAYOUT_MAX_FIELDS];      /* index into the field array */
+    unsigned dst_offset[R600_RELAYOUT_MAX_FIELDS]; /* VTX_DWORD2 OFFSET of that field */
+
+    /* Contiguous copy runs, merged from adjacent fields */
+    unsigned nruns;
+    unsigned run_src[R600_RELAYOUT_MAX_FIELDS];
+    unsigned run_dst[R600_RELAYOUT_MAX_FIELDS];
+    unsigned run_size[R600_RELAYOUT_MAX_FIELDS];
+};
+
+struct r600_relayout {
+    unsigned src_stride;
+    unsigned nfields;
+    unsigned nstreams;
+    struct r600_stream_layout stream[R600_RELAYOUT_MAX_STREAMS];
+
+    /* Bytes the fetcher reads per element, before and after relayout */
+    unsigned src_fetch_bytes;
+    unsigned fetch_bytes;
+};
+
+/*
+ * Works out the stream split for the given fields.  Returns 0 on success,
+ * -1 if a field is too large or does not lie inside the record.
+ */
+int r600_relayout_plan(const struct r600_field *fields, unsigned nfields,
+                       unsigned src_stride, struct r600_relayout *plan);
+
+/*
+ * Copies count records from src into the streams, dst[i] receiving
+ * count * plan->stream[i].stride bytes.  The work is split across nthreads
+ * threads (0 means one per online CPU).  Returns 0 on success.
+ */
+int r600_relayout_run(const struct r600_relayout *plan,
+                      void *const *dst, const void *src, size_t count,
+                      unsigned nthreads);
+
+/* Human-readable summary of the plan, including bytes fetched per element */
+void r600_relayout_print(const struct r600_relayout *plan, FILE *f);
+
+#endif
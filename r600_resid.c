@@ -0,0 +1,99 @@
+/**
+ * r600_resid.c: buffers kept resident for a whole batch
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <radeon_bo.h>
+#include <radeon_cs.h>
+
+#include "r600_resid.h"
+
+struct r600_residency *r600_residency_create(void)
+{
+    return calloc(1, sizeof(struct r600_residency));
+}
+
+void r600_residency_destroy(struct r600_residency *res)
+{
+    if(res == NULL)
+        return;
+
+    r600_residency_clear(res);
+    free(res);
+}
+
+int r600_residency_add(struct r600_residency *res, struct radeon_bo *bo,
+                       uint32_t read_domains, uint32_t write_domain)
+{
+    struct r600_resident_bo *r;
+
+    for(r = res->bos; r < res->bos + res->nbos && r->bo != bo; r++)
+        ;
+
+    if(r == res->bos + res->nbos) {
+        if(res->nbos == R600_RESIDENT_MAX)
+            return -ENOSPC;
+        radeon_bo_ref(bo);
+        r->bo = bo;
+        r->read_domains = 0;
+        r->write_domain = 0;
+        res->nbos++;
+    }
+
+    r->read_domains |= read_domains;
+    r->write_domain |= write_domain;
+    res->cs = NULL;
+
+    return 0;
+}
+
+void r600_residency_clear(struct r600_residency *res)
+{
+    while(res->nbos > 0)
+        radeon_bo_unref(res->bos[--res->nbos].bo);
+    res->cs = NULL;
+}
+
+int r600_residency_declare(struct r600_residency *res, struct radeon_cs *cs)
+{
+    struct r600_resident_bo *r;
+
+    radeon_cs_space_reset_bos(cs);
+    res->cs = NULL;
+
+    for(r = res->bos; r < res->bos + res->nbos; r++)
+        radeon_cs_space_add_persistent_bo(cs, r->bo, r->read_domains, r->write_domain);
+
+    if(res->nbos > 0 && radeon_cs_space_check(cs) == RADEON_CS_SPACE_OP_TO_BIG) {
+        radeon_cs_space_reset_bos(cs);
+        return -E2BIG;
+    }
+
+    res->cs = cs;
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+/**
+ * r600_resid.h: buffers kept resident for a whole batch
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_RESID_H_
+#define _R600_RESID_H_
+
+#include <stdint.h>
+
+#include <radeon_bo.h>
+#include <radeon_cs.h>
+
+/*
+ * The buffers nearly every dispatch uses (constant pools, lookup tables,
+ * the fence page) can be declared resident once for a batch instead of
+ * being space-checked with each segment.  Declaring the set hands it to
+ * libdrm with radeon_cs_space_add_persistent_bo(), which then counts it
+ * in every space check on that CS; a cmdbuf whose cb->resident is the
+ * set skips the check of its own for any BO the set covers.
+ *
+ * The kernel still needs a relocation wherever a packet names a BO, so
+ * the set saves space checks, not relocations; those already cost one
+ * kernel entry per BO (see r600_cmdbuf.h).
+ */
+
+/* libdrm keeps no more persistent BOs than this per CS */
+#define R600_RESIDENT_MAX   31
+
+struct r600_resident_bo {
+    struct radeon_bo *bo;
+    uint32_t read_domains, write_domain;
+};
+
+struct r600_residency {
+    struct r600_resident_bo bos[R600_RESIDENT_MAX];
+    unsigned nbos;
+    struct radeon_cs *cs;       /* what it is declared on, or NULL */
+};
+
+struct r600_residency *r600_residency_create(void);
+void r600_residency_destroy(struct r600_residency *res);
+
+/*
+ * Adds bo, or widens the domains it is already in the set with.  The set
+ * holds a reference.  Any change undeclares it until the next
+ * r600_residency_declare().  Returns 0 or -ENOSPC.
+ */
+int r600_residency_add(struct r600_residency *res, struct radeon_bo *bo,
+                       uint32_t read_domains, uint32_t write_domain);
+
+/* Empties the set, which also undeclares it */
+void r600_residency_clear(struct r600_residency *res);
+
+/*
+ * Makes the set cs's persistent BOs, replacing any it had, and checks
+ * that they fit.  Returns 0, or -E2BIG if the set alone is too big.
+ */
+int r600_residency_declare(struct r600_residency *res, struct radeon_cs *cs);
+
+/* Nonzero if the set has bo with at least these domains */
+static inline int r600_residency_covers(const struct r600_residency *res,
+                                        const struct radeon_bo *bo,
+                                        uint32_t read_domains, uint32_t write_domain)
+{
+    const struct r600_resident_bo *r;
+
+    for(r = res->bos; r < res->bos + res->nbos; r++) {
+        if(r->bo == bo)
+            return (read_domains & ~r->read_domains) == 0 &&
+                   (write_domain & ~r->write_domain) == 0;
+    }
+
+    return 0;
+}
+
+#endif
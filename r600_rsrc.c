@@ -0,0 +1,187 @@
+/**
+ * r600_rsrc.c: resource descriptors and the slots they occupy
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <radeon_bo.h>
+
+#include "r600_reg.h"
+#include "r600_cmdbuf.h"
+#include "r600_rsrc.h"
+
+void r600_view_buffer(struct r600_view *v, struct radeon_bo *bo, uint32_t domains,
+                      uint32_t offset, uint32_t size, unsigned stride,
+                      unsigned format, unsigned num_format)
+{
+    memset(v, 0, sizeof(*v));
+    v->kind = R600_VIEW_BUFFER;
+    v->bo = bo;
+    v->domains = domains;
+
+    v->words[0] = offset;
+    v->words[1] = size - 1;
+    v->words[2] = (stride << SQ_VTX_CONSTANT_WORD2_0__STRIDE_shift &
+                   SQ_VTX_CONSTANT_WORD2_0__STRIDE_mask) |
+                  (format << SQ_VTX_CONSTANT_WORD2_0__DATA_FORMAT_shift &
+                   SQ_VTX_CONSTANT_WORD2_0__DATA_FORMAT_mask) |
+                  (num_format << SQ_VTX_CONSTANT_WORD2_0__NUM_FORMAT_ALL_shift &
+                   SQ_VTX_CONSTANT_WORD2_0__NUM_FORMAT_ALL_mask);
+    v->words[6] = SQ_TEX_VTX_VALID_BUFFER << SQ_VTX_CONSTANT_WORD6_0__TYPE_shift;
+}
+
+void r600_view_texture(struct r600_view *v, const uint32_t words[R600_RESOURCE_DWORDS],
+                       struct radeon_bo *bo, struct radeon_bo *mip_bo, uint32_t domains)
+{
+    memset(v, 0, sizeof(*v));
+    v->kind = R600_VIEW_TEXTURE;
+    memcpy(v->words, words, sizeof(v->words));
+    v->bo = bo;
+    v->mip_bo = mip_bo;
+    v->domains = domains;
+}
+
+struct r600_rslots *r600_rslots_create(unsigned first, unsigned n)
+{
+    struct r600_rslots *rs;
+
+    if(n == 0 || (rs = calloc(1, sizeof(*rs) + n * sizeof(rs->slots[0]))) == NULL)
+        return NULL;
+
+    rs->first = first;
+    rs->n = n;
+    rs->dispatch = 1;
+
+    return rs;
+}
+
+void r600_rslots_destroy(struct r600_rslots *rs)
+{
+    free(rs);
+}
+
+void r600_rslots_invalidate(struct r600_rslots *rs)
+{
+    unsigned i;
+
+    for(i = 0; i < rs->n; i++)
+        rs->slots[i].view = NULL;
+    rs->cb = NULL;
+}
+
+/* The slot holds v as it is now, not an older descriptor */
+static int holds(const struct r600_rslot *s, const struct r600_view *v)
+{
+    return s->view == v && s->bo == v->bo && s->mip_bo == v->mip_bo &&
+           memcmp(s->words, v->words, sizeof(s->words)) == 0;
+}
+
+static int find(const struct r600_rslots *rs, const struct r600_view *v)
+{
+    unsigned i;
+
+    if(v->slot < rs->n && rs->slots[v->slot].view == v)
+        return v->slot;
+    for(i = 0; i < rs->n; i++) {
+        if(rs->slots[i].view == v)
+            return i;
+    }
+
+    return -1;
+}
+
+/* A free slot, else the least recently used one not in this dispatch */
+static int victim(const struct r600_rslots *rs)
+{
+    unsigned i;
+    int best = -1;
+
+    for(i = 0; i < rs->n; i++) {
+        if(rs->slots[i].view == NULL)
+            return i;
+        if(rs->slots[i].last != rs->dispatch &&
+           (best < 0 || rs->slots[i].last < rs->slots[best].last))
+            best = i;
+    }
+
+    return best;
+}
+
+int r600_rslots_bind(struct r600_rslots *rs, struct r600_view *v, struct r600_cmdbuf *cb)
+{
+    struct r600_rslot *s;
+    int i, ret;
+
+    if(rs->cb != cb || rs->segment != cb->segment) {
+        r600_rslots_invalidate(rs);
+        rs->cb = cb;
+        rs->segment = cb->segment;
+    }
+
+    rs->stats.binds++;
+    if((i = find(rs, v)) >= 0 && holds(&rs->slots[i], v)) {
+        rs->slots[i].last = rs->dispatch;
+        v->slot = i;
+        rs->stats.resident++;
+        return i;
+    }
+
+    /* A stale copy of v is replaced where it is */
+    if(i < 0 && (i = victim(rs)) < 0)
+        return -ENOSPC;
+    s = &rs->slots[i];
+
+    if(v->kind == R600_VIEW_TEXTURE)
+        ret = r600_emit_set_tex_resource(cb, rs->first + i, v->words, v->bo, v->mip_bo, v->domains);
+    else
+        ret = r600_emit_set_vtx_resource(cb, rs->first + i, v->words, v->bo, v->domains);
+    if(ret != 0) {
+        s->view = NULL;
+        return ret;
+    }
+
+    /* Emitting may have split the buffer, leaving only this slot in the segment */
+    if(rs->segment != cb->segment) {
+        r600_rslots_invalidate(rs);
+        rs->cb = cb;
+        rs->segment = cb->segment;
+    }
+
+    if(s->view != NULL && s->view != v)
+        rs->stats.evictions++;
+    s->view = v;
+    memcpy(s->words, v->words, sizeof(s->words));
+    s->bo = v->bo;
+    s->mip_bo = v->mip_bo;
+    s->last = rs->dispatch;
+    v->slot = i;
+
+    rs->stats.loads++;
+    rs->stats.dwords += v->kind == R600_VIEW_TEXTURE ? R600_SET_TEX_RESOURCE_DW : R600_SET_VTX_RESOURCE_DW;
+
+    return i;
+}
@@ -0,0 +1,120 @@
+/**
+ * r600_rsrc.h: resource descriptors and the slots they occupy
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_RSRC_H_
+#define _R600_RSRC_H_
+
+#include <stdint.h>
+
+#include <radeon_bo.h>
+
+#include "r600_cmdbuf.h"
+
+/*
+ * A view is a buffer or texture as a kernel fetches it: the descriptor
+ * words for IT_SET_RESOURCE, worked out once, and the BOs they point at.
+ *
+ * A slot manager owns a range of the resource array, e.g. the VS fetch
+ * resources, and remembers which view each slot holds in the current
+ * segment of the command buffer.  Binding a view that is already in a
+ * slot costs nothing; otherwise it goes into a free slot or replaces the
+ * least recently used one.  Slots bound since r600_rslots_begin() are
+ * never replaced, so all the views of one dispatch stay put.  The kernel
+ * has to fetch from the slots it is given back.
+ *
+ * Descriptors carry relocations, so a dispatch's binds and the dispatch
+ * itself have to land in one segment (r600_cmdbuf_reserve() ahead).
+ */
+
+enum r600_view_kind {
+    R600_VIEW_BUFFER,
+    R600_VIEW_TEXTURE
+};
+
+struct r600_view {
+    unsigned kind;
+    uint32_t words[R600_RESOURCE_DWORDS];
+    struct radeon_bo *bo, *mip_bo;
+    uint32_t domains;
+    unsigned slot;          /* hint: where it was last bound */
+};
+
+/* Elements of stride bytes and SQ_VTX_CONSTANT_WORD2_0 format/num_format */
+void r600_view_buffer(struct r600_view *v, struct radeon_bo *bo, uint32_t domains,
+                      uint32_t offset, uint32_t size, unsigned stride,
+                      unsigned format, unsigned num_format);
+
+/* A texture with descriptor words made by the caller; mip_bo may be NULL */
+void r600_view_texture(struct r600_view *v, const uint32_t words[R600_RESOURCE_DWORDS],
+                       struct radeon_bo *bo, struct radeon_bo *mip_bo, uint32_t domains);
+
+struct r600_rslot {
+    const struct r600_view *view;       /* NULL if free */
+    uint32_t words[R600_RESOURCE_DWORDS];
+    struct radeon_bo *bo, *mip_bo;
+    unsigned last;                      /* dispatch it was last bound in */
+};
+
+struct r600_rslots_stats {
+    uint64_t binds;
+    uint64_t resident;      /* binds that needed no packet */
+    uint64_t loads;
+    uint64_t evictions;     /* loads replacing another view */
+    uint64_t dwords;
+};
+
+struct r600_rslots {
+    unsigned first, n;
+    unsigned dispatch;
+
+    /* Slots are only good for one segment of one cmdbuf */
+    const struct r600_cmdbuf *cb;
+    unsigned segment;
+
+    struct r600_rslots_stats stats;
+    struct r600_rslot slots[];
+};
+
+/* Resources first to first + n - 1; NULL on failure */
+struct r600_rslots *r600_rslots_create(unsigned first, unsigned n);
+void r600_rslots_destroy(struct r600_rslots *rs);
+
+/* Starts binding for the next dispatch */
+static inline void r600_rslots_begin(struct r600_rslots *rs)
+{
+    rs->dispatch++;
+}
+
+/* Forgets what the slots hold */
+void r600_rslots_invalidate(struct r600_rslots *rs);
+
+/*
+ * Makes v available to the next dispatch, emitting its descriptor into cb
+ * if it isn't there already.  Returns the slot, counted from first, or
+ * -ENOSPC if every slot is taken by this dispatch, or -ENOMEM.
+ */
+int r600_rslots_bind(struct r600_rslots *rs, struct r600_view *v, struct r600_cmdbuf *cb);
+
+#endif
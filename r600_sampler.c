@@ -0,0 +1,231 @@
+/**
+ * r600_sampler.c: shared sampler states and their hardware slots
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "r600_reg.h"
+#include "r600_cmdbuf.h"
+#include "r600_sampler.h"
+
+/* TD_PS_, TD_VS_ and TD_GS_SAMPLER0_BORDER_RED are this far apart */
+#define BORDER_STAGE_STRIDE     0x200
+
+static int register_border(const uint32_t words[R600_SAMPLER_DWORDS])
+{
+    return (words[0] & BORDER_COLOR_TYPE_mask) ==
+           SQ_TEX_BORDER_COLOR_REGISTER << BORDER_COLOR_TYPE_shift;
+}
+
+static uint64_t hash_sampler(const uint32_t *w, unsigned n)
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    unsigned i;
+
+    for(i = 0; i < n; i++)
+        h = (h ^ w[i]) * 0x100000001b3ull;
+
+    return h ^ h >> 29;
+}
+
+struct r600_samplers *r600_samplers_create(void)
+{
+    struct r600_samplers *ss;
+
+    if((ss = calloc(1, sizeof(*ss))) == NULL)
+        return NULL;
+    if((ss->hash = calloc(64, sizeof(*ss->hash))) == NULL) {
+        free(ss);
+        return NULL;
+    }
+
+    ss->hash_mask = 63;
+    ss->dispatch = 1;
+
+    return ss;
+}
+
+void r600_samplers_destroy(struct r600_samplers *ss)
+{
+    struct r600_sampler *smp, *next;
+    unsigned i;
+
+    if(ss == NULL)
+        return;
+
+    for(i = 0; i <= ss->hash_mask; i++) {
+        for(smp = ss->hash[i]; smp != NULL; smp = next) {
+            next = smp->next;
+            free(smp);
+        }
+    }
+    free(ss->hash);
+    free(ss);
+}
+
+/* Twice the buckets; on failure the table just stays more crowded */
+static void grow(struct r600_samplers *ss)
+{
+    unsigned n = 2 * (ss->hash_mask + 1), i;
+    struct r600_sampler **hash, *smp, *next;
+
+    if((hash = calloc(n, sizeof(*hash))) == NULL)
+        return;
+
+    for(i = 0; i <= ss->hash_mask; i++) {
+        for(smp = ss->hash[i]; smp != NULL; smp = next) {
+            next = smp->next;
+            smp->next = hash[smp->hash & (n - 1)];
+            hash[smp->hash & (n - 1)] = smp;
+        }
+    }
+
+    free(ss->hash);
+    ss->hash = hash;
+    ss->hash_mask = n - 1;
+}
+
+const struct r600_sampler *r600_sampler_get(struct r600_samplers *ss,
+                                            const uint32_t words[R600_SAMPLER_DWORDS],
+                                            const uint32_t border[4])
+{
+    uint32_t key[R600_SAMPLER_DWORDS + 4];
+    struct r600_sampler *smp;
+    uint64_t hash;
+
+    /* The border color only counts if the sampler reads it */
+    memset(key, 0, sizeof(key));
+    memcpy(key, words, R600_SAMPLER_DWORDS * sizeof(*key));
+    if(border != NULL && register_border(words))
+        memcpy(key + R600_SAMPLER_DWORDS, border, 4 * sizeof(*key));
+    hash = hash_sampler(key, R600_SAMPLER_DWORDS + 4);
+
+    ss->stats.lookups++;
+    for(smp = ss->hash[hash & ss->hash_mask]; smp != NULL; smp = smp->next) {
+        if(smp->hash == hash && memcmp(smp->words, key, sizeof(smp->words)) == 0 &&
+           memcmp(smp->border, key + R600_SAMPLER_DWORDS, sizeof(smp->border)) == 0)
+            return smp;
+    }
+
+    if((smp = malloc(sizeof(*smp))) == NULL)
+        return NULL;
+    memcpy(smp->words, key, sizeof(smp->words));
+    memcpy(smp->border, key + R600_SAMPLER_DWORDS, sizeof(smp->border));
+    smp->hash = hash;
+
+    if(ss->count >= ss->hash_mask + 1)
+        grow(ss);
+    smp->next = ss->hash[hash & ss->hash_mask];
+    ss->hash[hash & ss->hash_mask] = smp;
+    ss->count++;
+    ss->stats.created++;
+
+    return smp;
+}
+
+void r600_samplers_invalidate(struct r600_samplers *ss)
+{
+    memset(ss->slots, 0, sizeof(ss->slots));
+    ss->cb = NULL;
+}
+
+/* A free slot, else the least recently used one not in this dispatch */
+static int victim(const struct r600_sampler_slot *slots, unsigned dispatch)
+{
+    unsigned i;
+    int best = -1;
+
+    for(i = 0; i < R600_SAMPLER_SLOTS; i++) {
+        if(slots[i].smp == NULL)
+            return i;
+        if(slots[i].last != dispatch && (best < 0 || slots[i].last < slots[best].last))
+            best = i;
+    }
+
+    return best;
+}
+
+int r600_samplers_bind(struct r600_samplers *ss, unsigned stage,
+                       const struct r600_sampler *smp, struct r600_cmdbuf *cb)
+{
+    struct r600_sampler_slot *slots;
+    int border, i, ret;
+    unsigned ndw;
+
+    if(stage >= R600_CONST_NSTAGES)
+        return -EINVAL;
+
+    if(ss->cb != cb || ss->segment != cb->segment) {
+        r600_samplers_invalidate(ss);
+        ss->cb = cb;
+        ss->segment = cb->segment;
+    }
+
+    ss->stats.binds++;
+    slots = ss->slots[stage];
+    for(i = 0; i < R600_SAMPLER_SLOTS; i++) {
+        if(slots[i].smp == smp) {
+            slots[i].last = ss->dispatch;
+            ss->stats.resident++;
+            return i;
+        }
+    }
+
+    if((i = victim(slots, ss->dispatch)) < 0)
+        return -ENOSPC;
+
+    /* Sampler and border color go into one segment */
+    border = register_border(smp->words);
+    ndw = R600_SET_SAMPLER_DW + (border ? R600_SET_REGS_DW(4) : 0);
+    if((ret = r600_cmdbuf_reserve(cb, ndw, 0)) != 0)
+        return ret;
+    if(ss->segment != cb->segment) {
+        r600_samplers_invalidate(ss);
+        ss->cb = cb;
+        ss->segment = cb->segment;
+    }
+
+    if((ret = r600_emit_set_sampler(cb, R600_SAMPLER_SLOTS * stage + i, smp->words)) != 0 ||
+       (border && (ret = r600_emit_set_config_regs(cb, TD_PS_SAMPLER0_BORDER_RED +
+                                                   BORDER_STAGE_STRIDE * stage +
+                                                   TD_PS_SAMPLER0_BORDER_RED_offset * i,
+                                                   4, smp->border)) != 0)) {
+        slots[i].smp = NULL;
+        return ret;
+    }
+
+    if(slots[i].smp != NULL)
+        ss->stats.evictions++;
+    slots[i].smp = smp;
+    slots[i].last = ss->dispatch;
+
+    ss->stats.loads++;
+    ss->stats.borders += border;
+    ss->stats.dwords += ndw;
+
+    return i;
+}
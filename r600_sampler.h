@@ -0,0 +1,114 @@
+/**
+ * r600_sampler.h: shared sampler states and their hardware slots
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_SAMPLER_H_
+#define _R600_SAMPLER_H_
+
+#include <stdint.h>
+
+#include "r600_cmdbuf.h"
+#include "r600_const.h"
+
+/*
+ * Sampler states are immutable objects, one per distinct content: asking
+ * for the same SQ_TEX_SAMPLER_WORD0-2 (and border color, if word 0 says
+ * SQ_TEX_BORDER_COLOR_REGISTER) again returns the same object.  They are
+ * owned by the cache and live until it is destroyed.
+ *
+ * Each stage has 18 sampler slots.  Binding a sampler the stage already
+ * holds in the current segment of the command buffer costs nothing, so
+ * switching among a few configurations only pays the first time each is
+ * used; otherwise it goes into a free slot or replaces the least recently
+ * used one, with IT_SET_SAMPLER and, for a register border color, the
+ * slot's TD_*_SAMPLER*_BORDER_* registers.  Slots bound since
+ * r600_samplers_begin() are never replaced.  The kernel has to sample
+ * with the slot it is given back; a dispatch's binds and the dispatch
+ * itself have to land in one segment.
+ */
+
+#define R600_SAMPLER_SLOTS  18
+
+struct r600_sampler {
+    uint32_t words[R600_SAMPLER_DWORDS];
+    uint32_t border[4];     /* RGBA, zero unless a register border color */
+    uint64_t hash;
+    struct r600_sampler *next;
+};
+
+struct r600_sampler_slot {
+    const struct r600_sampler *smp;     /* NULL if free */
+    unsigned last;                      /* dispatch it was last bound in */
+};
+
+struct r600_samplers_stats {
+    uint64_t lookups, created;
+    uint64_t binds;
+    uint64_t resident;      /* binds that needed no packet */
+    uint64_t loads, borders;
+    uint64_t evictions;     /* loads replacing another sampler */
+    uint64_t dwords;
+};
+
+struct r600_samplers {
+    struct r600_sampler **hash;     /* chained */
+    unsigned hash_mask, count;
+
+    unsigned dispatch;
+
+    /* Slots are only good for one segment of one cmdbuf */
+    const struct r600_cmdbuf *cb;
+    unsigned segment;
+    struct r600_sampler_slot slots[R600_CONST_NSTAGES][R600_SAMPLER_SLOTS];
+
+    struct r600_samplers_stats stats;
+};
+
+/* NULL on failure */
+struct r600_samplers *r600_samplers_create(void);
+void r600_samplers_destroy(struct r600_samplers *ss);
+
+/* The sampler with these contents; border may be NULL.  NULL on failure */
+const struct r600_sampler *r600_sampler_get(struct r600_samplers *ss,
+                                            const uint32_t words[R600_SAMPLER_DWORDS],
+                                            const uint32_t border[4]);
+
+/* Starts binding for the next dispatch */
+static inline void r600_samplers_begin(struct r600_samplers *ss)
+{
+    ss->dispatch++;
+}
+
+/* Forgets what the slots hold */
+void r600_samplers_invalidate(struct r600_samplers *ss);
+
+/*
+ * Makes smp available to the next dispatch in stage, emitting it into cb
+ * if it isn't there already.  Returns the slot, -EINVAL, -ENOSPC if every
+ * slot is taken by this dispatch, or -ENOMEM.
+ */
+int r600_samplers_bind(struct r600_samplers *ss, unsigned stage,
+                       const struct r600_sampler *smp, struct r600_cmdbuf *cb);
+
+#endif
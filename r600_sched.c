@@ -0,0 +1,80 @@
+/**
+ * r600_sched.c: choosing between CPU and GPU waits for dependencies
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "r600_fence.h"
+#include "r600_stream.h"
+#include "r600_sched.h"
+
+struct r600_sched *r600_sched_create(void)
+{
+    struct r600_sched *sc;
+
+    if((sc = calloc(1, sizeof(*sc))) == NULL)
+        return NULL;
+
+    sc->max_stall_ns = 10 * R600_SCHED_ROUND_TRIP_NS;
+    sc->timeout_ns = UINT64_MAX;
+
+    return sc;
+}
+
+void r600_sched_destroy(struct r600_sched *sc)
+{
+    free(sc);
+}
+
+int r600_sched_depend(struct r600_sched *sc, struct r600_stream *s,
+                      struct r600_timeline *tl, uint64_t value)
+{
+    int ret;
+
+    if(r600_timeline_reached(tl, value)) {
+        sc->stats.ready++;
+        return R600_DEP_READY;
+    }
+
+    /*
+     * Only a value already on its way to the ring is safe for the CP; one
+     * sitting in a cmdbuf nobody has submitted yet may end up behind s.
+     */
+    if(value <= tl->submitted && value <= UINT32_MAX &&
+       r600_timeline_eta(tl, value) <= sc->max_stall_ns) {
+        if((ret = r600_timeline_wait_gpu(tl, s->cb, value)) != 0)
+            return ret;
+        sc->stats.gpu++;
+        return R600_DEP_GPU;
+    }
+
+    if((ret = r600_stream_submit(s)) != 0 ||
+       (ret = r600_timeline_wait(tl, value, sc->timeout_ns)) != 0)
+        return ret;
+
+    sc->stats.cpu++;
+    return R600_DEP_CPU;
+}
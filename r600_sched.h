@@ -0,0 +1,83 @@
+/**
+ * r600_sched.h: choosing between CPU and GPU waits for dependencies
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_SCHED_H_
+#define _R600_SCHED_H_
+
+#include <stdint.h>
+
+#include "r600_fence.h"
+#include "r600_stream.h"
+
+/*
+ * When job B needs job A's results there are two ways to hold B back.
+ * Waiting on the CPU and then submitting B leaves the GPU idle from A's
+ * end until B arrives: a wake-up, an ioctl and the CP fetching the IB,
+ * on the order of 100us.  Queuing B at once behind an IT_WAIT_REG_MEM
+ * on A's fence saves all of that, but the CP sits in the wait and can't
+ * get to anything else meanwhile, and a long enough stall looks like a
+ * hang to the kernel.
+ *
+ * So short waits go to the GPU and long ones to the CPU.  Past
+ * max_stall_ns (ten round trips by default) the round trip is a small
+ * price next to the wait itself.
+ */
+
+#define R600_SCHED_ROUND_TRIP_NS    100000
+
+enum {
+    R600_DEP_READY,         /* already satisfied, nothing done */
+    R600_DEP_GPU,           /* IT_WAIT_REG_MEM recorded */
+    R600_DEP_CPU,           /* stream submitted, then waited for */
+};
+
+struct r600_sched_stats {
+    uint64_t ready;
+    uint64_t gpu;
+    uint64_t cpu;
+};
+
+struct r600_sched {
+    uint64_t max_stall_ns;  /* longest expected wait to stall the CP for */
+    uint64_t timeout_ns;    /* for CPU waits */
+    struct r600_sched_stats stats;
+};
+
+struct r600_sched *r600_sched_create(void);
+void r600_sched_destroy(struct r600_sched *sc);
+
+/*
+ * Makes whatever is recorded into s next wait for tl to reach value.
+ * A GPU wait is used when r600_timeline_eta() says it won't be long and
+ * the signal for value has already been submitted (or came from the
+ * host).  Otherwise what
+ * s holds so far is submitted, which also gets the signal out if it is
+ * in there, and the CPU waits.  Returns one of R600_DEP_* or a negative
+ * errno value (-ETIMEDOUT if the CPU wait gave up).
+ */
+int r600_sched_depend(struct r600_sched *sc, struct r600_stream *s,
+                      struct r600_timeline *tl, uint64_t value);
+
+#endif
@@ -0,0 +1,113 @@
+/**
+ * r600_shadow.c: CPU-side copy of the register state
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "r600_cmdbuf.h"
+#include "r600_shadow.h"
+
+#define WINDOW(name) {SET_##name##_offset, R600_SHADOW_##name, R600_SHADOW_WINDOW(name)}
+
+static const struct {
+    uint32_t offset;
+    unsigned base, n;
+} windows[] = {
+    WINDOW(CONFIG_REG),
+    WINDOW(CONTEXT_REG),
+    WINDOW(ALU_CONST),
+    WINDOW(RESOURCE),
+    WINDOW(SAMPLER),
+    WINDOW(CTL_CONST),
+    WINDOW(LOOP_CONST),
+    WINDOW(BOOL_CONST),
+};
+
+#undef WINDOW
+
+#define NWINDOWS (sizeof(windows) / sizeof(windows[0]))
+
+struct r600_shadow *r600_shadow_create(void)
+{
+    return calloc(1, sizeof(struct r600_shadow));
+}
+
+void r600_shadow_destroy(struct r600_shadow *s)
+{
+    free(s);
+}
+
+void r600_shadow_invalidate(struct r600_shadow *s)
+{
+    memset(s->valid, 0, sizeof(s->valid));
+    s->invalidations++;
+}
+
+void r600_shadow_invalidate_range(struct r600_shadow *s, uint32_t reg, unsigned n)
+{
+    int i;
+
+    for(; n > 0; n--, reg += 4) {
+        if((i = r600_shadow_index(reg)) >= 0)
+            s->valid[i >> 5] &= ~(1u << (i & 31));
+    }
+}
+
+static int valid(const struct r600_shadow *s, unsigned i)
+{
+    return (s->valid[i >> 5] >> (i & 31)) & 1;
+}
+
+int r600_shadow_emit(const struct r600_shadow *s, struct r600_cmdbuf *cb)
+{
+    unsigned w, i, j, end;
+    int ret;
+
+    for(w = 0; w < NWINDOWS; w++) {
+        end = windows[w].base + windows[w].n;
+
+        for(i = windows[w].base; i < end; i = j) {
+            /* Skip a whole invalid word at a time */
+            if(s->valid[i >> 5] == 0 && (i & 31) == 0) {
+                j = i + 32 < end ? i + 32 : end;
+                continue;
+            }
+            if(!valid(s, i)) {
+                j = i + 1;
+                continue;
+            }
+
+            for(j = i + 1; j < end && valid(s, j); j++)
+                ;
+            ret = r600_emit_set_regs(cb, windows[w].offset + 4 * (i - windows[w].base),
+                                     j - i, s->value + i);
+            if(ret != 0)
+                return ret;
+        }
+    }
+
+    return 0;
+}
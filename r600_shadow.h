@@ -0,0 +1,124 @@
+/**
+ * r600_shadow.h: CPU-side copy of the register state
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_SHADOW_H_
+#define _R600_SHADOW_H_
+
+#include <stdint.h>
+
+#include "r600_reg.h"
+#include "r600_cmdbuf.h"
+
+/*
+ * The last value written to every register in the SET_* windows, so that
+ * rewriting a register with what it already holds can be skipped.  An
+ * entry is only trusted while it is valid: everything is invalidated when
+ * the command stream is submitted (another client may run in between) and
+ * when the GPU context is lost, and anything that writes registers behind
+ * the shadow's back must invalidate what it touched.
+ */
+
+#define R600_SHADOW_WINDOW(name) ((SET_##name##_end - SET_##name##_offset) >> 2)
+
+enum {
+    R600_SHADOW_CONFIG_REG  = 0,
+    R600_SHADOW_CONTEXT_REG = R600_SHADOW_CONFIG_REG + R600_SHADOW_WINDOW(CONFIG_REG),
+    R600_SHADOW_ALU_CONST   = R600_SHADOW_CONTEXT_REG + R600_SHADOW_WINDOW(CONTEXT_REG),
+    R600_SHADOW_RESOURCE    = R600_SHADOW_ALU_CONST + R600_SHADOW_WINDOW(ALU_CONST),
+    R600_SHADOW_SAMPLER     = R600_SHADOW_RESOURCE + R600_SHADOW_WINDOW(RESOURCE),
+    R600_SHADOW_CTL_CONST   = R600_SHADOW_SAMPLER + R600_SHADOW_WINDOW(SAMPLER),
+    R600_SHADOW_LOOP_CONST  = R600_SHADOW_CTL_CONST + R600_SHADOW_WINDOW(CTL_CONST),
+    R600_SHADOW_BOOL_CONST  = R600_SHADOW_LOOP_CONST + R600_SHADOW_WINDOW(LOOP_CONST),
+    R600_SHADOW_SIZE        = R600_SHADOW_BOOL_CONST + R600_SHADOW_WINDOW(BOOL_CONST)
+};
+
+struct r600_shadow {
+    uint32_t value[R600_SHADOW_SIZE];
+    uint32_t valid[(R600_SHADOW_SIZE + 31) / 32];
+    unsigned invalidations;
+};
+
+struct r600_shadow *r600_shadow_create(void);
+void r600_shadow_destroy(struct r600_shadow *s);
+
+/* Forgets everything, e.g. after a submission or a GPU reset */
+void r600_shadow_invalidate(struct r600_shadow *s);
+
+/* Forgets n registers from reg on */
+void r600_shadow_invalidate_range(struct r600_shadow *s, uint32_t reg, unsigned n);
+
+/*
+ * Re-sends every valid register, coalesced into SET_* packets, e.g. to
+ * carry the state over into a new submission.  Returns 0 or -ENOMEM.
+ */
+int r600_shadow_emit(const struct r600_shadow *s, struct r600_cmdbuf *cb);
+
+/* Index of reg in the shadow, or -1 outside the SET_* windows */
+static inline int r600_shadow_index(uint32_t reg)
+{
+#define WINDOW(name)                                                         \
+    if(reg >= SET_##name##_offset && reg < SET_##name##_end)                 \
+        return R600_SHADOW_##name + ((reg - SET_##name##_offset) >> 2);
+    WINDOW(CONFIG_REG)
+    WINDOW(CONTEXT_REG)
+    WINDOW(ALU_CONST)
+    WINDOW(RESOURCE)
+    WINDOW(SAMPLER)
+    WINDOW(CTL_CONST)
+    WINDOW(LOOP_CONST)
+    WINDOW(BOOL_CONST)
+#undef WINDOW
+
+    return -1;
+}
+
+/* Nonzero if the register at index i is known to hold value already */
+static inline int r600_shadow_match_at(const struct r600_shadow *s, int i, uint32_t value)
+{
+    return (s->valid[i >> 5] & (1u << (i & 31))) && s->value[i] == value;
+}
+
+static inline void r600_shadow_update_at(struct r600_shadow *s, int i, uint32_t value)
+{
+    s->value[i] = value;
+    s->valid[i >> 5] |= 1u << (i & 31);
+}
+
+static inline int r600_shadow_match(const struct r600_shadow *s, uint32_t reg, uint32_t value)
+{
+    int i = r600_shadow_index(reg);
+
+    return i >= 0 && r600_shadow_match_at(s, i, value);
+}
+
+static inline void r600_shadow_update(struct r600_shadow *s, uint32_t reg, uint32_t value)
+{
+    int i = r600_shadow_index(reg);
+
+    if(i >= 0)
+        r600_shadow_update_at(s, i, value);
+}
+
+#endif
@@ -0,0 +1,737 @@
+/**
+ * r600_standin.c: a host-memory stand-in for the GPU behind libdrm_radeon
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <pthread.h>
+
+#include <radeon_bo.h>
+#include <radeon_bo_int.h>
+#include <radeon_cs.h>
+#include <radeon_cs_int.h>
+
+#include "r600_reg.h"
+#include "r600_cmdbuf.h"
+#include "r600_standin.h"
+
+/* Nested IT_INDIRECT_BUFFERs deeper than this are treated as malformed */
+#define MAX_IB_DEPTH    2
+
+/* How long an IT_WAIT_REG_MEM polls before we call it a hang and move on */
+#define WAIT_TIMEOUT_NS 1000000000ull
+
+struct sbo {
+    struct radeon_bo_int base;
+    struct sbo *next;       /* on the zombie list */
+    uint64_t busy;          /* sequence number of the last CS using it */
+};
+
+struct scs {
+    struct radeon_cs_int base;
+    struct sbo **relocs;
+    unsigned nrelocs, max_relocs;
+};
+
+struct job {
+    struct job *next;
+    uint64_t seq, start_ns;
+    uint32_t *buf;
+    unsigned ndw;
+    struct sbo **bos;
+    unsigned nbos;
+    uint64_t draws, writes;     /* added to the stats when it completes */
+    uint64_t skipped;
+};
+
+struct r600_standin {
+    struct radeon_bo_manager bom;
+    struct radeon_cs_manager csm;
+    struct r600_standin_config cfg;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work;    /* signalled when a CS is queued */
+    pthread_cond_t done;    /* signalled when a CS completes */
+
+    struct job *head, *tail;
+    uint64_t emitted, completed;
+    struct sbo *zombies;    /* unreferenced, but a CS still uses them */
+    int quit;
+
+    uint64_t last_write_ns;
+    struct r600_standin_stats stats;
+};
+
+#define SD_OF_BOM(m) ((struct r600_standin *) ((char *) (m) - offsetof(struct r600_standin, bom)))
+#define SD_OF_CSM(m) ((struct r600_standin *) ((char *) (m) - offsetof(struct r600_standin, csm)))
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t t)
+{
+    struct timespec ts;
+
+    ts.tv_sec = t / 1000000000ull;
+    ts.tv_nsec = t % 1000000000ull;
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+/*
+ * The BO side.  Memory is allocated once at open and stays mapped, so
+ * map and unmap have nothing to do.
+ */
+
+static void free_bo(struct sbo *bo)
+{
+    free(bo->base.ptr);
+    free(bo);
+}
+
+static struct radeon_bo *sbo_open(struct radeon_bo_manager *bom, uint32_t handle,
+                                  uint32_t size, uint32_t alignment,
+                                  uint32_t domains, uint32_t flags)
+{
+    struct sbo *bo;
+
+    /* There are no other processes to share a handle with */
+    if(handle != 0 || size == 0)
+        return NULL;
+
+    if((bo = calloc(1, sizeof(*bo))) == NULL)
+        return NULL;
+
+    if(alignment < 64)
+        alignment = 64;
+    if(posix_memalign(&bo->base.ptr, alignment, size) != 0) {
+        free(bo);
+        return NULL;
+    }
+    memset(bo->base.ptr, 0, size);
+
+    bo->base.flags = flags;
+    bo->base.size = size;
+    bo->base.alignment = alignment;
+    bo->base.domains = domains;
+    bo->base.cref = 1;
+    bo->base.bom = bom;
+
+    return (struct radeon_bo *) bo;
+}
+
+static void sbo_ref(struct radeon_bo_int *boi)
+{
+}
+
+static struct radeon_bo *sbo_unref(struct radeon_bo_int *boi)
+{
+    struct r600_standin *sd = SD_OF_BOM(boi->bom);
+    struct sbo *bo = (struct sbo *) boi;
+
+    if(boi->cref > 0)
+        return (struct radeon_bo *) boi;
+
+    /* Like the kernel, keep the memory until the GPU is done with it */
+    pthread_mutex_lock(&sd->lock);
+    if(bo->busy > sd->completed) {
+        bo->next = sd->zombies;
+        sd->zombies = bo;
+        bo = NULL;
+    }
+    pthread_mutex_unlock(&sd->lock);
+
+    if(bo != NULL)
+        free_bo(bo);
+
+    return NULL;
+}
+
+static int sbo_map(struct radeon_bo_int *boi, int write)
+{
+    return 0;
+}
+
+static int sbo_unmap(struct radeon_bo_int *boi)
+{
+    return 0;
+}
+
+static int sbo_wait(struct radeon_bo_int *boi)
+{
+    struct r600_standin *sd = SD_OF_BOM(boi->bom);
+    struct sbo *bo = (struct sbo *) boi;
+
+    pthread_mutex_lock(&sd->lock);
+    while(bo->busy > sd->completed)
+        pthread_cond_wait(&sd->done, &sd->lock);
+    pthread_mutex_unlock(&sd->lock);
+
+    return 0;
+}
+
+static int sbo_is_static(struct radeon_bo_int *boi)
+{
+    return 0;
+}
+
+static int sbo_set_tiling(struct radeon_bo_int *boi, uint32_t tiling_flags, uint32_t pitch)
+{
+    return 0;
+}
+
+static int sbo_get_tiling(struct radeon_bo_int *boi, uint32_t *tiling_flags, uint32_t *pitch)
+{
+    *tiling_flags = 0;
+    *pitch = 0;
+    return 0;
+}
+
+static int sbo_is_busy(struct radeon_bo_int *boi, uint32_t *domain)
+{
+    struct r600_standin *sd = SD_OF_BOM(boi->bom);
+    struct sbo *bo = (struct sbo *) boi;
+    int busy;
+
+    pthread_mutex_lock(&sd->lock);
+    busy = bo->busy > sd->completed;
+    pthread_mutex_unlock(&sd->lock);
+
+    if(domain != NULL)
+        *domain = boi->domains;
+
+    return busy ? -EBUSY : 0;
+}
+
+static int sbo_is_reloc(struct radeon_bo_int *boi)
+{
+    return 0;
+}
+
+static const struct radeon_bo_funcs bo_funcs = {
+    .bo_open = sbo_open,
+    .bo_ref = sbo_ref,
+    .bo_unref = sbo_unref,
+    .bo_map = sbo_map,
+    .bo_unmap = sbo_unmap,
+    .bo_wait = sbo_wait,
+    .bo_is_static = sbo_is_static,
+    .bo_set_tiling = sbo_set_tiling,
+    .bo_get_tiling = sbo_get_tiling,
+    .bo_is_busy = sbo_is_busy,
+    .bo_is_reloc = sbo_is_reloc,
+};
+
+/* The GPU side, run on the worker thread */
+
+/* The BO named by the relocation NOP at p[i], or NULL */
+static struct sbo *reloc(const struct job *j, const uint32_t *p, unsigned i, unsigned ndw)
+{
+    if(i + R600_RELOC_DW > ndw || p[i] != PACKET3(IT_NOP, 1) || p[i + 1] >= j->nbos)
+        return NULL;
+
+    return j->bos[p[i + 1]];
+}
+
+static void *addr(struct sbo *bo, uint32_t offset, uint32_t size)
+{
+    if(bo == NULL || offset > bo->base.size || size > bo->base.size - offset)
+        return NULL;
+
+    return (char *) bo->base.ptr + offset;
+}
+
+/* A 32- or 64-bit store that a CPU polling the location sees atomically */
+static int store(struct r600_standin *sd, struct job *j, struct sbo *bo,
+                 uint32_t offset, uint64_t value, int data32)
+{
+    void *dst = addr(bo, offset, data32 ? 4 : 8);
+    uint64_t t = now_ns();
+
+    if(dst == NULL || (offset & (data32 ? 3 : 7)) != 0)
+        return -1;
+
+    __atomic_store_n(&sd->last_write_ns, t, __ATOMIC_RELAXED);
+    if(data32)
+        __atomic_store_n((uint32_t *) dst, (uint32_t) value, __ATOMIC_RELEASE);
+    else
+        __atomic_store_n((uint64_t *) dst, value, __ATOMIC_RELEASE);
+    j->writes++;
+
+    return 0;
+}
+
+static int compare(unsigned func, uint32_t v, uint32_t ref)
+{
+    switch(func & 7) {
+    case IT_WAIT_ALWAYS: return 1;
+    case IT_WAIT_LT:     return v < ref;
+    case IT_WAIT_LE:     return v <= ref;
+    case IT_WAIT_EQ:     return v == ref;
+    case IT_WAIT_NE:     return v != ref;
+    case IT_WAIT_GE:     return v >= ref;
+    case IT_WAIT_GT:     return v > ref;
+    }
+
+    return 0;
+}
+
+static int wait_mem(struct sbo *bo, const uint32_t *p)
+{
+    uint32_t *src = addr(bo, p[2], 4);
+    uint64_t deadline = now_ns() + WAIT_TIMEOUT_NS;
+    struct timespec poll = {0, 1000};
+
+    if(src == NULL)
+        return -1;
+
+    while(!compare(p[1], __atomic_load_n(src, __ATOMIC_ACQUIRE) & p[5], p[4])) {
+        if(now_ns() > deadline)
+            return -1;
+        nanosleep(&poll, NULL);
+    }
+
+    return 0;
+}
+
+static int execute(struct r600_standin *sd, struct job *j,
+                   const uint32_t *p, unsigned ndw, unsigned depth)
+{
+    unsigned i, n;
+    struct sbo *bo, *src;
+    void *d, *s;
+
+    for(i = 0; i < ndw; i += n) {
+        if(PACKET_TYPE(p[i]) == 2) {
+            n = 1;
+            continue;
+        }
+        n = PACKET_NDW(p[i]);
+        if(PACKET_TYPE(p[i]) == 1 || i + n > ndw)
+            return -1;
+        if(PACKET_TYPE(p[i]) == 0)
+            continue;
+
+        switch(PACKET3_OP(p[i])) {
+        case IT_EVENT_WRITE_EOP:
+            bo = reloc(j, p, i + n, ndw);
+            switch((p[i + 3] >> 29) & 3) {
+            case 1:
+                if(store(sd, j, bo, p[i + 2], p[i + 4], 1) != 0)
+                    return -1;
+                break;
+            case 2:
+                if(store(sd, j, bo, p[i + 2], p[i + 4] | (uint64_t) p[i + 5] << 32, 0) != 0)
+                    return -1;
+                break;
+            }
+            break;
+
+        case IT_MEM_WRITE:
+            bo = reloc(j, p, i + n, ndw);
+            if(store(sd, j, bo, p[i + 1], p[i + 3] | (uint64_t) p[i + 4] << 32,
+                     (p[i + 2] & IT_MEM_WRITE_DATA32) != 0) != 0)
+                return -1;
+            break;
+
+        case IT_WAIT_REG_MEM:
+            if((p[i + 1] & IT_WAIT_MEM) && wait_mem(reloc(j, p, i + n, ndw), p + i) != 0)
+                return -1;
+            break;
+
+        case IT_CP_DMA:
+            src = reloc(j, p, i + n, ndw);
+            bo = reloc(j, p, i + n + R600_RELOC_DW, ndw);
+            if((s = addr(src, p[i + 1], p[i + 5] & IT_CP_DMA_MAX_BYTES)) == NULL ||
+               (d = addr(bo, p[i + 3], p[i + 5] & IT_CP_DMA_MAX_BYTES)) == NULL)
+                return -1;
+            memmove(d, s, p[i + 5] & IT_CP_DMA_MAX_BYTES);
+            break;
+
+        case IT_COND_EXEC:
+            bo = reloc(j, p, i + n, ndw);
+            if((s = addr(bo, p[i + 1], 4)) == NULL || p[i + 3] > ndw - i - n)
+                return -1;
+            if(__atomic_load_n((uint32_t *) s, __ATOMIC_ACQUIRE) == 0) {
+                n += p[i + 3];
+                j->skipped += p[i + 3];
+            }
+            break;
+
+        case IT_DRAW_INDEX_AUTO:
+            j->draws++;
+            if(sd->cfg.dispatch_us > 0)
+                sleep_until(now_ns() + sd->cfg.dispatch_us * 1000ull);
+            break;
+
+        case IT_INDIRECT_BUFFER:
+            bo = reloc(j, p, i + n, ndw);
+            if(depth >= MAX_IB_DEPTH || (s = addr(bo, p[i + 1], p[i + 3] * 4)) == NULL ||
+               execute(sd, j, s, p[i + 3], depth + 1) != 0)
+                return -1;
+            break;
+        }
+    }
+
+    return 0;
+}
+
+static void free_job(struct job *j)
+{
+    free(j->buf);
+    free(j->bos);
+    free(j);
+}
+
+static void *gpu_thread(void *arg)
+{
+    struct r600_standin *sd = arg;
+    struct sbo *bo, **pbo;
+    struct job *j;
+    int ret;
+
+    pthread_mutex_lock(&sd->lock);
+
+    for(;;) {
+        while(sd->head == NULL && !sd->quit)
+            pthread_cond_wait(&sd->work, &sd->lock);
+
+        if((j = sd->head) == NULL)
+            break;
+
+        if((sd->head = j->next) == NULL)
+            sd->tail = NULL;
+
+        pthread_mutex_unlock(&sd->lock);
+
+        if(sd->cfg.launch_us > 0)
+            sleep_until(j->start_ns + sd->cfg.launch_us * 1000ull);
+        ret = execute(sd, j, j->buf, j->ndw, 0);
+
+        pthread_mutex_lock(&sd->lock);
+        sd->stats.bad += ret != 0;
+        sd->stats.draws += j->draws;
+        sd->stats.writes += j->writes;
+        sd->stats.skipped += j->skipped;
+        sd->completed = j->seq;
+        for(pbo = &sd->zombies; (bo = *pbo) != NULL; ) {
+            if(bo->busy <= sd->completed) {
+                *pbo = bo->next;
+                free_bo(bo);
+            } else {
+                pbo = &bo->next;
+            }
+        }
+        pthread_cond_broadcast(&sd->done);
+        free_job(j);
+    }
+
+    pthread_mutex_unlock(&sd->lock);
+
+    return NULL;
+}
+
+/* The CS side, which mirrors what the GEM backend does before the ioctl */
+
+static struct radeon_cs_int *scs_create(struct radeon_cs_manager *csm, uint32_t ndw)
+{
+    struct scs *cs;
+
+    if((cs = calloc(1, sizeof(*cs))) == NULL)
+        return NULL;
+
+    if(ndw < 64)
+        ndw = 64;
+    if((cs->base.packets = calloc(ndw, sizeof(uint32_t))) == NULL) {
+        free(cs);
+        return NULL;
+    }
+    cs->base.ndw = ndw;
+    cs->base.csm = csm;
+
+    return &cs->base;
+}
+
+static int scs_write_reloc(struct radeon_cs_int *csi, struct radeon_bo *bo,
+                           uint32_t read_domain, uint32_t write_domain, uint32_t flags)
+{
+    struct scs *cs = (struct scs *) csi;
+    unsigned i, n;
+    void *p;
+
+    if((read_domain && write_domain) || (!read_domain && !write_domain))
+        return -EINVAL;
+
+    for(i = 0; i < cs->nrelocs && cs->relocs[i] != (struct sbo *) bo; i++)
+        ;
+
+    if(i == cs->nrelocs) {
+        if(cs->nrelocs == cs->max_relocs) {
+            n = cs->max_relocs ? cs->max_relocs * 2 : 32;
+            if((p = realloc(cs->relocs, n * sizeof(*cs->relocs))) == NULL)
+                return -ENOMEM;
+            cs->relocs = p;
+            cs->max_relocs = n;
+        }
+        radeon_bo_ref(bo);
+        cs->relocs[cs->nrelocs++] = (struct sbo *) bo;
+    }
+
+    radeon_cs_write_dword((struct radeon_cs *) csi, PACKET3(IT_NOP, 1));
+    radeon_cs_write_dword((struct radeon_cs *) csi, i);
+
+    return 0;
+}
+
+static int scs_begin(struct radeon_cs_int *csi, uint32_t ndw,
+                     const char *file, const char *func, int line)
+{
+    uint32_t *p;
+    unsigned n;
+
+    if(csi->section_ndw)
+        return -EPIPE;
+
+    if(csi->cdw + ndw > csi->ndw) {
+        n = (csi->cdw + ndw + 0x3ff) & ~0x3ff;
+        if((p = realloc(csi->packets, n * sizeof(uint32_t))) == NULL)
+            return -ENOMEM;
+        csi->packets = p;
+        csi->ndw = n;
+    }
+
+    csi->section_ndw = ndw;
+    csi->section_cdw = 0;
+    csi->section_file = file;
+    csi->section_func = func;
+    csi->section_line = line;
+
+    return 0;
+}
+
+static int scs_end(struct radeon_cs_int *csi, const char *file, const char *func, int line)
+{
+    int ret = csi->section_cdw == csi->section_ndw ? 0 : -EPIPE;
+
+    csi->section_ndw = 0;
+
+    return ret;
+}
+
+static int scs_erase(struct radeon_cs_int *csi)
+{
+    struct scs *cs = (struct scs *) csi;
+    unsigned i;
+
+    for(i = 0; i < cs->nrelocs; i++)
+        radeon_bo_unref((struct radeon_bo *) cs->relocs[i]);
+    cs->nrelocs = 0;
+    csi->cdw = 0;
+    csi->section_ndw = 0;
+
+    return 0;
+}
+
+static int scs_emit(struct radeon_cs_int *csi)
+{
+    struct r600_standin *sd = SD_OF_CSM(csi->csm);
+    struct scs *cs = (struct scs *) csi;
+    struct job *j;
+    unsigned i;
+
+    if(csi->cdw == 0)
+        return 0;
+
+    if((j = calloc(1, sizeof(*j))) == NULL ||
+       (j->buf = malloc(csi->cdw * sizeof(uint32_t))) == NULL ||
+       (cs->nrelocs > 0 && (j->bos = malloc(cs->nrelocs * sizeof(*j->bos))) == NULL)) {
+        if(j != NULL)
+            free_job(j);
+        return -ENOMEM;
+    }
+
+    memcpy(j->buf, csi->packets, csi->cdw * sizeof(uint32_t));
+    j->ndw = csi->cdw;
+    memcpy(j->bos, cs->relocs, cs->nrelocs * sizeof(*j->bos));
+    j->nbos = cs->nrelocs;
+    j->start_ns = now_ns();
+
+    pthread_mutex_lock(&sd->lock);
+    j->seq = ++sd->emitted;
+    for(i = 0; i < cs->nrelocs; i++) {
+        cs->relocs[i]->busy = j->seq;
+        cs->relocs[i]->base.space_accounted = 0;
+    }
+    sd->stats.submits++;
+    sd->stats.dwords += j->ndw;
+    if(sd->tail != NULL)
+        sd->tail->next = j;
+    else
+        sd->head = j;
+    sd->tail = j;
+    pthread_cond_signal(&sd->work);
+    pthread_mutex_unlock(&sd->lock);
+
+    csi->csm->read_used = 0;
+    csi->csm->vram_write_used = 0;
+    csi->csm->gart_write_used = 0;
+
+    return 0;
+}
+
+static int scs_destroy(struct radeon_cs_int *csi)
+{
+    struct scs *cs = (struct scs *) csi;
+
+    scs_erase(csi);
+    free(cs->relocs);
+    free(csi->packets);
+    free(cs);
+
+    return 0;
+}
+
+static int scs_need_flush(struct radeon_cs_int *csi)
+{
+    return csi->cdw > csi->ndw * 3 / 4;
+}
+
+static void scs_print(struct radeon_cs_int *csi, FILE *file)
+{
+    unsigned i;
+
+    for(i = 0; i < csi->cdw; i++)
+        fprintf(file, "0x%08x\n", csi->packets[i]);
+}
+
+static const struct radeon_cs_funcs cs_funcs = {
+    .cs_create = scs_create,
+    .cs_write_reloc = scs_write_reloc,
+    .cs_begin = scs_begin,
+    .cs_end = scs_end,
+    .cs_emit = scs_emit,
+    .cs_destroy = scs_destroy,
+    .cs_erase = scs_erase,
+    .cs_need_flush = scs_need_flush,
+    .cs_print = scs_print,
+};
+
+struct r600_standin *r600_standin_create(const struct r600_standin_config *cfg)
+{
+    struct r600_standin *sd;
+
+    if((sd = calloc(1, sizeof(*sd))) == NULL)
+        return NULL;
+
+    if(cfg != NULL)
+        sd->cfg = *cfg;
+
+    sd->bom.funcs = &bo_funcs;
+    sd->bom.fd = -1;
+    sd->csm.funcs = &cs_funcs;
+    sd->csm.fd = -1;
+    /* Plenty, so the space checks never ask for a flush */
+    sd->csm.vram_limit = 1 << 30;
+    sd->csm.gart_limit = 1 << 30;
+
+    pthread_mutex_init(&sd->lock, NULL);
+    pthread_cond_init(&sd->work, NULL);
+    pthread_cond_init(&sd->done, NULL);
+
+    if(pthread_create(&sd->thread, NULL, gpu_thread, sd) != 0) {
+        pthread_cond_destroy(&sd->done);
+        pthread_cond_destroy(&sd->work);
+        pthread_mutex_destroy(&sd->lock);
+        free(sd);
+        return NULL;
+    }
+
+    return sd;
+}
+
+void r600_standin_destroy(struct r600_standin *sd)
+{
+    struct sbo *bo;
+
+    if(sd == NULL)
+        return;
+
+    pthread_mutex_lock(&sd->lock);
+    sd->quit = 1;
+    pthread_cond_signal(&sd->work);
+    pthread_mutex_unlock(&sd->lock);
+
+    pthread_join(sd->thread, NULL);
+
+    while((bo = sd->zombies) != NULL) {
+        sd->zombies = bo->next;
+        free_bo(bo);
+    }
+
+    pthread_cond_destroy(&sd->done);
+    pthread_cond_destroy(&sd->work);
+    pthread_mutex_destroy(&sd->lock);
+    free(sd);
+}
+
+struct radeon_bo_manager *r600_standin_bom(struct r600_standin *sd)
+{
+    return &sd->bom;
+}
+
+struct radeon_cs_manager *r600_standin_csm(struct r600_standin *sd)
+{
+    return &sd->csm;
+}
+
+void r600_standin_idle(struct r600_standin *sd)
+{
+    pthread_mutex_lock(&sd->lock);
+    while(sd->completed < sd->emitted)
+        pthread_cond_wait(&sd->done, &sd->lock);
+    pthread_mutex_unlock(&sd->lock);
+}
+
+uint64_t r600_standin_last_write_ns(struct r600_standin *sd)
+{
+    return __atomic_load_n(&sd->last_write_ns, __ATOMIC_RELAXED);
+}
+
+void r600_standin_get_stats(struct r600_standin *sd, struct r600_standin_stats *stats)
+{
+    pthread_mutex_lock(&sd->lock);
+    *stats = sd->stats;
+    pthread_mutex_unlock(&sd->lock);
+}
@@ -0,0 +1,87 @@
+/**
+ * r600_standin.h: a host-memory stand-in for the GPU behind libdrm_radeon
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_STANDIN_H_
+#define _R600_STANDIN_H_
+
+#include <stdint.h>
+
+#include <radeon_bo.h>
+#include <radeon_cs.h>
+
+/*
+ * A fake GPU for running the command-stream code without the hardware.
+ * It plugs into libdrm_radeon the same way the GEM backend does, so
+ * radeon_bo_*() and radeon_cs_*() work unchanged on the managers it
+ * hands out.  BOs are plain host memory and always mapped.  An emitted
+ * CS is copied and run on a worker thread, one at a time and in order,
+ * after a configurable launch latency.
+ *
+ * Only the packets with visible effects in memory are carried out:
+ * IT_EVENT_WRITE_EOP and IT_MEM_WRITE store their values, IT_CP_DMA
+ * copies, IT_WAIT_REG_MEM polls memory (register waits always pass) and
+ * IT_INDIRECT_BUFFER runs the dwords in its BO, IT_COND_EXEC passes over
+ * its count of dwords when the dword it names is zero.  Each
+ * IT_DRAW_INDEX_AUTO takes dispatch_us.  Everything else is skipped over by its length.
+ */
+
+struct r600_standin;
+
+struct r600_standin_config {
+    unsigned launch_us;     /* from radeon_cs_emit() until the CS starts */
+    unsigned dispatch_us;   /* per draw */
+};
+
+struct r600_standin_stats {
+    uint64_t submits;
+    uint64_t dwords;
+    uint64_t draws;
+    uint64_t writes;        /* EOP and MEM_WRITE stores */
+    uint64_t skipped;       /* dwords passed over by IT_COND_EXEC */
+    uint64_t bad;           /* CSs cut short by a malformed packet */
+};
+
+/* cfg may be NULL for no simulated delays */
+struct r600_standin *r600_standin_create(const struct r600_standin_config *cfg);
+
+/* Finishes all submitted work first */
+void r600_standin_destroy(struct r600_standin *sd);
+
+struct radeon_bo_manager *r600_standin_bom(struct r600_standin *sd);
+struct radeon_cs_manager *r600_standin_csm(struct r600_standin *sd);
+
+/* Blocks until everything emitted so far has run */
+void r600_standin_idle(struct r600_standin *sd);
+
+/*
+ * CLOCK_MONOTONIC time, in ns, of the most recent EOP or MEM_WRITE store.
+ * It is taken just before the value lands, so whoever sees the value can
+ * measure how long it took to notice.
+ */
+uint64_t r600_standin_last_write_ns(struct r600_standin *sd);
+
+void r600_standin_get_stats(struct r600_standin *sd, struct r600_standin_stats *stats);
+
+#endif
@@ -0,0 +1,200 @@
+/**
+ * r600_stream.c: self-chaining command streams
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <radeon_cs.h>
+
+#include "r600_cmdbuf.h"
+#include "r600_fence.h"
+#include "r600_regbuf.h"
+#include "r600_resid.h"
+#include "r600_shadow.h"
+#include "r600_stream.h"
+
+static int submit_segment(struct r600_stream *s)
+{
+    unsigned ndw, tail;
+    int ret = 0;
+
+    if(s->cb->cdw == 0)
+        return 0;
+
+    if(s->tl != NULL) {
+        /* Goes into the room kept at the end, so this never splits */
+        tail = s->cb->tail;
+        s->cb->tail = 0;
+        ret = r600_timeline_signal(s->tl, s->cb, s->tl->last + 1);
+        s->cb->tail = tail;
+    }
+
+    ndw = s->cb->cdw;
+    if(ret == 0)
+        ret = r600_cmdbuf_submit(s->cb, s->cs);
+    if(ret != 0) {
+        /* Don't leave the segment around to be resubmitted */
+        radeon_cs_erase(s->cs);
+        r600_cmdbuf_reset(s->cb);
+        if(s->error == 0)
+            s->error = ret;
+        return ret;
+    }
+
+    if(s->tl != NULL)
+        s->fence = s->tl->last;
+    s->batch_ndw += ndw;
+    s->stats.submits++;
+    s->stats.dwords += ndw;
+
+    return 0;
+}
+
+static int split(struct r600_cmdbuf *cb, void *data)
+{
+    struct r600_stream *s = data;
+    struct r600_shadow *shadow = s->rb != NULL ? s->rb->shadow : NULL;
+    int ret;
+
+    s->stats.splits++;
+
+    if((ret = submit_segment(s)) != 0) {
+        if(shadow != NULL)
+            r600_shadow_invalidate(shadow);
+        return ret;
+    }
+
+    if(shadow != NULL) {
+        if((ret = r600_shadow_emit(shadow, cb)) != 0) {
+            r600_cmdbuf_reset(cb);
+            r600_shadow_invalidate(shadow);
+            return ret;
+        }
+        s->stats.restored += cb->cdw;
+    }
+
+    cb->seg_start = cb->cdw;
+    cb->seg_relocs = cb->nrelocs;
+
+    return 0;
+}
+
+static unsigned learned_size(const struct r600_stream *s)
+{
+    unsigned ndw = s->avg_ndw + s->avg_ndw / 4;
+
+    ndw = (ndw + R600_STREAM_MIN_DW - 1) & ~(R600_STREAM_MIN_DW - 1);
+    if(ndw < R600_STREAM_MIN_DW)
+        ndw = R600_STREAM_MIN_DW;
+    if(ndw > R600_STREAM_MAX_DW)
+        ndw = R600_STREAM_MAX_DW;
+
+    return ndw;
+}
+
+struct r600_stream *r600_stream_create(struct radeon_cs_manager *csm,
+                                       struct r600_regbuf *rb)
+{
+    struct r600_stream *s;
+
+    if((s = calloc(1, sizeof(*s))) == NULL)
+        return NULL;
+
+    s->rb = rb;
+    s->avg_ndw = 1024;
+
+    if((s->cb = r600_cmdbuf_create(learned_size(s))) == NULL ||
+       (s->cs = radeon_cs_create(csm, learned_size(s))) == NULL) {
+        r600_stream_destroy(s);
+        return NULL;
+    }
+
+    s->cb->flush = split;
+    s->cb->flush_data = s;
+
+    return s;
+}
+
+void r600_stream_destroy(struct r600_stream *s)
+{
+    if(s == NULL)
+        return;
+
+    if(s->cs != NULL)
+        radeon_cs_destroy(s->cs);
+    r600_cmdbuf_destroy(s->cb);
+    free(s);
+}
+
+void r600_stream_set_timeline(struct r600_stream *s, struct r600_timeline *tl)
+{
+    s->tl = tl;
+    s->cb->tail = tl != NULL ? R600_EVENT_WRITE_EOP_DW : 0;
+    s->fence = tl != NULL ? tl->last : 0;
+}
+
+int r600_stream_set_residency(struct r600_stream *s, struct r600_residency *res)
+{
+    int ret = 0;
+
+    if(res != NULL)
+        ret = r600_residency_declare(res, s->cs);
+    else
+        radeon_cs_space_reset_bos(s->cs);
+
+    s->cb->resident = ret == 0 ? res : NULL;
+
+    return ret;
+}
+
+int r600_stream_submit(struct r600_stream *s)
+{
+    int ret = 0, err;
+    unsigned ndw;
+
+    if(s->rb != NULL)
+        ret = r600_regbuf_flush(s->rb, s->cb);
+    if(ret == 0)
+        ret = submit_segment(s);
+    if(s->rb != NULL && s->rb->shadow != NULL)
+        r600_shadow_invalidate(s->rb->shadow);
+
+    /* Learn from the whole batch, splits included */
+    ndw = s->batch_ndw;
+    s->avg_ndw = (s->avg_ndw * 7 + ndw) / 8;
+    s->batch_ndw = 0;
+    s->stats.batches++;
+
+    /* Only resize for a real change, not every wobble */
+    ndw = learned_size(s);
+    if((ndw > s->cb->ndw || ndw < s->cb->ndw / 2) && s->cb->cdw == 0)
+        r600_cmdbuf_resize(s->cb, ndw);
+
+    err = s->error;
+    s->error = 0;
+
+    return err != 0 ? err : ret;
+}
@@ -0,0 +1,113 @@
+/**
+ * r600_stream.h: self-chaining command streams
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_STREAM_H_
+#define _R600_STREAM_H_
+
+#include <stdint.h>
+
+#include <radeon_cs.h>
+
+#include "r600_cmdbuf.h"
+#include "r600_fence.h"
+#include "r600_regbuf.h"
+#include "r600_resid.h"
+
+/*
+ * A command stream of unbounded length built from fixed-size segments.
+ * Packets go into s->cb as usual; when one doesn't fit in what is left of
+ * the segment, the segment is submitted on its own and the packet starts
+ * the next one.  Relocations never straddle a split, since each packet
+ * reserves its relocations along with its dwords.
+ *
+ * The register state from before the split is not trusted to survive it,
+ * so everything the shadow knows is re-sent at the start of the new
+ * segment; a dispatch whose state went out in one segment and whose draw
+ * lands in the next still sees its state.  That only covers registers set
+ * through the regbuf, so a sequence that has to stay together (a
+ * COND_EXEC and the packets it skips, say) should r600_cmdbuf_reserve()
+ * its full size first.
+ *
+ * The segment size (s->cb->ndw) is learned: a running average of recent
+ * batch sizes plus a quarter for headroom, so small batches don't carry a
+ * worst-case buffer and big ones rarely split.  Whether the buffers fit is
+ * still only checked as each segment is submitted.
+ *
+ * With a timeline attached, every segment ends by signalling the next
+ * value on it (room for that is kept free at the end of the segment), so
+ * s->fence tells how far the GPU has to get for everything submitted so
+ * far to be done.  A segment that fails to submit takes its value with
+ * it; the next one to go through covers it.
+ */
+
+/* The kernel won't take a bigger IB */
+#define R600_STREAM_MAX_DW  (16 * 1024)
+#define R600_STREAM_MIN_DW  256
+
+struct r600_stream_stats {
+    uint64_t batches;       /* r600_stream_submit() calls */
+    uint64_t submits;       /* segments submitted */
+    uint64_t splits;        /* ... because they filled up */
+    uint64_t dwords;
+    uint64_t restored;      /* dwords of state re-sent after splits */
+};
+
+struct r600_stream {
+    struct r600_cmdbuf *cb;
+    struct r600_regbuf *rb;     /* may be NULL */
+    struct radeon_cs *cs;
+
+    unsigned avg_ndw;           /* learned batch size */
+    unsigned batch_ndw;         /* submitted so far in this batch */
+    int error;                  /* from a split, reported at the batch end */
+
+    struct r600_timeline *tl;   /* may be NULL */
+    uint64_t fence;             /* tl's value once the last segment is done */
+
+    struct r600_stream_stats stats;
+};
+
+/* rb, with its shadow, is optional */
+struct r600_stream *r600_stream_create(struct radeon_cs_manager *csm,
+                                       struct r600_regbuf *rb);
+void r600_stream_destroy(struct r600_stream *s);
+
+/* Attaches tl (or detaches with NULL); only between batches */
+void r600_stream_set_timeline(struct r600_stream *s, struct r600_timeline *tl);
+
+/*
+ * Declares res on the stream's CS and has the segments lean on it (or
+ * drops any set with NULL); only between batches, and again after res
+ * changes.  Returns 0 or -E2BIG, in which case no set is in use.
+ */
+int r600_stream_set_residency(struct r600_stream *s, struct r600_residency *res);
+
+/*
+ * Ends a batch: flushes the regbuf, submits what is left and invalidates
+ * the shadow.  Returns 0, or the first error from this or an earlier split.
+ */
+int r600_stream_submit(struct r600_stream *s);
+
+#endif
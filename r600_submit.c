@@ -0,0 +1,332 @@
+/**
+ * r600_submit.c: a submission thread fed by a lock-free queue
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <pthread.h>
+
+#include <radeon_cs.h>
+
+#include "r600_cmdbuf.h"
+#include "r600_fence.h"
+#include "r600_hist.h"
+#include "r600_ib.h"
+#include "r600_stream.h"
+#include "r600_submit.h"
+
+struct r600_future {
+    struct r600_future *next;   /* on the queue */
+    struct r600_future *batch;  /* the rest of its batch */
+    struct r600_submitter *sub;
+
+    struct r600_ib *ib;
+    uint64_t queued_ns;
+
+    int done, status;
+    uint64_t fence;
+    int refs;                   /* caller's handle + the thread's */
+};
+
+struct r600_submitter {
+    /*
+     * Producers swap themselves in at head and then link the old head to
+     * themselves; the thread takes jobs off at tail.  The stub keeps the
+     * queue from ever being truly empty, so neither end needs a lock.
+     */
+    struct r600_future *head;
+    struct r600_future *tail;
+    struct r600_future stub;
+
+    struct r600_stream *s;
+    struct r600_timeline *tl;
+    unsigned batch_ndw;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work;        /* signalled when a job arrives for a sleeping thread */
+    pthread_cond_t done;        /* signalled when a batch has been submitted */
+    int sleeping, quit;
+
+    struct r600_submit_stats stats;
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void push(struct r600_submitter *sub, struct r600_future *f)
+{
+    struct r600_future *prev;
+
+    __atomic_store_n(&f->next, NULL, __ATOMIC_RELAXED);
+    prev = __atomic_exchange_n(&sub->head, f, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, f, __ATOMIC_RELEASE);
+}
+
+/* Only ever called on the submission thread */
+static struct r600_future *pop(struct r600_submitter *sub)
+{
+    struct r600_future *tail = sub->tail;
+    struct r600_future *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    if(tail == &sub->stub) {
+        if(next == NULL)
+            return NULL;
+        sub->tail = tail = next;
+        next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    }
+
+    if(next != NULL) {
+        sub->tail = next;
+        return tail;
+    }
+
+    /* tail is the last job, unless a producer is halfway through a push */
+    if(tail != __atomic_load_n(&sub->head, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    push(sub, &sub->stub);
+    if((next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE)) == NULL)
+        return NULL;
+
+    sub->tail = next;
+    return tail;
+}
+
+/* Called with sub->lock held */
+static void put_future(struct r600_future *f)
+{
+    if(--f->refs == 0)
+        free(f);
+}
+
+static void run_batch(struct r600_submitter *sub, struct r600_future *first)
+{
+    struct r600_future *f = first, *next;
+    unsigned n = 1;
+    uint64_t t, fence;
+    int ret;
+
+    /* Take whatever else is queued right now, without waiting for more */
+    for(;;) {
+        f->status = r600_ib_replay(f->ib, sub->s->cb);
+        r600_ib_destroy(f->ib);
+        f->ib = NULL;
+
+        if(sub->s->cb->cdw >= sub->batch_ndw || (next = pop(sub)) == NULL)
+            break;
+        f->batch = next;
+        f = next;
+        n++;
+    }
+    f->batch = NULL;
+
+    t = now_ns();
+    ret = r600_stream_submit(sub->s);
+    fence = sub->tl != NULL ? sub->s->fence : 0;
+
+    pthread_mutex_lock(&sub->lock);
+
+    for(f = first; f != NULL; f = next) {
+        next = f->batch;
+        r600_hist_add(&sub->stats.delay_ns, t - f->queued_ns);
+        if(f->status == 0)
+            f->status = ret;
+        sub->stats.errors += f->status != 0;
+        f->fence = fence;
+        f->done = 1;
+        put_future(f);
+    }
+
+    sub->stats.jobs += n;
+    sub->stats.batches++;
+    r600_hist_add(&sub->stats.batch_jobs, n);
+
+    pthread_cond_broadcast(&sub->done);
+    pthread_mutex_unlock(&sub->lock);
+}
+
+static void *submit_thread(void *arg)
+{
+    struct r600_submitter *sub = arg;
+    struct r600_future *f;
+
+    for(;;) {
+        if((f = pop(sub)) == NULL) {
+            pthread_mutex_lock(&sub->lock);
+            __atomic_store_n(&sub->sleeping, 1, __ATOMIC_RELAXED);
+            /* Pairs with the fence in r600_submit(): one of us sees the other */
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            while((f = pop(sub)) == NULL && !sub->quit)
+                pthread_cond_wait(&sub->work, &sub->lock);
+            __atomic_store_n(&sub->sleeping, 0, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&sub->lock);
+
+            if(f == NULL)
+                break; /* quitting, and nothing left to do */
+        }
+
+        run_batch(sub, f);
+    }
+
+    return NULL;
+}
+
+struct r600_submitter *r600_submitter_create(struct radeon_cs_manager *csm,
+                                             struct r600_timeline *tl)
+{
+    struct r600_submitter *sub;
+
+    if((sub = calloc(1, sizeof(*sub))) == NULL)
+        return NULL;
+
+    sub->head = sub->tail = &sub->stub;
+    sub->tl = tl;
+    sub->batch_ndw = R600_SUBMIT_BATCH_DW;
+
+    if((sub->s = r600_stream_create(csm, NULL)) == NULL) {
+        free(sub);
+        return NULL;
+    }
+    if(tl != NULL)
+        r600_stream_set_timeline(sub->s, tl);
+
+    pthread_mutex_init(&sub->lock, NULL);
+    pthread_cond_init(&sub->work, NULL);
+    pthread_cond_init(&sub->done, NULL);
+
+    if(pthread_create(&sub->thread, NULL, submit_thread, sub) != 0) {
+        pthread_cond_destroy(&sub->done);
+        pthread_cond_destroy(&sub->work);
+        pthread_mutex_destroy(&sub->lock);
+        r600_stream_destroy(sub->s);
+        free(sub);
+        return NULL;
+    }
+
+    return sub;
+}
+
+void r600_submitter_destroy(struct r600_submitter *sub)
+{
+    if(sub == NULL)
+        return;
+
+    pthread_mutex_lock(&sub->lock);
+    sub->quit = 1;
+    pthread_cond_signal(&sub->work);
+    pthread_mutex_unlock(&sub->lock);
+
+    pthread_join(sub->thread, NULL);
+
+    pthread_cond_destroy(&sub->done);
+    pthread_cond_destroy(&sub->work);
+    pthread_mutex_destroy(&sub->lock);
+    r600_stream_destroy(sub->s);
+    free(sub);
+}
+
+struct r600_future *r600_submit(struct r600_submitter *sub, struct r600_cmdbuf *cb)
+{
+    struct r600_future *f;
+
+    /* It has to fit in one CS along with the fence */
+    if(cb->cdw + R600_EVENT_WRITE_EOP_DW > R600_STREAM_MAX_DW)
+        return NULL;
+
+    if((f = calloc(1, sizeof(*f))) == NULL)
+        return NULL;
+    if((f->ib = r600_ib_create(cb)) == NULL) {
+        free(f);
+        return NULL;
+    }
+
+    f->sub = sub;
+    f->refs = 2;
+    f->queued_ns = now_ns();
+    r600_cmdbuf_reset(cb);
+
+    push(sub, f);
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&sub->sleeping, __ATOMIC_RELAXED)) {
+        pthread_mutex_lock(&sub->lock);
+        pthread_cond_signal(&sub->work);
+        pthread_mutex_unlock(&sub->lock);
+    }
+
+    return f;
+}
+
+int r600_future_done(struct r600_future *f)
+{
+    int done;
+
+    pthread_mutex_lock(&f->sub->lock);
+    done = f->done;
+    pthread_mutex_unlock(&f->sub->lock);
+
+    return done;
+}
+
+int r600_future_wait(struct r600_future *f, uint64_t *fence)
+{
+    struct r600_submitter *sub = f->sub;
+    int status;
+
+    pthread_mutex_lock(&sub->lock);
+    while(!f->done)
+        pthread_cond_wait(&sub->done, &sub->lock);
+    status = f->status;
+    if(fence != NULL)
+        *fence = f->fence;
+    put_future(f);
+    pthread_mutex_unlock(&sub->lock);
+
+    return status;
+}
+
+void r600_future_release(struct r600_future *f)
+{
+    struct r600_submitter *sub = f->sub;
+
+    pthread_mutex_lock(&sub->lock);
+    put_future(f);
+    pthread_mutex_unlock(&sub->lock);
+}
+
+void r600_submitter_get_stats(struct r600_submitter *sub, struct r600_submit_stats *stats)
+{
+    pthread_mutex_lock(&sub->lock);
+    *stats = sub->stats;
+    pthread_mutex_unlock(&sub->lock);
+}
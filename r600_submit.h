@@ -0,0 +1,101 @@
+/**
+ * r600_submit.h: a submission thread fed by a lock-free queue
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_SUBMIT_H_
+#define _R600_SUBMIT_H_
+
+#include <stdint.h>
+
+#include <radeon_cs.h>
+
+#include "r600_cmdbuf.h"
+#include "r600_fence.h"
+#include "r600_hist.h"
+
+/*
+ * Submitting means a space check, copying the packets, relocation
+ * validation and the CS ioctl, all of which used to land on whichever
+ * thread built the commands.  Instead, threads record into their own
+ * r600_cmdbuf and hand the result to a per-device submission thread.
+ * Handing over takes no lock: jobs go on an intrusive multi-producer,
+ * single-consumer queue with one atomic exchange, and the thread is only
+ * woken through a mutex when it has gone to sleep on an empty queue.
+ *
+ * The thread takes whatever has queued up by the time it gets to it, up
+ * to batch_ndw dwords, and submits it as one CS, so a burst of small
+ * jobs costs one ioctl rather than one each; it never waits for more
+ * jobs to arrive.  Jobs run in the order they were queued.
+ *
+ * Each job yields a future: it completes once its batch is submitted,
+ * carrying the status and, if the submitter has a timeline, the value it
+ * reaches once the GPU is done with the batch.
+ *
+ * The thread should be the only one submitting on the cs manager, and
+ * the BOs a job uses must stay referenced until its future completes.
+ */
+
+#define R600_SUBMIT_BATCH_DW 4096
+
+struct r600_submitter;
+struct r600_future;
+
+struct r600_submit_stats {
+    uint64_t jobs;
+    uint64_t batches;
+    uint64_t errors;            /* jobs that failed */
+    struct r600_hist delay_ns;  /* queued until its batch went to the kernel */
+    struct r600_hist batch_jobs;
+};
+
+/* tl may be NULL; if not, only the submission thread may signal it */
+struct r600_submitter *r600_submitter_create(struct radeon_cs_manager *csm,
+                                             struct r600_timeline *tl);
+
+/* Submits everything still queued, then stops the thread */
+void r600_submitter_destroy(struct r600_submitter *sub);
+
+/*
+ * Queues what cb holds and resets cb.  Returns NULL if out of memory (cb
+ * is left alone then); otherwise the future must eventually be passed to
+ * r600_future_wait() or r600_future_release().
+ */
+struct r600_future *r600_submit(struct r600_submitter *sub, struct r600_cmdbuf *cb);
+
+/* Nonzero once the job's batch has been submitted (never blocks) */
+int r600_future_done(struct r600_future *f);
+
+/*
+ * Blocks until the batch has been submitted, frees the future and returns
+ * the submission status.  If fence isn't NULL it gets the timeline value
+ * that marks the batch done on the GPU (0 without a timeline).
+ */
+int r600_future_wait(struct r600_future *f, uint64_t *fence);
+
+/* Frees the future without waiting; the job is still submitted */
+void r600_future_release(struct r600_future *f);
+
+void r600_submitter_get_stats(struct r600_submitter *sub, struct r600_submit_stats *stats);
+
+#endif
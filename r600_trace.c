@@ -0,0 +1,702 @@
+/**
+ * r600_trace.c: capture of submitted command streams, and their replay
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <radeon_bo.h>
+#include <radeon_cs.h>
+
+#include "r600_cmdbuf.h"
+#include "r600_trace.h"
+
+#define PAGE_DW     (R600_TRACE_PAGE / 4)
+
+struct r600_capture_bo {
+    struct radeon_bo *bo;
+    unsigned npages;
+    uint64_t *pages;        /* hash of each page as the trace has it */
+};
+
+static const uint32_t zero_page[PAGE_DW];
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t hash_page(const void *p, uint32_t bytes)
+{
+    const uint32_t *w = p;
+    uint64_t h = 0xcbf29ce484222325ull ^ bytes;
+    uint32_t last = 0;
+    unsigned i;
+
+    for(i = 0; i < bytes / 4; i++)
+        h = (h ^ w[i]) * 0x100000001b3ull;
+    if(bytes % 4 != 0) {
+        memcpy(&last, w + i, bytes % 4);
+        h = (h ^ last) * 0x100000001b3ull;
+    }
+
+    return h ^ h >> 29;
+}
+
+static void put(struct r600_capture *cap, const void *p, size_t ndw)
+{
+    if(cap->error == 0 && fwrite(p, sizeof(uint32_t), ndw, cap->f) != ndw)
+        cap->error = -EIO;
+}
+
+static void put_record(struct r600_capture *cap, uint32_t type, uint32_t len)
+{
+    uint32_t hdr[2] = {type, len};
+
+    put(cap, hdr, 2);
+}
+
+struct r600_capture *r600_capture_create(FILE *f)
+{
+    struct r600_capture *cap;
+    uint32_t hdr[2] = {R600_TRACE_MAGIC, R600_TRACE_VERSION};
+
+    if((cap = calloc(1, sizeof(*cap))) == NULL)
+        return NULL;
+
+    cap->f = f;
+    cap->start_ns = now_ns();
+    put(cap, hdr, 2);
+    if(cap->error != 0) {
+        free(cap);
+        return NULL;
+    }
+
+    return cap;
+}
+
+void r600_capture_destroy(struct r600_capture *cap)
+{
+    unsigned i;
+
+    if(cap == NULL)
+        return;
+
+    for(i = 0; i < cap->nbos; i++) {
+        radeon_bo_unref(cap->bos[i].bo);
+        free(cap->bos[i].pages);
+    }
+    fflush(cap->f);
+    free(cap->bos);
+    free(cap->hash);
+    free(cap->ids);
+    free(cap);
+}
+
+static unsigned *find_hash(struct r600_capture *cap, const struct radeon_bo *bo)
+{
+    unsigned h = r600_bo_hash(bo) & cap->hash_mask;
+
+    while(cap->hash[h] != 0 && cap->bos[cap->hash[h] - 1].bo != bo)
+        h = (h + 1) & cap->hash_mask;
+
+    return &cap->hash[h];
+}
+
+/* Room for twice as many BOs, and a hash index at most half full */
+static int grow_bos(struct r600_capture *cap)
+{
+    unsigned n = cap->max_bos != 0 ? 2 * cap->max_bos : 64, *hash, i;
+    void *p;
+
+    if((hash = calloc(2 * n, sizeof(*hash))) == NULL)
+        return -ENOMEM;
+    if((p = realloc(cap->bos, n * sizeof(*cap->bos))) == NULL) {
+        free(hash);
+        return -ENOMEM;
+    }
+
+    free(cap->hash);
+    cap->bos = p;
+    cap->max_bos = n;
+    cap->hash = hash;
+    cap->hash_mask = 2 * n - 1;
+
+    for(i = 0; i < cap->nbos; i++)
+        *find_hash(cap, cap->bos[i].bo) = i + 1;
+
+    return 0;
+}
+
+/* bo's id, announcing it with a BO record the first time */
+static int bo_id(struct r600_capture *cap, const struct r600_bo_slot *s)
+{
+    struct r600_capture_bo *c;
+    uint32_t rec[3], bytes;
+    unsigned *h, i;
+
+    if(cap->max_bos != 0 && *(h = find_hash(cap, s->bo)) != 0)
+        return *h - 1;
+
+    if(cap->nbos == cap->max_bos && (cap->error = grow_bos(cap)) != 0)
+        return cap->error;
+
+    c = &cap->bos[cap->nbos];
+    c->npages = (s->bo->size + R600_TRACE_PAGE - 1) / R600_TRACE_PAGE;
+    if((c->pages = malloc(c->npages * sizeof(uint64_t))) == NULL)
+        return cap->error = -ENOMEM;
+
+    /* A new BO is taken to be zeroed; the replay clears it to match */
+    for(i = 0; i < c->npages; i++) {
+        bytes = s->bo->size - i * R600_TRACE_PAGE;
+        c->pages[i] = hash_page(zero_page, bytes < R600_TRACE_PAGE ? bytes : R600_TRACE_PAGE);
+    }
+
+    radeon_bo_ref(s->bo);
+    c->bo = s->bo;
+    *find_hash(cap, s->bo) = ++cap->nbos;
+
+    rec[0] = cap->nbos - 1;
+    rec[1] = s->bo->size;
+    rec[2] = s->read_domains | s->write_domain;
+    put_record(cap, R600_TRACE_BO, 3);
+    put(cap, rec, 3);
+
+    return cap->nbos - 1;
+}
+
+static void put_data(struct r600_capture *cap, unsigned id, const struct radeon_bo *bo,
+                     unsigned first, unsigned end)
+{
+    uint32_t rec[3], pad = 0;
+    uint32_t offset = first * R600_TRACE_PAGE;
+    uint32_t bytes = (end * R600_TRACE_PAGE < bo->size ? end * R600_TRACE_PAGE : bo->size) - offset;
+
+    rec[0] = id;
+    rec[1] = offset;
+    rec[2] = bytes;
+    put_record(cap, R600_TRACE_DATA, 3 + (bytes + 3) / 4);
+    put(cap, rec, 3);
+    put(cap, (const char *) bo->ptr + offset, bytes / 4);
+    if(bytes % 4 != 0) {
+        memcpy(&pad, (const char *) bo->ptr + offset + bytes / 4 * 4, bytes % 4);
+        put(cap, &pad, 1);
+    }
+}
+
+/* Writes the runs of pages that changed since the trace last had them */
+static void save_pages(struct r600_capture *cap, unsigned id)
+{
+    struct r600_capture_bo *c = &cap->bos[id];
+    struct radeon_bo *bo = c->bo;
+    unsigned i, run = 0;
+    uint32_t bytes;
+    uint64_t h;
+
+    if(radeon_bo_map(bo, 0) != 0 || bo->ptr == NULL) {
+        cap->error = -EFAULT;
+        return;
+    }
+
+    for(i = 0; i < c->npages; i++) {
+        bytes = bo->size - i * R600_TRACE_PAGE;
+        h = hash_page((const char *) bo->ptr + i * R600_TRACE_PAGE,
+                      bytes < R600_TRACE_PAGE ? bytes : R600_TRACE_PAGE);
+        if(h == c->pages[i]) {
+            if(run < i)
+                put_data(cap, id, bo, run, i);
+            run = i + 1;
+            cap->stats.unchanged++;
+        } else {
+            c->pages[i] = h;
+            cap->stats.pages++;
+        }
+    }
+    if(run < c->npages)
+        put_data(cap, id, bo, run, c->npages);
+
+    radeon_bo_unmap(bo);
+}
+
+void r600_capture_contents(struct r600_capture *cap, const struct r600_cmdbuf *cb)
+{
+    unsigned i, *p;
+    int id;
+
+    if(cap->error != 0)
+        return;
+
+    if(cb->nbos > cap->max_ids) {
+        if((p = realloc(cap->ids, cb->nbos * sizeof(*p))) == NULL) {
+            cap->error = -ENOMEM;
+            return;
+        }
+        cap->ids = p;
+        cap->max_ids = cb->nbos;
+    }
+
+    for(i = 0; i < cb->nbos && cap->error == 0; i++) {
+        if((id = bo_id(cap, &cb->bos[i])) < 0)
+            return;
+        cap->ids[i] = id;
+
+        if(radeon_bo_is_busy(cb->bos[i].bo, NULL) != 0)
+            cap->stats.busy++;
+        else
+            save_pages(cap, id);
+    }
+}
+
+void r600_capture_submit(struct r600_capture *cap, const struct r600_cmdbuf *cb)
+{
+    const struct r600_reloc *r;
+    uint64_t t = now_ns() - cap->start_ns;
+    uint32_t rec[4];
+
+    if(cap->error != 0)
+        return;
+
+    put_record(cap, R600_TRACE_SUBMIT, 4 + 4 * cb->nrelocs + cb->cdw);
+    rec[0] = (uint32_t) t;
+    rec[1] = (uint32_t) (t >> 32);
+    rec[2] = cb->cdw;
+    rec[3] = cb->nrelocs;
+    put(cap, rec, 4);
+
+    for(r = cb->relocs; r < cb->relocs + cb->nrelocs; r++) {
+        rec[0] = cap->ids[r->slot];
+        rec[1] = r->read_domains;
+        rec[2] = r->write_domain;
+        rec[3] = r->cdw;
+        put(cap, rec, 4);
+    }
+    put(cap, cb->buf, cb->cdw);
+
+    if(cap->error == 0) {
+        cap->stats.submits++;
+        cap->stats.dwords += cb->cdw;
+    }
+}
+
+/* Reading traces back */
+
+static uint32_t *read_all(FILE *f, unsigned *ndw)
+{
+    uint32_t *buf = NULL, *p;
+    size_t n = 0, max = 0, got;
+
+    for(;;) {
+        if(n == max) {
+            max = max != 0 ? 2 * max : 65536;
+            if((p = realloc(buf, max * sizeof(uint32_t))) == NULL) {
+                free(buf);
+                errno = ENOMEM;
+                return NULL;
+            }
+            buf = p;
+        }
+        if((got = fread(buf + n, sizeof(uint32_t), max - n, f)) == 0)
+            break;
+        n += got;
+    }
+
+    if(ferror(f)) {
+        free(buf);
+        errno = EIO;
+        return NULL;
+    }
+
+    *ndw = n;
+    return buf;
+}
+
+/* Does the SUBMIT record at p, len dwords long, hang together? */
+static int submit_ok(const uint32_t *p, uint32_t len, unsigned nbos)
+{
+    uint32_t ndw, nrelocs, i, next = 0;
+    const uint32_t *r, *buf;
+
+    if(len < 4)
+        return 0;
+    ndw = p[2];
+    nrelocs = p[3];
+    if(nrelocs > (len - 4) / 4 || ndw != len - 4 - 4 * nrelocs)
+        return 0;
+
+    buf = p + 4 + 4 * nrelocs;
+    for(i = 0, r = p + 4; i < nrelocs; i++, r += 4) {
+        if(r[0] >= nbos || r[3] < next || (uint64_t) r[3] + R600_RELOC_DW > ndw ||
+           buf[r[3]] != PACKET3(IT_NOP, 1))
+            return 0;
+        next = r[3] + R600_RELOC_DW;
+    }
+
+    return 1;
+}
+
+struct r600_trace *r600_trace_load(FILE *f)
+{
+    struct r600_trace *t;
+    uint32_t *sizes = NULL, type, len, *p;
+    unsigned pos, max_submits = 0, *s;
+
+    if((t = calloc(1, sizeof(*t))) == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if((t->buf = read_all(f, &t->ndw)) == NULL) {
+        free(t);
+        return NULL;
+    }
+
+    if(t->ndw < 2 || t->buf[0] != R600_TRACE_MAGIC || t->buf[1] != R600_TRACE_VERSION)
+        goto bad;
+
+    for(pos = 2; pos < t->ndw; pos += 2 + len) {
+        if(t->ndw - pos < 2)
+            goto bad;
+        type = t->buf[pos];
+        len = t->buf[pos + 1];
+        p = t->buf + pos + 2;
+        if(len > t->ndw - pos - 2)
+            goto bad;
+
+        switch(type) {
+        case R600_TRACE_BO:
+            if(len != 3 || p[0] != t->nbos || p[1] == 0)
+                goto bad;
+            if((t->nbos & (t->nbos - 1)) == 0) {
+                if((s = realloc(sizes, (t->nbos ? 2 * t->nbos : 1) * sizeof(*sizes))) == NULL)
+                    goto nomem;
+                sizes = s;
+            }
+            sizes[t->nbos++] = p[1];
+            break;
+
+        case R600_TRACE_DATA:
+            if(len < 3 || p[0] >= t->nbos || p[1] > sizes[p[0]] ||
+               p[2] > sizes[p[0]] - p[1] || len != 3 + (p[2] + 3) / 4)
+                goto bad;
+            break;
+
+        case R600_TRACE_SUBMIT:
+            if(!submit_ok(p, len, t->nbos))
+                goto bad;
+            if(t->nsubmits == max_submits) {
+                max_submits = max_submits != 0 ? 2 * max_submits : 256;
+                if((s = realloc(t->submits, max_submits * sizeof(*s))) == NULL)
+                    goto nomem;
+                t->submits = s;
+            }
+            t->submits[t->nsubmits++] = pos;
+            if(p[2] > t->max_ndw)
+                t->max_ndw = p[2];
+            break;
+
+        default:
+            goto bad;
+        }
+    }
+
+    free(sizes);
+    return t;
+
+nomem:
+    free(sizes);
+    r600_trace_destroy(t);
+    errno = ENOMEM;
+    return NULL;
+
+bad:
+    free(sizes);
+    r600_trace_destroy(t);
+    errno = EINVAL;
+    return NULL;
+}
+
+void r600_trace_destroy(struct r600_trace *t)
+{
+    if(t == NULL)
+        return;
+
+    free(t->submits);
+    free(t->buf);
+    free(t);
+}
+
+/* Replay */
+
+struct player {
+    const struct r600_trace *t;
+    struct radeon_bo_manager *bom;
+    struct radeon_bo **bos;
+    struct r600_cmdbuf *cb;
+    struct radeon_cs *cs;
+    struct r600_reloc *relocs;
+    unsigned max_relocs;
+    struct r600_replay_stats *stats;
+
+    void **snap;            /* BO contents at the start of the range */
+    uint64_t paused_ns;     /* spent copying into BOs rather than submitting */
+};
+
+static uint64_t submit_time(const struct r600_trace *t, unsigned i)
+{
+    const uint32_t *p = t->buf + t->submits[i] + 2;
+
+    return p[0] | (uint64_t) p[1] << 32;
+}
+
+/*
+ * Waiting for the GPU to let go of bo is part of running what came
+ * before, so only the copy itself goes into *paused (if not NULL).
+ */
+static int fill(struct radeon_bo *bo, uint32_t offset, const void *src, uint32_t bytes,
+                uint64_t *paused)
+{
+    uint64_t t0;
+    int ret;
+
+    if((ret = radeon_bo_wait(bo)) != 0)
+        return ret;
+
+    t0 = now_ns();
+    if((ret = radeon_bo_map(bo, 1)) != 0)
+        return ret;
+    if(src != NULL)
+        memcpy((char *) bo->ptr + offset, src, bytes);
+    else
+        memset((char *) bo->ptr + offset, 0, bytes);
+    radeon_bo_unmap(bo);
+    if(paused != NULL)
+        *paused += now_ns() - t0;
+
+    return 0;
+}
+
+static int play_bo(struct player *pl, const uint32_t *p)
+{
+    if(pl->bos[p[0]] == NULL &&
+       (pl->bos[p[0]] = radeon_bo_open(pl->bom, 0, p[1], R600_TRACE_PAGE, p[2], 0)) == NULL)
+        return -ENOMEM;
+
+    /* Coming round again on a loop, it is new again */
+    return fill(pl->bos[p[0]], 0, NULL, p[1], &pl->paused_ns);
+}
+
+static int play_submit(struct player *pl, const uint32_t *p)
+{
+    uint32_t ndw = p[2], nrelocs = p[3], i;
+    const uint32_t *r = p + 4;
+    struct r600_reloc *rel;
+    int ret;
+
+    if(nrelocs > pl->max_relocs) {
+        if((rel = realloc(pl->relocs, nrelocs * sizeof(*rel))) == NULL)
+            return -ENOMEM;
+        pl->relocs = rel;
+        pl->max_relocs = nrelocs;
+    }
+
+    for(i = 0; i < nrelocs; i++, r += 4) {
+        rel = &pl->relocs[i];
+        rel->bo = pl->bos[r[0]];
+        rel->read_domains = r[1];
+        rel->write_domain = r[2];
+        rel->cdw = r[3];
+    }
+
+    if((ret = r600_cmdbuf_append(pl->cb, r, ndw, pl->relocs, nrelocs, 0)) != 0 ||
+       (ret = r600_cmdbuf_submit(pl->cb, pl->cs)) != 0) {
+        r600_cmdbuf_reset(pl->cb);
+        return ret;
+    }
+
+    pl->stats->submits++;
+    pl->stats->dwords += ndw;
+
+    return 0;
+}
+
+/* Plays the records in [from, to), submissions only if submit is set */
+static int play(struct player *pl, unsigned from, unsigned to, int submit)
+{
+    const uint32_t *p;
+    unsigned pos;
+    int ret = 0;
+
+    for(pos = from; pos < to && ret == 0; pos += 2 + pl->t->buf[pos + 1]) {
+        p = pl->t->buf + pos + 2;
+
+        switch(pl->t->buf[pos]) {
+        case R600_TRACE_BO:
+            ret = play_bo(pl, p);
+            break;
+        case R600_TRACE_DATA:
+            if((ret = fill(pl->bos[p[0]], p[1], p + 3, p[2], &pl->paused_ns)) == 0)
+                pl->stats->bytes += p[2];
+            break;
+        case R600_TRACE_SUBMIT:
+            if(submit)
+                ret = play_submit(pl, p);
+            break;
+        }
+    }
+
+    return ret;
+}
+
+/* Copies what the BOs open so far hold, for restore() to put back */
+static int snapshot(struct player *pl)
+{
+    struct radeon_bo *bo;
+    unsigned i;
+    int ret;
+
+    if(pl->t->nbos == 0)
+        return 0;
+    if((pl->snap = calloc(pl->t->nbos, sizeof(*pl->snap))) == NULL)
+        return -ENOMEM;
+
+    for(i = 0; i < pl->t->nbos; i++) {
+        if((bo = pl->bos[i]) == NULL)
+            continue;
+        if((pl->snap[i] = malloc(bo->size)) == NULL)
+            return -ENOMEM;
+        if((ret = radeon_bo_wait(bo)) != 0 || (ret = radeon_bo_map(bo, 0)) != 0)
+            return ret;
+        memcpy(pl->snap[i], bo->ptr, bo->size);
+        radeon_bo_unmap(bo);
+    }
+
+    return 0;
+}
+
+/*
+ * Puts back the snapshot, so each loop starts from the same fences,
+ * counters and flags, not from what the last loop left in them.  BOs
+ * the range opens itself are cleared again when it does.
+ */
+static int restore(struct player *pl)
+{
+    unsigned i;
+    int ret;
+
+    for(i = 0; i < pl->t->nbos; i++) {
+        if(pl->snap[i] != NULL && (ret = fill(pl->bos[i], 0, pl->snap[i], pl->bos[i]->size, NULL)) != 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static unsigned record_end(const struct r600_trace *t, unsigned pos)
+{
+    return pos + 2 + t->buf[pos + 1];
+}
+
+int r600_trace_replay(const struct r600_trace *t, struct radeon_bo_manager *bom,
+                      struct radeon_cs_manager *csm, unsigned first, unsigned count,
+                      unsigned loops, struct r600_replay_stats *stats)
+{
+    struct r600_replay_stats dummy;
+    struct player pl;
+    unsigned start, end, i, j;
+    uint64_t t0, t1, dt;
+    int ret = -ENOMEM;
+
+    if(first > t->nsubmits || count > t->nsubmits - first)
+        return -EINVAL;
+
+    memset(&pl, 0, sizeof(pl));
+    pl.t = t;
+    pl.bom = bom;
+    pl.stats = stats != NULL ? stats : &dummy;
+    memset(pl.stats, 0, sizeof(*pl.stats));
+    pl.stats->min_ns = UINT64_MAX;
+
+    start = first > 0 ? record_end(t, t->submits[first - 1]) : 2;
+    end = count > 0 ? record_end(t, t->submits[first + count - 1]) : start;
+    if(count > 1)
+        pl.stats->captured_ns = submit_time(t, first + count - 1) - submit_time(t, first);
+
+    if((t->nbos > 0 && (pl.bos = calloc(t->nbos, sizeof(*pl.bos))) == NULL) ||
+       (pl.cb = r600_cmdbuf_create(t->max_ndw)) == NULL ||
+       (pl.cs = radeon_cs_create(csm, t->max_ndw > 64 ? t->max_ndw : 64)) == NULL)
+        goto cleanup;
+
+    if((ret = play(&pl, 2, start, 0)) != 0 || (ret = snapshot(&pl)) != 0)
+        goto cleanup;
+
+    for(i = 0; i < loops; i++) {
+        if(i > 0 && (ret = restore(&pl)) != 0)
+            goto cleanup;
+
+        /* Only the submissions and the GPU running them are timed */
+        pl.paused_ns = 0;
+        t0 = now_ns();
+        if((ret = play(&pl, start, end, 1)) != 0)
+            goto cleanup;
+        for(j = 0; j < t->nbos; j++) {
+            if(pl.bos[j] != NULL)
+                radeon_bo_wait(pl.bos[j]);
+        }
+        t1 = now_ns();
+
+        dt = t1 - t0 - pl.paused_ns;
+        pl.stats->total_ns += dt;
+        if(dt < pl.stats->min_ns)
+            pl.stats->min_ns = dt;
+        if(dt > pl.stats->max_ns)
+            pl.stats->max_ns = dt;
+    }
+
+    if(loops == 0)
+        pl.stats->min_ns = 0;
+
+cleanup:
+    if(pl.bos != NULL) {
+        for(i = 0; i < t->nbos; i++) {
+            if(pl.bos[i] != NULL)
+                radeon_bo_unref(pl.bos[i]);
+            if(pl.snap != NULL)
+                free(pl.snap[i]);
+        }
+    }
+    free(pl.snap);
+    if(pl.cs != NULL)
+        radeon_cs_destroy(pl.cs);
+    r600_cmdbuf_destroy(pl.cb);
+    free(pl.relocs);
+    free(pl.bos);
+
+    return ret;
+}
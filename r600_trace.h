@@ -0,0 +1,151 @@
+/**
+ * r600_trace.h: capture of submitted command streams, and their replay
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_TRACE_H_
+#define _R600_TRACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <radeon_bo.h>
+#include <radeon_cs.h>
+
+#include "r600_cmdbuf.h"
+
+/*
+ * With cb->capture set, every submission of cb is written to a trace:
+ * the packets, the relocations, and whatever the CPU has put in the BOs
+ * they name, so the same work can be re-issued later on another machine
+ * or on the stand-in.  BO contents are kept by 4 KiB page; a page is only
+ * written again when its hash changes, and new BOs are taken to start out
+ * zeroed, so a trace costs little more than its command streams once the
+ * inputs are loaded.  Contents are read just before the packets go to
+ * the kernel, skipping BOs the GPU is still busy with (whatever it leaves
+ * there is picked up the next time the BO is idle at a submission).
+ *
+ * A trace is a file of host-order dwords: R600_TRACE_MAGIC and
+ * R600_TRACE_VERSION, then records, each a type and the number of dwords
+ * that follow it:
+ *
+ *   R600_TRACE_BO      id, size, domains
+ *   R600_TRACE_DATA    id, offset, bytes, then the bytes padded to dwords
+ *   R600_TRACE_SUBMIT  ns since the capture began (low, high), ndw,
+ *                      nrelocs, then { id, read_domains, write_domain,
+ *                      cdw } per relocation and the ndw packet dwords
+ *
+ * The capture holds a reference to every BO it has seen, so a BO id never
+ * comes to stand for another buffer; they are all dropped by
+ * r600_capture_destroy().
+ */
+
+#define R600_TRACE_MAGIC    0x52543652  /* "R6TR" on little-endian hosts */
+#define R600_TRACE_VERSION  1
+#define R600_TRACE_PAGE     4096
+
+enum {
+    R600_TRACE_BO = 1,
+    R600_TRACE_DATA,
+    R600_TRACE_SUBMIT,
+};
+
+struct r600_capture_bo;
+
+struct r600_capture_stats {
+    uint64_t submits;
+    uint64_t dwords;
+    uint64_t pages;         /* of BO contents written */
+    uint64_t unchanged;     /* ... and not written again */
+    uint64_t busy;          /* BOs skipped while the GPU had them */
+};
+
+struct r600_capture {
+    FILE *f;
+    int error;              /* first write error; nothing is written after it */
+    uint64_t start_ns;
+
+    struct r600_capture_bo *bos;
+    unsigned nbos, max_bos;
+    unsigned *hash;         /* 1 + index into bos, 0 for free */
+    unsigned hash_mask;
+
+    unsigned *ids;          /* per entry of the cmdbuf being submitted */
+    unsigned max_ids;
+
+    struct r600_capture_stats stats;
+};
+
+/* Writes the trace header to f, which stays the caller's to close */
+struct r600_capture *r600_capture_create(FILE *f);
+void r600_capture_destroy(struct r600_capture *cap);
+
+/*
+ * Called by r600_cmdbuf_submit(): the BOs and their contents before the
+ * packets go to the kernel, the packets once they have.  A capture that
+ * fails to write stops (cap->error says why) and submissions go on.
+ */
+void r600_capture_contents(struct r600_capture *cap, const struct r600_cmdbuf *cb);
+void r600_capture_submit(struct r600_capture *cap, const struct r600_cmdbuf *cb);
+
+/* A trace read back into memory, its records checked */
+struct r600_trace {
+    uint32_t *buf;
+    unsigned ndw;
+
+    unsigned *submits;      /* where each SUBMIT record starts in buf */
+    unsigned nsubmits;
+    unsigned nbos;          /* ids run from 0 to nbos - 1 */
+    unsigned max_ndw;       /* the longest submission */
+};
+
+/* NULL if f can't be read or isn't a well-formed trace (errno says which) */
+struct r600_trace *r600_trace_load(FILE *f);
+void r600_trace_destroy(struct r600_trace *t);
+
+struct r600_replay_stats {
+    uint64_t submits;
+    uint64_t dwords;
+    uint64_t bytes;         /* of BO contents uploaded */
+    uint64_t captured_ns;   /* the range as captured, first to last submission */
+    uint64_t total_ns;      /* all loops, until the GPU was idle, less copying */
+    uint64_t min_ns, max_ns;    /* per loop */
+};
+
+/*
+ * Re-issues submissions [first, first + count) of t, loops times over,
+ * through BOs of its own made with bom.  Everything before first is
+ * replayed too, minus the submissions, so the BOs hold what they did
+ * when first was captured; that state is put back before every later
+ * loop, so all loops start alike.  Contents are uploaded where the trace
+ * has them, after waiting for the BO to go idle, and come again on every
+ * loop.  The timings cover the submissions and the GPU running them,
+ * including waits for it to finish with a BO before an upload; only
+ * the copying itself, and the restores, are left out.  Returns 0 or a
+ * negative errno value; stats may be NULL.
+ */
+int r600_trace_replay(const struct r600_trace *t, struct radeon_bo_manager *bom,
+                      struct radeon_cs_manager *csm, unsigned first, unsigned count,
+                      unsigned loops, struct r600_replay_stats *stats);
+
+#endif
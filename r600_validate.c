@@ -0,0 +1,378 @@
+/**
+ * r600_validate.c: command stream checks before submission
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "r600_reg.h"
+#include "r600_cmdbuf.h"
+#include "r600_decode.h"
+#include "r600_regtab.h"
+#include "r600_validate.h"
+
+/* Relocations a register write needs: one for registers holding an address */
+static unsigned reg_relocs(uint32_t reg)
+{
+    const struct r600_reg_info *info;
+
+    if((info = r600_reg_lookup(reg, NULL)) == NULL)
+        return 0;
+
+    /* Arrays come back as their element 0 */
+    switch(info->offset) {
+    case CB_COLOR0_BASE:
+    case CB_COLOR0_TILE:
+    case CB_COLOR0_FRAG:
+    case DB_DEPTH_BASE:
+    case DB_HTILE_DATA_BASE:
+    case SQ_PGM_START_PS:
+    case SQ_PGM_START_VS:
+    case SQ_PGM_START_GS:
+    case SQ_PGM_START_ES:
+    case SQ_PGM_START_FS:
+    case SQ_ESGS_RING_BASE:
+    case SQ_GSVS_RING_BASE:
+    case SQ_ESTMP_RING_BASE:
+    case SQ_GSTMP_RING_BASE:
+    case SQ_VSTMP_RING_BASE:
+    case SQ_PSTMP_RING_BASE:
+    case SQ_FBUF_RING_BASE:
+    case SQ_REDUC_RING_BASE:
+    case SQ_ALU_CONST_CACHE_PS_0:
+    case SQ_ALU_CONST_CACHE_VS_0:
+    case SQ_ALU_CONST_CACHE_GS_0:
+    case VGT_STRMOUT_BUFFER_BASE_0:
+    case VGT_STRMOUT_BUFFER_BASE_1:
+    case VGT_STRMOUT_BUFFER_BASE_2:
+    case VGT_STRMOUT_BUFFER_BASE_3:
+    case SX_MEMORY_EXPORT_BASE:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Checks the payload of a type-3 packet, p[1] to p[n - 1], and sets *relocs
+ * to the number of relocation NOPs the kernel will look for after it.
+ * Returns NULL or what is wrong.
+ */
+static const char *check_packet(const uint32_t *p, unsigned n, unsigned flags, unsigned *relocs)
+{
+    unsigned op = PACKET3_OP(p[0]), payload = n - 1, i;
+    uint32_t base;
+    uint64_t start, end;
+
+    *relocs = 0;
+
+#define PAYLOAD(k) if(payload != (k)) return "wrong payload size"
+
+    switch(op) {
+    case IT_NOP:
+        return NULL;
+
+    case IT_SET_CONFIG_REG:
+    case IT_SET_CONTEXT_REG:
+    case IT_SET_ALU_CONST:
+    case IT_SET_BOOL_CONST:
+    case IT_SET_LOOP_CONST:
+    case IT_SET_RESOURCE:
+    case IT_SET_SAMPLER:
+    case IT_SET_CTL_CONST:
+        if(payload < 2)
+            return "register write with no registers";
+        base = r600_set_op_base(op);
+        start = base + 4 * (uint64_t) p[1];
+        end = start + 4 * (uint64_t) (payload - 1);
+        if(end > r600_set_op_end(op))
+            return "registers outside the packet's SET_* window";
+
+        if(op == IT_SET_RESOURCE) {
+            if((payload - 1) % R600_RESOURCE_DWORDS != 0)
+                return "partial resource";
+            /* Textures take two addresses, buffers one, invalid slots none */
+            for(i = 2; i < n; i += R600_RESOURCE_DWORDS) {
+                switch(p[i + 6] >> SQ_TEX_RESOURCE_WORD6_0__TYPE_shift) {
+                case SQ_TEX_VTX_VALID_TEXTURE: *relocs += 2; break;
+                case SQ_TEX_VTX_VALID_BUFFER:  *relocs += 1; break;
+                }
+            }
+        } else if(op == IT_SET_SAMPLER) {
+            if((payload - 1) % R600_SAMPLER_DWORDS != 0)
+                return "partial sampler";
+        } else if(op == IT_SET_CONFIG_REG || op == IT_SET_CONTEXT_REG) {
+            for(i = 2; i < n; i++)
+                *relocs += reg_relocs((uint32_t) start + 4 * (i - 2));
+        }
+        return NULL;
+
+    case IT_CONTEXT_CONTROL:
+    case IT_DRAW_INDEX_AUTO:
+        PAYLOAD(2);
+        return NULL;
+    case IT_INDEX_TYPE:
+    case IT_NUM_INSTANCES:
+    case IT_SURFACE_BASE_UPDATE:
+        PAYLOAD(1);
+        return NULL;
+    case IT_DRAW_INDEX_IMMD:
+    case IT_DRAW_INDEX_IMMD_BE:
+        return payload < 2 ? "wrong payload size" : NULL;
+
+    case IT_DRAW_INDEX:
+        PAYLOAD(4);
+        *relocs = 1;
+        return NULL;
+    case IT_MEM_WRITE:
+        PAYLOAD(4);
+        *relocs = 1;
+        return NULL;
+    case IT_EVENT_WRITE_EOP:
+        PAYLOAD(5);
+        *relocs = 1;
+        return NULL;
+    case IT_CP_DMA:
+        PAYLOAD(5);
+        *relocs = 2;
+        return NULL;
+
+    case IT_SET_PREDICATION:
+        PAYLOAD(2);
+        /* Clearing the predicate has no address */
+        *relocs = (p[2] >> 16) & 7 ? 1 : 0;
+        return NULL;
+    case IT_WAIT_REG_MEM:
+        PAYLOAD(6);
+        *relocs = p[1] & IT_WAIT_MEM ? 1 : 0;
+        return NULL;
+    case IT_EVENT_WRITE:
+        if(payload != 1 && payload != 3)
+            return "wrong payload size";
+        *relocs = payload == 3;
+        return NULL;
+    case IT_SURFACE_SYNC:
+        PAYLOAD(4);
+        /* Anything narrower than the whole address space has a base */
+        *relocs = p[2] != 0xffffffff || p[3] != 0;
+        return NULL;
+    default:
+        break;
+    }
+
+    /* Packets the stand-in runs but the kernel's checker turns away */
+    if(flags & R600_VALIDATE_STANDIN) {
+        switch(op) {
+        case IT_PRED_EXEC:
+            PAYLOAD(1);
+            return NULL;
+        case IT_MEM_SEMAPHORE:
+            PAYLOAD(2);
+            *relocs = 1;
+            return NULL;
+        case IT_COND_EXEC:
+        case IT_INDIRECT_BUFFER:
+            PAYLOAD(3);
+            *relocs = 1;
+            return NULL;
+        case IT_COND_WRITE:
+            PAYLOAD(6);
+            *relocs = ((p[1] & (1 << 4)) != 0) + ((p[1] & (1 << 8)) != 0);
+            return NULL;
+        }
+    }
+
+    return r600_packet_name(op) != NULL ? "packet the kernel doesn't accept" :
+                                          "unknown opcode";
+
+#undef PAYLOAD
+}
+
+int r600_validate(const struct r600_cmdbuf *cb, unsigned flags, struct r600_invalid *err)
+{
+    const uint32_t *buf = cb->buf;
+    const struct r600_reloc *r = cb->relocs, *rend = cb->relocs + cb->nrelocs;
+    const char *why = NULL;
+    const uint32_t *qw = NULL;
+    unsigned i, n = 1, need = 0, relocs, skip_to = 0, qw_at = 0;
+    uint32_t hdr;
+    uint64_t addr;
+
+    for(i = 0; i < cb->cdw; i += n) {
+        hdr = buf[i];
+
+        if(skip_to > i && skip_to < i + (PACKET_TYPE(hdr) == 2 ? 1 : PACKET_NDW(hdr))) {
+            why = "conditional execution ends inside a packet";
+            break;
+        }
+
+        if(PACKET_TYPE(hdr) == 2) {
+            n = 1;
+            if(need > 0) {
+                why = "missing relocation";
+                break;
+            }
+            continue;
+        }
+        if(PACKET_TYPE(hdr) != 3) {
+            why = PACKET_TYPE(hdr) == 0 ? "type-0 packet" : "type-1 packet";
+            break;
+        }
+
+        n = PACKET_NDW(hdr);
+        if(i + n > cb->cdw) {
+            why = "packet runs past the end of the buffer";
+            break;
+        }
+
+        /* Our relocations, in order, each at a NOP of its own */
+        if(r < rend && r->cdw < i) {
+            why = "relocation inside a packet";
+            break;
+        }
+        if(r < rend && r->cdw == i) {
+            if(PACKET3_OP(hdr) != IT_NOP || n != R600_RELOC_DW || buf[i + 1] != r - cb->relocs) {
+                why = "relocation NOP overwritten";
+                break;
+            }
+            /* The kernel checks a qword write against its relocation's BO */
+            if(qw != NULL) {
+                addr = qw[0] | (uint64_t) (qw[1] & 0xff) << 32;
+                if((addr & 7) != 0)
+                    why = "write not 8-byte aligned";
+                else if(addr + 8 > r->bo->size)
+                    why = "write past the end of its buffer";
+                if(why != NULL) {
+                    i = qw_at;
+                    break;
+                }
+                qw = NULL;
+            }
+            r++;
+            if(need > 0)
+                need--;
+            continue;
+        }
+        if(need > 0) {
+            why = "missing relocation";
+            break;
+        }
+
+        if((why = check_packet(buf + i, n, flags, &relocs)) != NULL)
+            break;
+        need = relocs;
+
+        qw_at = i;
+        if(PACKET3_OP(hdr) == IT_MEM_WRITE)
+            qw = buf + i + 1;
+        else if(PACKET3_OP(hdr) == IT_EVENT_WRITE_EOP)
+            qw = buf + i + 2;
+
+        if(PACKET3_OP(hdr) == IT_COND_EXEC)
+            skip_to = i + n + buf[i + 3];
+        else if(PACKET3_OP(hdr) == IT_PRED_EXEC)
+            skip_to = i + n + (buf[i + 1] & 0x3fff);
+    }
+
+    if(why == NULL) {
+        if(need > 0)
+            why = "missing relocation";
+        else if(r < rend)
+            why = "relocation past the end of the buffer";
+        else if(skip_to > i)
+            why = "conditional execution runs past the end of the buffer";
+        else
+            return 0;
+    }
+
+    if(err != NULL) {
+        err->dw = i < cb->cdw ? i : cb->cdw;
+        err->why = why;
+    }
+    return -EINVAL;
+}
+
+static uint32_t next_random(struct r600_validator *v)
+{
+    /* xorshift32 */
+    v->rng ^= v->rng << 13;
+    v->rng ^= v->rng >> 17;
+    v->rng ^= v->rng << 5;
+    return v->rng;
+}
+
+/*
+ * The gap to the next checked submission, uniform on [1, 2 * every - 1]:
+ * 1 in every on average, without locking onto a pattern in the workload
+ * the way a fixed stride could.
+ */
+static unsigned next_gap(struct r600_validator *v)
+{
+    if(v->every <= 1)
+        return v->every;
+    return 1 + next_random(v) % (2 * v->every - 1);
+}
+
+struct r600_validator *r600_validator_create(unsigned every)
+{
+    struct r600_validator *v;
+
+    if((v = calloc(1, sizeof(*v))) == NULL)
+        return NULL;
+
+    v->every = every;
+    v->rng = 0x9e3779b9u ^ (uint32_t) (uintptr_t) v;
+    if(v->rng == 0)
+        v->rng = 1;
+    v->countdown = next_gap(v);
+
+    return v;
+}
+
+void r600_validator_destroy(struct r600_validator *v)
+{
+    free(v);
+}
+
+int r600_validator_check(struct r600_validator *v, const struct r600_cmdbuf *cb)
+{
+    v->stats.submits++;
+
+    if(v->countdown == 0 || --v->countdown > 0)
+        return 0;
+    v->countdown = next_gap(v);
+
+    v->stats.checked++;
+    if(r600_validate(cb, v->flags, &v->last) == 0)
+        return 0;
+
+    v->stats.rejected++;
+    if(v->log != NULL)
+        fprintf(v->log, "r600: rejected a submission of %u dwords: %s at dword %u\n",
+                cb->cdw, v->last.why, v->last.dw);
+
+    return -EINVAL;
+}
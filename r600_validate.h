@@ -0,0 +1,104 @@
+/**
+ * r600_validate.h: command stream checks before submission
+ *
+ * Copyright © 2011 Zachary Catlin <z@zc.is>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHOR(S), COPYRIGHT HOLDER(S), AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _R600_VALIDATE_H_
+#define _R600_VALIDATE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "r600_cmdbuf.h"
+
+/*
+ * A malformed stream is caught by the kernel's checker at best and hangs
+ * the GPU at worst, and a reset costs seconds.  r600_validate() walks a
+ * finished command buffer once, front to back, and checks that:
+ *
+ *  - every packet is type 2 or a type 3 whose opcode we know and the
+ *    kernel accepts, with a payload of the right size, inside the buffer;
+ *  - IT_SET_* packets stay inside their SET_* window in r600_reg.h;
+ *  - packets and registers that take an address (CB_COLOR0_BASE, the
+ *    shader starts, memory writes, IT_CP_DMA, ...) are followed by as
+ *    many relocation NOPs as the kernel will look for;
+ *  - each relocation's NOP sits at a packet boundary, in order, and
+ *    carries its own index;
+ *  - IT_MEM_WRITE and IT_EVENT_WRITE_EOP write a qword-aligned qword
+ *    inside their relocation's BO;
+ *  - IT_COND_EXEC and IT_PRED_EXEC skip whole packets (R600_VALIDATE_STANDIN).
+ *
+ * It costs a few nanoseconds per packet, so an r600_validator can run it
+ * on every submission, or on a random 1 in N to keep the cost out of
+ * sight while still catching a systematic bug quickly.
+ */
+
+/*
+ * Also accept what only r600_standin.h runs: IT_PRED_EXEC, IT_COND_EXEC,
+ * IT_COND_WRITE, IT_MEM_SEMAPHORE and IT_INDIRECT_BUFFER.
+ */
+#define R600_VALIDATE_STANDIN   (1 << 0)
+
+struct r600_invalid {
+    unsigned dw;            /* where the bad packet starts */
+    const char *why;
+};
+
+/*
+ * 0, or -EINVAL with the first problem found in *err (which may be NULL).
+ * flags are R600_VALIDATE_*.
+ */
+int r600_validate(const struct r600_cmdbuf *cb, unsigned flags, struct r600_invalid *err);
+
+struct r600_validator_stats {
+    uint64_t submits;
+    uint64_t checked;
+    uint64_t rejected;
+};
+
+struct r600_validator {
+    unsigned every;         /* check 1 in every submissions on average, 0 for none */
+    unsigned flags;         /* R600_VALIDATE_*, 0 to begin with */
+    unsigned countdown;
+    uint32_t rng;
+
+    FILE *log;              /* rejections are reported here if set */
+    struct r600_invalid last;
+    struct r600_validator_stats stats;
+};
+
+/*
+ * every = 1 checks every submission.  A validator is not locked, so give
+ * each thread that submits its own.
+ */
+struct r600_validator *r600_validator_create(unsigned every);
+void r600_validator_destroy(struct r600_validator *v);
+
+/*
+ * Called by r600_cmdbuf_submit() for a command buffer whose validator is
+ * set: returns 0 if cb may go to the kernel, or -EINVAL if this one was
+ * checked and failed.
+ */
+int r600_validator_check(struct r600_validator *v, const struct r600_cmdbuf *cb);
+
+#endif